@@ -0,0 +1,515 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+#include <math.h>
+
+/* Significance level of the Welch t-test */
+#define COMPARE_ALPHA		(0.05)
+
+typedef struct compare_metric {
+	struct compare_metric *next;	/* next metric in list */
+	char *stressor;			/* stressor name */
+	char *metric;			/* metric name */
+	int better;			/* COMPARE_* direction */
+	double *samples;		/* one value per run */
+	size_t n;			/* number of samples */
+	size_t max;			/* samples allocated */
+} compare_metric_t;
+
+static const char *compare_better[] = {
+	"neutral",		/* COMPARE_NEUTRAL */
+	"higher",		/* COMPARE_HIGHER */
+	"lower",		/* COMPARE_LOWER */
+};
+
+static bool compare_active;		/* --baseline or --compare given */
+static compare_metric_t *compare_current;	/* metrics of this run */
+static compare_metric_t *compare_baseline;	/* metrics of --compare file */
+
+/*
+ *  stress_set_compare_threshold()
+ *	set the change in percent flagged by --compare
+ */
+void stress_set_compare_threshold(const char *opt)
+{
+	uint32_t threshold;
+
+	threshold = get_uint32(opt);
+	check_range("compare-threshold", threshold,
+		MIN_COMPARE_THRESHOLD, MAX_COMPARE_THRESHOLD);
+	set_setting("compare-threshold", TYPE_ID_UINT32, &threshold);
+}
+
+/*
+ *  compare_init()
+ *	start collecting metrics if they are to be
+ *	saved or compared, returns true if so
+ */
+bool compare_init(void)
+{
+	char *filename;
+
+	compare_active = get_setting("baseline", &filename) ||
+			 get_setting("compare", &filename);
+	return compare_active;
+}
+
+/*
+ *  compare_find()
+ *	find a metric in list, adding it if add is true
+ */
+static compare_metric_t *compare_find(
+	compare_metric_t **list,
+	const char *stressor,
+	const char *metric,
+	const bool add)
+{
+	compare_metric_t *cm, **tail;
+
+	for (tail = list; *tail; tail = &(*tail)->next) {
+		cm = *tail;
+		if (!strcmp(cm->stressor, stressor) && !strcmp(cm->metric, metric))
+			return cm;
+	}
+	if (!add)
+		return NULL;
+
+	cm = calloc(1, sizeof(*cm));
+	if (!cm)
+		return NULL;
+	cm->stressor = strdup(stressor);
+	cm->metric = strdup(metric);
+	if (!cm->stressor || !cm->metric) {
+		free(cm->stressor);
+		free(cm->metric);
+		free(cm);
+		return NULL;
+	}
+	*tail = cm;
+	return cm;
+}
+
+/*
+ *  compare_sample()
+ *	append a sample to a metric
+ */
+static void compare_sample(compare_metric_t *cm, const double value)
+{
+	if (cm->n >= cm->max) {
+		const size_t max = cm->max ? cm->max * 2 : 8;
+		double *samples;
+
+		samples = realloc(cm->samples, max * sizeof(*samples));
+		if (!samples)
+			return;
+		cm->samples = samples;
+		cm->max = max;
+	}
+	cm->samples[cm->n++] = value;
+}
+
+/*
+ *  compare_add()
+ *	record a metric of this run, repeated runs add
+ *	further samples of the same metric
+ */
+void compare_add(
+	const char *stressor,
+	const char *metric,
+	const int better,
+	const double value)
+{
+	compare_metric_t *cm;
+
+	if (!compare_active)
+		return;
+
+	cm = compare_find(&compare_current, stressor, metric, true);
+	if (!cm)
+		return;
+	cm->better = better;
+	compare_sample(cm, value);
+}
+
+/*
+ *  compare_save()
+ *	--baseline, save the metrics of this run
+ *	together with the system information
+ */
+void compare_save(void)
+{
+	const compare_metric_t *cm;
+	char *filename;
+	FILE *fp;
+
+	if (!get_setting("baseline", &filename))
+		return;
+
+	fp = fopen(filename, "w");
+	if (!fp) {
+		pr_err("Cannot save baseline to %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		return;
+	}
+	pr_yaml(fp, "---\n");
+	pr_yaml_runinfo(fp);
+	pr_yaml(fp, "baseline:\n");
+	for (cm = compare_current; cm; cm = cm->next) {
+		size_t i;
+
+		pr_yaml(fp, "    - stressor: %s\n", cm->stressor);
+		pr_yaml(fp, "      metric: %s\n", cm->metric);
+		pr_yaml(fp, "      better: %s\n", compare_better[cm->better]);
+		pr_yaml(fp, "      samples: [");
+		for (i = 0; i < cm->n; i++)
+			pr_yaml(fp, "%s %f", i ? "," : "", cm->samples[i]);
+		pr_yaml(fp, " ]\n");
+	}
+	pr_yaml(fp, "...\n");
+	(void)fclose(fp);
+	pr_inf("baseline saved to %s\n", filename);
+}
+
+/*
+ *  compare_load()
+ *	read the metrics of a file saved by --baseline and
+ *	report the system it was saved on
+ */
+static int compare_load(const char *filename)
+{
+	char line[4096], host[128] = "unknown", release[128] = "unknown";
+	char date[32] = "unknown", version[32] = "unknown";
+	char stressor[128] = "";
+	compare_metric_t *cm = NULL;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		pr_err("Cannot read baseline %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		char value[128], *ptr;
+
+		if (sscanf(line, " hostname: %127s", host) == 1)
+			continue;
+		if (sscanf(line, " release: %127s", release) == 1)
+			continue;
+		if (sscanf(line, " date-yyyy-mm-dd: %31s", date) == 1)
+			continue;
+		if (sscanf(line, " stress-ng-version: %31s", version) == 1)
+			continue;
+		if (sscanf(line, " - stressor: %127s", stressor) == 1) {
+			cm = NULL;
+			continue;
+		}
+		if (sscanf(line, " metric: %127s", value) == 1) {
+			cm = *stressor ? compare_find(&compare_baseline,
+				stressor, value, true) : NULL;
+			continue;
+		}
+		if (!cm)
+			continue;
+		if (sscanf(line, " better: %127s", value) == 1) {
+			size_t i;
+
+			for (i = 0; i < SIZEOF_ARRAY(compare_better); i++)
+				if (!strcmp(value, compare_better[i]))
+					cm->better = (int)i;
+			continue;
+		}
+		ptr = strchr(line, '[');
+		if (!ptr || !strstr(line, "samples:"))
+			continue;
+		for (ptr++; ; ptr++) {
+			char *end;
+			const double v = strtod(ptr, &end);
+
+			if (end == ptr)
+				break;
+			compare_sample(cm, v);
+			ptr = end;
+			if (*ptr != ',')
+				break;
+		}
+	}
+	(void)fclose(fp);
+
+	if (!compare_baseline) {
+		pr_err("Baseline %s has no metrics to compare with\n", filename);
+		return -1;
+	}
+	pr_inf("comparing with baseline %s, saved by stress-ng %s "
+		"on %s, kernel %s, %s\n",
+		filename, version, host, release, date);
+	return 0;
+}
+
+/*
+ *  compare_mean_var()
+ *	mean and sample variance of a metric
+ */
+static void compare_mean_var(
+	const compare_metric_t *cm,
+	double *mean,
+	double *var)
+{
+	double sum = 0.0, sum_sq = 0.0;
+	size_t i;
+
+	for (i = 0; i < cm->n; i++)
+		sum += cm->samples[i];
+	*mean = sum / (double)cm->n;
+	for (i = 0; i < cm->n; i++)
+		sum_sq += (cm->samples[i] - *mean) * (cm->samples[i] - *mean);
+	*var = (cm->n > 1) ? sum_sq / (double)(cm->n - 1) : 0.0;
+}
+
+/*
+ *  compare_betacf()
+ *	continued fraction of the incomplete beta function
+ */
+static double compare_betacf(const double a, const double b, const double x)
+{
+	const double qab = a + b, qap = a + 1.0, qam = a - 1.0;
+	double c = 1.0, d = 1.0 - (qab * x / qap), h;
+	int m;
+
+	if (fabs(d) < 1E-30)
+		d = 1E-30;
+	d = 1.0 / d;
+	h = d;
+	for (m = 1; m <= 200; m++) {
+		const int m2 = 2 * m;
+		double aa, del;
+
+		aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+		d = 1.0 + (aa * d);
+		if (fabs(d) < 1E-30)
+			d = 1E-30;
+		c = 1.0 + (aa / c);
+		if (fabs(c) < 1E-30)
+			c = 1E-30;
+		d = 1.0 / d;
+		h *= d * c;
+		aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+		d = 1.0 + (aa * d);
+		if (fabs(d) < 1E-30)
+			d = 1E-30;
+		c = 1.0 + (aa / c);
+		if (fabs(c) < 1E-30)
+			c = 1E-30;
+		d = 1.0 / d;
+		del = d * c;
+		h *= del;
+		if (fabs(del - 1.0) < 1E-12)
+			break;
+	}
+	return h;
+}
+
+/*
+ *  compare_betai()
+ *	regularized incomplete beta function I_x(a, b)
+ */
+static double compare_betai(const double a, const double b, const double x)
+{
+	double bt;
+
+	if (x <= 0.0)
+		return 0.0;
+	if (x >= 1.0)
+		return 1.0;
+	bt = exp(lgamma(a + b) - lgamma(a) - lgamma(b) +
+		(a * log(x)) + (b * log(1.0 - x)));
+	if (x < (a + 1.0) / (a + b + 2.0))
+		return bt * compare_betacf(a, b, x) / a;
+	return 1.0 - (bt * compare_betacf(b, a, 1.0 - x) / b);
+}
+
+/*
+ *  compare_t_p()
+ *	two sided p-value of Student's t with df degrees of freedom
+ */
+static double compare_t_p(const double t, const double df)
+{
+	return compare_betai(df / 2.0, 0.5, df / (df + (t * t)));
+}
+
+/*
+ *  compare_t_crit()
+ *	t with a two sided p-value of alpha, by bisection
+ */
+double compare_t_crit(const double alpha, const double df)
+{
+	double lo = 0.0, hi = 1000.0;
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		const double mid = (lo + hi) / 2.0;
+
+		if (compare_t_p(mid, df) > alpha)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return hi;
+}
+
+/*
+ *  compare_report()
+ *	--compare, compare the metrics of this run with the
+ *	baseline and flag changes beyond the threshold, with a
+ *	Welch t-test when both sides have repeated samples.
+ *	Returns the number of regressions, -1 if the baseline
+ *	cannot be used
+ */
+int compare_report(FILE *yaml)
+{
+	const compare_metric_t *cur;
+	uint32_t threshold = DEFAULT_COMPARE_THRESHOLD;
+	char *filename;
+	int regressions = 0, improvements = 0;
+	bool dumped_heading = false;
+
+	if (!get_setting("compare", &filename))
+		return 0;
+	(void)get_setting("compare-threshold", &threshold);
+	if (compare_load(filename) < 0)
+		return -1;
+
+	for (cur = compare_current; cur; cur = cur->next) {
+		const compare_metric_t *base;
+		double mb, vb, mc, vc, change, p = -1.0, lo = 0.0, hi = 0.0;
+		bool significant = true;
+		const char *verdict = "same";
+		char ci[40] = "", pval[16] = "n/a";
+
+		base = compare_find(&compare_baseline, cur->stressor, cur->metric, false);
+		if (!base || !base->n || !cur->n)
+			continue;
+
+		compare_mean_var(base, &mb, &vb);
+		compare_mean_var(cur, &mc, &vc);
+		if (mb == 0.0)
+			continue;
+		change = (mc - mb) / fabs(mb);
+
+		if ((base->n > 1) && (cur->n > 1)) {
+			const double sb = vb / (double)base->n;
+			const double sc = vc / (double)cur->n;
+			const double se = sqrt(sb + sc);
+
+			if (se > 0.0) {
+				const double df = ((sb + sc) * (sb + sc)) /
+					(((sb * sb) / (double)(base->n - 1)) +
+					 ((sc * sc) / (double)(cur->n - 1)));
+				const double delta = compare_t_crit(COMPARE_ALPHA, df) * se;
+
+				p = compare_t_p((mc - mb) / se, df);
+				lo = (mc - mb - delta) / fabs(mb);
+				hi = (mc - mb + delta) / fabs(mb);
+				significant = (p < COMPARE_ALPHA);
+				(void)snprintf(pval, sizeof(pval), "%.4f", p);
+				(void)snprintf(ci, sizeof(ci), "[%+.1f%%, %+.1f%%]",
+					lo * 100.0, hi * 100.0);
+			} else {
+				significant = (mc != mb);
+			}
+		}
+
+		if (significant && (fabs(change) * 100.0 > (double)threshold)) {
+			if (cur->better == COMPARE_NEUTRAL) {
+				verdict = "changed";
+			} else if ((change > 0.0) == (cur->better == COMPARE_HIGHER)) {
+				verdict = "improvement";
+				improvements++;
+			} else {
+				verdict = "regression";
+				regressions++;
+			}
+		}
+
+		if (!dumped_heading) {
+			dumped_heading = true;
+			pr_inf("%-13s %-32s %13s %13s %8s %8s %-20s %s\n",
+				"stressor", "metric", "baseline", "current",
+				"change", "p-value", "95% CI", "verdict");
+			pr_yaml(yaml, "comparison:\n");
+		}
+		pr_inf("%-13s %-32s %13.2f %13.2f %+7.1f%% %8s %-20s %s\n",
+			cur->stressor, cur->metric, mb, mc, change * 100.0,
+			pval, ci, verdict);
+
+		pr_yaml(yaml, "    - stressor: %s\n", cur->stressor);
+		pr_yaml(yaml, "      metric: %s\n", cur->metric);
+		pr_yaml(yaml, "      baseline-mean: %f\n", mb);
+		pr_yaml(yaml, "      baseline-samples: %zu\n", base->n);
+		pr_yaml(yaml, "      current-mean: %f\n", mc);
+		pr_yaml(yaml, "      current-samples: %zu\n", cur->n);
+		pr_yaml(yaml, "      change-percent: %f\n", change * 100.0);
+		if (p >= 0.0) {
+			pr_yaml(yaml, "      welch-p-value: %f\n", p);
+			pr_yaml(yaml, "      change-ci95-percent: [ %f, %f ]\n",
+				lo * 100.0, hi * 100.0);
+		}
+		pr_yaml(yaml, "      verdict: %s\n", verdict);
+	}
+	if (dumped_heading)
+		pr_yaml(yaml, "\n");
+
+	pr_inf("%d regression%s and %d improvement%s beyond %" PRIu32 "%%\n",
+		regressions, regressions == 1 ? "" : "s",
+		improvements, improvements == 1 ? "" : "s", threshold);
+
+	return regressions;
+}
+
+/*
+ *  compare_free_list()
+ *	free a list of metrics
+ */
+static void compare_free_list(compare_metric_t **list)
+{
+	compare_metric_t *cm = *list;
+
+	while (cm) {
+		compare_metric_t *next = cm->next;
+
+		free(cm->stressor);
+		free(cm->metric);
+		free(cm->samples);
+		free(cm);
+		cm = next;
+	}
+	*list = NULL;
+}
+
+/*
+ *  compare_free()
+ *	free the collected and baseline metrics
+ */
+void compare_free(void)
+{
+	compare_free_list(&compare_current);
+	compare_free_list(&compare_baseline);
+	compare_active = false;
+}
@@ -0,0 +1,336 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+
+#define ENERGY_POWERCAP		"/sys/class/powercap"
+
+/* Most RAPL domains to read */
+#define ENERGY_ZONES_MAX	(64)
+
+/* More than any package draws, to work out how fast a counter can wrap */
+#define ENERGY_MAX_WATTS	(1000)
+/* Bounds on the wrap poller period, and how often it checks to stop */
+#define ENERGY_POLL_MIN_USEC	(100000)
+#define ENERGY_POLL_MAX_USEC	(10000000)
+#define ENERGY_POLL_SLICE_USEC	(100000)
+
+/* A top level RAPL powercap domain */
+typedef struct {
+	char *path;			/* energy_uj file */
+	uint64_t range;			/* energy_uj wraps after this */
+	uint64_t last;			/* energy_uj at the last read */
+} energy_zone_t;
+
+static energy_zone_t energy_zones[ENERGY_ZONES_MAX];
+static size_t energy_n;			/* powercap domains read */
+#if defined(STRESS_PERF_STATS)
+static bool energy_perf;		/* reading perf power/ events */
+#endif
+static double energy_joules;		/* joules used since energy_init() */
+static double energy_run_joules;	/* energy_joules at the run start */
+static double energy_run_time;		/* wall clock run start */
+static uint64_t energy_poll_usec;	/* wrap poller period */
+
+#if defined(HAVE_LIB_PTHREAD)
+static pthread_mutex_t energy_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t energy_thread;
+static volatile bool energy_run;	/* false to stop the wrap poller */
+static bool energy_running;		/* wrap poller thread created */
+#endif
+
+/*
+ *  energy_read_uj()
+ *	read a powercap microjoule counter
+ */
+static int energy_read_uj(const char *path, uint64_t *uj)
+{
+	char buf[64];
+
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return -1;
+	return (sscanf(buf, "%" SCNu64, uj) == 1) ? 0 : -1;
+}
+
+/*
+ *  energy_zone_add()
+ *	add a top level powercap domain, ignoring psys
+ *	that already covers the packages
+ */
+static void energy_zone_add(const char *name)
+{
+	char path[PATH_MAX], buf[64];
+	energy_zone_t *zone = &energy_zones[energy_n];
+	uint64_t period;
+
+	(void)snprintf(path, sizeof(path), "%s/%s/name", ENERGY_POWERCAP, name);
+	if ((system_read(path, buf, sizeof(buf) - 1) > 0) && !strncmp(buf, "psys", 4))
+		return;
+
+	(void)snprintf(path, sizeof(path), "%s/%s/max_energy_range_uj",
+		ENERGY_POWERCAP, name);
+	if ((energy_read_uj(path, &zone->range) < 0) || !zone->range)
+		return;
+	(void)snprintf(path, sizeof(path), "%s/%s/energy_uj", ENERGY_POWERCAP, name);
+	if (energy_read_uj(path, &zone->last) < 0)
+		return;
+	zone->path = strdup(path);
+	if (!zone->path)
+		return;
+	energy_n++;
+
+	/* Poll a few times per fastest possible wrap of the counter */
+	period = zone->range / ENERGY_MAX_WATTS / 4;
+	if (period < energy_poll_usec)
+		energy_poll_usec = period;
+}
+
+/*
+ *  energy_delta_uj()
+ *	microjoules between two reads of a counter that wraps
+ *	to 0 after range, at most one wrap in between
+ */
+static uint64_t energy_delta_uj(
+	const uint64_t last,
+	const uint64_t now,
+	const uint64_t range)
+{
+	if (now >= last)
+		return now - last;
+	return range - last + now + 1;
+}
+
+/*
+ *  energy_read()
+ *	joules used since energy_init(). The powercap counters
+ *	wrap at max_energy_range_uj, which is handled as long as
+ *	they are read at least once per wrap, energy_poll_thread()
+ *	makes sure of that however long the run
+ */
+bool energy_read(double *joules)
+{
+	size_t i;
+
+	if (!(g_opt_flags & OPT_FLAGS_ENERGY))
+		return false;
+
+#if defined(STRESS_PERF_STATS)
+	if (energy_perf)
+		return perf_energy_read(joules);
+#endif
+#if defined(HAVE_LIB_PTHREAD)
+	(void)pthread_mutex_lock(&energy_lock);
+#endif
+	for (i = 0; i < energy_n; i++) {
+		energy_zone_t *zone = &energy_zones[i];
+		uint64_t uj;
+
+		if (energy_read_uj(zone->path, &uj) < 0)
+			continue;
+		energy_joules += (double)energy_delta_uj(zone->last, uj, zone->range) / 1E6;
+		zone->last = uj;
+	}
+	*joules = energy_joules;
+#if defined(HAVE_LIB_PTHREAD)
+	(void)pthread_mutex_unlock(&energy_lock);
+#endif
+	return true;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  energy_poll_thread()
+ *	read the powercap counters more often than they can
+ *	wrap until told to stop, whether or not anything
+ *	else is reading them
+ */
+static void *energy_poll_thread(void *arg)
+{
+	uint64_t slept = 0;
+
+	(void)arg;
+
+	while (energy_run) {
+		(void)shim_usleep(ENERGY_POLL_SLICE_USEC);
+		slept += ENERGY_POLL_SLICE_USEC;
+		if (slept >= energy_poll_usec) {
+			double joules;
+
+			(void)energy_read(&joules);
+			slept = 0;
+		}
+	}
+	return NULL;
+}
+#endif
+
+/*
+ *  energy_init()
+ *	find the RAPL package energy counters, Intel and AMD
+ *	powercap domains first then the perf power/ events,
+ *	returns -1 if there are none that can be read
+ */
+int energy_init(void)
+{
+	DIR *dir;
+	struct dirent *entry;
+
+	energy_joules = 0.0;
+	energy_poll_usec = ENERGY_POLL_MAX_USEC;
+
+	dir = opendir(ENERGY_POWERCAP);
+	if (dir) {
+		while ((entry = readdir(dir)) != NULL) {
+			/*
+			 *  intel-rapl:0 but not its sub-domains intel-rapl:0:0
+			 *  nor intel-rapl-mmio:0, which is the same package
+			 *  again through MMIO and would count it twice
+			 */
+			const char *colon = strchr(entry->d_name, ':');
+
+			if (!colon || strchr(colon + 1, ':'))
+				continue;
+			if (strncmp(entry->d_name, "intel-rapl:", 11))
+				continue;
+			if (energy_n >= ENERGY_ZONES_MAX)
+				break;
+			energy_zone_add(entry->d_name);
+		}
+		(void)closedir(dir);
+	}
+	if (energy_n) {
+#if defined(HAVE_LIB_PTHREAD)
+		int ret;
+#endif
+
+		if (energy_poll_usec < ENERGY_POLL_MIN_USEC)
+			energy_poll_usec = ENERGY_POLL_MIN_USEC;
+		pr_dbg("energy: reading %zu RAPL powercap domain%s, "
+			"every %.1f secs against wrap\n",
+			energy_n, energy_n == 1 ? "" : "s",
+			(double)energy_poll_usec / 1E6);
+#if defined(HAVE_LIB_PTHREAD)
+		energy_run = true;
+		ret = pthread_create(&energy_thread, NULL, energy_poll_thread, NULL);
+		energy_running = (ret == 0);
+		if (!energy_running)
+			pr_err("Cannot create energy polling thread, errno=%d (%s), "
+				"counters may wrap in long runs\n", ret, strerror(ret));
+#endif
+		return 0;
+	}
+
+#if defined(STRESS_PERF_STATS)
+	if (perf_energy_open() > 0) {
+		energy_perf = true;
+		pr_dbg("energy: reading perf power/ RAPL counters\n");
+		return 0;
+	}
+#endif
+	pr_inf("energy: no readable RAPL energy counters, "
+		"energy will not be reported\n");
+	return -1;
+}
+
+/*
+ *  energy_start()
+ *	note the energy counters at the start of a run
+ */
+void energy_start(void)
+{
+	if (energy_read(&energy_run_joules))
+		energy_run_time = time_now();
+}
+
+/*
+ *  energy_stop()
+ *	charge the energy used during the run to each of
+ *	its stressors. Package counters cannot tell stressors
+ *	apart, so only runs of one stressor, such as with
+ *	--sequential, give the energy of a single stressor
+ */
+void energy_stop(proc_info_t *procs_list)
+{
+	proc_info_t *pi;
+	double joules;
+
+	if (!energy_read(&joules))
+		return;
+
+	for (pi = procs_list; pi; pi = pi->next) {
+		pi->energy = joules - energy_run_joules;
+		pi->energy_secs = time_now() - energy_run_time;
+	}
+}
+
+/*
+ *  energy_metrics_dump()
+ *	output the joules, average watts and bogo ops per
+ *	joule of the run of a stressor
+ */
+void energy_metrics_dump(FILE *yaml, const proc_info_t *pi)
+{
+	uint64_t c_total = 0;
+	double watts, ops_per_joule;
+	int32_t j;
+
+	if ((pi->energy_secs <= 0.0) || (pi->energy <= 0.0))
+		return;
+
+	watts = pi->energy / pi->energy_secs;
+	for (j = 0; j < pi->started_procs; j++)
+		c_total += pi->stats[j]->counter;
+	ops_per_joule = (double)c_total / pi->energy;
+
+	pr_inf("  %-15s %.2f J, %.2f W, %.2f bogo ops/J\n", "energy",
+		pi->energy, watts, ops_per_joule);
+
+	pr_yaml(yaml, "      energy-joules: %f\n", pi->energy);
+	pr_yaml(yaml, "      average-watts: %f\n", watts);
+	pr_yaml(yaml, "      bogo-ops-per-joule: %f\n", ops_per_joule);
+
+	compare_add(munge_underscore(pi->stressor->name),
+		"bogo-ops-per-joule", COMPARE_HIGHER, ops_per_joule);
+}
+
+/*
+ *  energy_free()
+ *	free the RAPL domains
+ */
+void energy_free(void)
+{
+	size_t i;
+
+#if defined(HAVE_LIB_PTHREAD)
+	if (energy_running) {
+		energy_run = false;
+		(void)pthread_join(energy_thread, NULL);
+		energy_running = false;
+	}
+#endif
+	for (i = 0; i < energy_n; i++) {
+		free(energy_zones[i].path);
+		energy_zones[i].path = NULL;
+	}
+	energy_n = 0;
+#if defined(STRESS_PERF_STATS)
+	if (energy_perf)
+		perf_energy_close();
+	energy_perf = false;
+#endif
+}
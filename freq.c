@@ -0,0 +1,472 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+
+static bool freq_enabled;		/* --freq */
+
+/*
+ *  stress_set_freq()
+ *	report the CPU frequency and throttling of each stressor
+ */
+void stress_set_freq(void)
+{
+	freq_enabled = true;
+}
+
+#if defined(__linux__) && defined(HAVE_AFFINITY)
+
+#define FREQ_SYS_CPU		"/sys/devices/system/cpu"
+
+/* Time between scaling_cur_freq samples */
+#define FREQ_POLL_USEC		(250000)
+
+/* x86 MSRs counting at the TSC, actual and maximum non-turbo rates */
+#define FREQ_MSR_TSC		(0x10)
+#define FREQ_MSR_MPERF		(0xe7)
+#define FREQ_MSR_APERF		(0xe8)
+
+/* Telemetry of a CPU */
+typedef struct {
+	int	 msr;			/* /dev/cpu/N/msr, -1 if not readable */
+	int32_t	 core;			/* core_id */
+	int32_t	 package;		/* physical_package_id */
+	uint64_t tsc;			/* MSRs at the run start, then */
+	uint64_t mperf;			/*  counted during the run */
+	uint64_t aperf;
+	double	 khz_sum;		/* scaling_cur_freq samples */
+	uint64_t khz_n;
+	int64_t	 core_throttle;		/* core_throttle_count, -1 if */
+	int64_t	 package_throttle;	/*  not readable, then counted */
+} freq_cpu_t;
+
+static freq_cpu_t *freq_cpus;
+static int32_t freq_n;			/* CPUs configured */
+static bool freq_msr;			/* APERF/MPERF readable */
+static bool freq_cpufreq;		/* scaling_cur_freq readable */
+static double freq_run_time;		/* wall clock run start */
+static double freq_tsc_hz;		/* TSC rate during the run */
+static cpu_set_t freq_sampled;		/* CPUs any stressor can run on */
+
+#if defined(HAVE_LIB_PTHREAD)
+static pthread_t freq_thread;
+static volatile bool freq_run;		/* false to stop the sampler */
+static bool freq_running;		/* sampler thread created */
+#endif
+
+/*
+ *  freq_read_int()
+ *	read a number from a sysfs CPU file, -1 if not readable
+ */
+static int64_t freq_read_int(const int32_t cpu, const char *file)
+{
+	char path[PATH_MAX], buf[64];
+	int64_t val;
+
+	(void)snprintf(path, sizeof(path), "%s/cpu%" PRId32 "/%s",
+		FREQ_SYS_CPU, cpu, file);
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return -1;
+	if (sscanf(buf, "%" SCNd64, &val) != 1)
+		return -1;
+	return val;
+}
+
+/*
+ *  freq_read_msr()
+ *	read an MSR of a CPU, returns -1 on failure
+ */
+static int freq_read_msr(const freq_cpu_t *fc, const uint32_t msr, uint64_t *val)
+{
+	if (pread(fc->msr, val, sizeof(*val), (off_t)msr) != sizeof(*val))
+		return -1;
+	return 0;
+}
+
+/*
+ *  freq_init()
+ *	find the CPU frequency counters, APERF/MPERF through the
+ *	msr driver or else the cpufreq current frequency, and the
+ *	thermal throttle counters, --freq is turned off if
+ *	there are none
+ */
+void freq_init(void)
+{
+	int32_t i;
+	bool throttle = false;
+
+	if (!freq_enabled)
+		return;
+
+	freq_n = stress_get_processors_configured();
+	if (freq_n > CPU_SETSIZE)
+		freq_n = CPU_SETSIZE;
+	if (freq_n < 1)
+		freq_n = 1;
+	freq_cpus = calloc((size_t)freq_n, sizeof(*freq_cpus));
+	if (!freq_cpus) {
+		freq_enabled = false;
+		return;
+	}
+
+	freq_msr = true;
+	freq_cpufreq = true;
+	for (i = 0; i < freq_n; i++) {
+		freq_cpu_t *fc = &freq_cpus[i];
+		char path[PATH_MAX];
+		uint64_t val;
+
+		(void)snprintf(path, sizeof(path), "/dev/cpu/%" PRId32 "/msr", i);
+		fc->msr = open(path, O_RDONLY);
+		if ((fc->msr < 0) || (freq_read_msr(fc, FREQ_MSR_APERF, &val) < 0))
+			freq_msr = false;
+		if (freq_read_int(i, "cpufreq/scaling_cur_freq") <= 0)
+			freq_cpufreq = false;
+		fc->core = (int32_t)freq_read_int(i, "topology/core_id");
+		fc->package = (int32_t)freq_read_int(i, "topology/physical_package_id");
+		if (freq_read_int(i, "thermal_throttle/core_throttle_count") >= 0)
+			throttle = true;
+	}
+	if (!freq_msr) {
+		for (i = 0; i < freq_n; i++) {
+			if (freq_cpus[i].msr > -1)
+				(void)close(freq_cpus[i].msr);
+			freq_cpus[i].msr = -1;
+		}
+	}
+
+	if (!freq_msr && !freq_cpufreq && !throttle) {
+		pr_inf("freq: no readable CPU frequency or throttle counters, "
+			"frequency will not be reported\n");
+		freq_free();
+		return;
+	}
+	pr_dbg("freq: reading %s%s\n",
+		freq_msr ? "APERF/MPERF" :
+		(freq_cpufreq ? "cpufreq scaling_cur_freq" : "no frequency"),
+		throttle ? " and thermal throttle counts" : "");
+}
+
+/*
+ *  freq_take()
+ *	sample scaling_cur_freq of the CPUs stressors run on
+ */
+static void freq_take(void)
+{
+	int32_t i;
+
+	for (i = 0; i < freq_n; i++) {
+		int64_t khz;
+
+		if (!CPU_ISSET(i, &freq_sampled))
+			continue;
+		khz = freq_read_int(i, "cpufreq/scaling_cur_freq");
+		if (khz <= 0)
+			continue;
+		freq_cpus[i].khz_sum += (double)khz;
+		freq_cpus[i].khz_n++;
+	}
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  freq_thread_func()
+ *	sample scaling_cur_freq until told to stop
+ */
+static void *freq_thread_func(void *arg)
+{
+	(void)arg;
+
+	while (freq_run) {
+		(void)shim_usleep(FREQ_POLL_USEC);
+		freq_take();
+	}
+	return NULL;
+}
+#endif
+
+/*
+ *  freq_start()
+ *	note the CPUs the instances of each stressor can
+ *	run on and the counters at the start of a run
+ */
+void freq_start(proc_info_t *procs_list)
+{
+	proc_info_t *pi;
+	int32_t i;
+#if defined(HAVE_LIB_PTHREAD)
+	int ret;
+#endif
+
+	if (!freq_enabled)
+		return;
+
+	CPU_ZERO(&freq_sampled);
+	for (pi = procs_list; pi; pi = pi->next) {
+		int32_t j;
+
+		CPU_ZERO(&pi->freq_cpus);
+		for (j = 0; j < pi->started_procs; j++) {
+			cpu_set_t mask;
+
+			if ((pi->pids[j] <= 0) ||
+			    (sched_getaffinity(pi->pids[j], sizeof(mask), &mask) < 0))
+				continue;
+			CPU_OR(&pi->freq_cpus, &pi->freq_cpus, &mask);
+		}
+		CPU_OR(&freq_sampled, &freq_sampled, &pi->freq_cpus);
+	}
+
+	for (i = 0; i < freq_n; i++) {
+		freq_cpu_t *fc = &freq_cpus[i];
+
+		fc->khz_sum = 0.0;
+		fc->khz_n = 0;
+		fc->core_throttle = freq_read_int(i, "thermal_throttle/core_throttle_count");
+		fc->package_throttle = freq_read_int(i, "thermal_throttle/package_throttle_count");
+		if (freq_msr &&
+		    ((freq_read_msr(fc, FREQ_MSR_TSC, &fc->tsc) < 0) ||
+		     (freq_read_msr(fc, FREQ_MSR_MPERF, &fc->mperf) < 0) ||
+		     (freq_read_msr(fc, FREQ_MSR_APERF, &fc->aperf) < 0)))
+			fc->tsc = fc->mperf = fc->aperf = 0;
+	}
+	freq_run_time = time_now();
+
+	if (!freq_cpufreq || freq_msr)
+		return;
+	freq_take();
+#if defined(HAVE_LIB_PTHREAD)
+	freq_run = true;
+	ret = pthread_create(&freq_thread, NULL, freq_thread_func, NULL);
+	freq_running = (ret == 0);
+	if (!freq_running)
+		pr_err("Cannot create frequency sampling thread, errno=%d (%s)\n",
+			ret, strerror(ret));
+#endif
+}
+
+/*
+ *  freq_delta()
+ *	counter at the end of the run minus at its
+ *	start, -1 if it could not be read at either
+ */
+static int64_t freq_delta(const int64_t start, const int64_t end)
+{
+	if ((start < 0) || (end < start))
+		return -1;
+	return end - start;
+}
+
+/*
+ *  freq_throttle_count()
+ *	thermal throttle events counted during the run on the
+ *	CPUs in set. SMT siblings share a core counter and all
+ *	the cores of a package share a package counter, so each
+ *	is only counted once, -1 if none could be read
+ */
+static int64_t freq_throttle_count(const cpu_set_t *set)
+{
+	int64_t count = -1;
+	int32_t i;
+
+	for (i = 0; i < freq_n; i++) {
+		const freq_cpu_t *fc = &freq_cpus[i];
+		int32_t k;
+		bool core_seen = false, package_seen = false;
+
+		if (!CPU_ISSET(i, set))
+			continue;
+		for (k = 0; k < i; k++) {
+			if (!CPU_ISSET(k, set) ||
+			    (freq_cpus[k].package != fc->package))
+				continue;
+			package_seen = true;
+			if (freq_cpus[k].core == fc->core)
+				core_seen = true;
+		}
+		if (!core_seen && (fc->core_throttle >= 0))
+			count = ((count < 0) ? 0 : count) + fc->core_throttle;
+		if (!package_seen && (fc->package_throttle >= 0))
+			count = ((count < 0) ? 0 : count) + fc->package_throttle;
+	}
+	return count;
+}
+
+/*
+ *  freq_stop()
+ *	work out the effective frequency and throttle
+ *	events on the CPUs of each stressor during the run.
+ *	APERF/MPERF gives the frequency while not idle, the
+ *	cpufreq samples also include the CPUs' idle time
+ */
+void freq_stop(proc_info_t *procs_list)
+{
+	const double secs = time_now() - freq_run_time;
+	proc_info_t *pi;
+	uint64_t tsc_sum = 0;
+	int32_t i, tsc_n = 0;
+
+	if (!freq_enabled)
+		return;
+
+#if defined(HAVE_LIB_PTHREAD)
+	if (freq_running) {
+		freq_run = false;
+		(void)pthread_join(freq_thread, NULL);
+		freq_running = false;
+	}
+#endif
+	if (freq_cpufreq && !freq_msr)
+		freq_take();
+
+	for (i = 0; i < freq_n; i++) {
+		freq_cpu_t *fc = &freq_cpus[i];
+		uint64_t tsc, mperf, aperf;
+
+		fc->core_throttle = freq_delta(fc->core_throttle,
+			freq_read_int(i, "thermal_throttle/core_throttle_count"));
+		fc->package_throttle = freq_delta(fc->package_throttle,
+			freq_read_int(i, "thermal_throttle/package_throttle_count"));
+		if (!freq_msr || !fc->tsc ||
+		    (freq_read_msr(fc, FREQ_MSR_TSC, &tsc) < 0) ||
+		    (freq_read_msr(fc, FREQ_MSR_MPERF, &mperf) < 0) ||
+		    (freq_read_msr(fc, FREQ_MSR_APERF, &aperf) < 0)) {
+			fc->tsc = fc->mperf = fc->aperf = 0;
+			continue;
+		}
+		fc->tsc = tsc - fc->tsc;
+		fc->mperf = mperf - fc->mperf;
+		fc->aperf = aperf - fc->aperf;
+		tsc_sum += fc->tsc;
+		tsc_n++;
+	}
+	freq_tsc_hz = (tsc_n && (secs > 0.0)) ?
+		(double)tsc_sum / (double)tsc_n / secs : 0.0;
+
+	for (pi = procs_list; pi; pi = pi->next) {
+		double aperf = 0.0, mperf = 0.0, khz = 0.0;
+		int32_t khz_n = 0;
+
+		pi->freq_ghz = 0.0;
+		for (i = 0; i < freq_n; i++) {
+			const freq_cpu_t *fc = &freq_cpus[i];
+
+			if (!CPU_ISSET(i, &pi->freq_cpus))
+				continue;
+			aperf += (double)fc->aperf;
+			mperf += (double)fc->mperf;
+			if (fc->khz_n) {
+				khz += fc->khz_sum / (double)fc->khz_n;
+				khz_n++;
+			}
+		}
+		pi->freq_throttle = freq_throttle_count(&pi->freq_cpus);
+		if ((mperf > 0.0) && (freq_tsc_hz > 0.0))
+			pi->freq_ghz = freq_tsc_hz * aperf / mperf / 1E9;
+		else if (khz_n)
+			pi->freq_ghz = khz / (double)khz_n / 1E6;
+	}
+}
+
+/*
+ *  freq_metrics_dump()
+ *	output the effective GHz and throttle events of the
+ *	CPUs of a stressor and its bogo ops per GHz-second,
+ *	its bogo ops/s with the frequency scaled out
+ */
+void freq_metrics_dump(FILE *yaml, const proc_info_t *pi)
+{
+	uint64_t c_total = 0;
+	double r_total = 0.0;
+	int32_t j;
+
+	if (!freq_enabled || ((pi->freq_ghz <= 0.0) && (pi->freq_throttle < 0)))
+		return;
+
+	for (j = 0; j < pi->started_procs; j++) {
+		c_total += pi->stats[j]->counter;
+		r_total += pi->stats[j]->finish - pi->stats[j]->start;
+	}
+	r_total = pi->started_procs ? r_total / (double)pi->started_procs : 0.0;
+
+	if (pi->freq_ghz > 0.0) {
+		const double ops_per_ghz_sec = (r_total > 0.0) ?
+			(double)c_total / (pi->freq_ghz * r_total) : 0.0;
+
+		pr_inf("  %-15s %.3f GHz %s, %.2f bogo ops per GHz-second\n",
+			"frequency", pi->freq_ghz,
+			freq_msr ? "(APERF/MPERF)" : "(cpufreq)", ops_per_ghz_sec);
+		pr_yaml(yaml, "      effective-ghz: %f\n", pi->freq_ghz);
+		pr_yaml(yaml, "      bogo-ops-per-ghz-second: %f\n", ops_per_ghz_sec);
+		compare_add(munge_underscore(pi->stressor->name),
+			"bogo-ops-per-ghz-second", COMPARE_HIGHER, ops_per_ghz_sec);
+	}
+	if (pi->freq_throttle >= 0) {
+		pr_inf("  %-15s %" PRId64 " thermal throttle events\n",
+			"throttle", pi->freq_throttle);
+		pr_yaml(yaml, "      throttle-events: %" PRId64 "\n", pi->freq_throttle);
+	}
+}
+
+/*
+ *  freq_free()
+ *	close the MSRs
+ */
+void freq_free(void)
+{
+	int32_t i;
+
+	for (i = 0; freq_cpus && (i < freq_n); i++)
+		if (freq_cpus[i].msr > -1)
+			(void)close(freq_cpus[i].msr);
+	free(freq_cpus);
+	freq_cpus = NULL;
+	freq_n = 0;
+	freq_enabled = false;
+}
+
+#else
+
+void freq_init(void)
+{
+	if (freq_enabled)
+		pr_inf("freq: CPU frequency is not supported on this system\n");
+	freq_enabled = false;
+}
+
+void freq_start(proc_info_t *procs_list)
+{
+	(void)procs_list;
+}
+
+void freq_stop(proc_info_t *procs_list)
+{
+	(void)procs_list;
+}
+
+void freq_metrics_dump(FILE *yaml, const proc_info_t *pi)
+{
+	(void)yaml;
+	(void)pi;
+}
+
+void freq_free(void)
+{
+}
+
+#endif
@@ -200,6 +200,33 @@ uint64_t stress_get_phys_mem_size(void)
 #endif
 }
 
+/*
+ *  stress_get_pss()
+ *	get the proportional set size of this process in KB,
+ *	shared pages are split between the processes mapping
+ *	them, return 0 if failed
+ */
+uint64_t stress_get_pss(void)
+{
+#if defined(__linux__)
+	FILE *fp;
+	char buf[128];
+	uint64_t pss = 0;
+
+	fp = fopen("/proc/self/smaps_rollup", "r");
+	if (!fp)
+		return 0ULL;
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (sscanf(buf, "Pss: %" SCNu64, &pss) == 1)
+			break;
+	}
+	(void)fclose(fp);
+	return pss;
+#else
+	return 0ULL;
+#endif
+}
+
 /*
  *  stress_get_filesystem_size()
  *	get size of free space still available on the
@@ -24,12 +24,13 @@
  */
 #include "stress-ng.h"
 
-static mwc_t __mwc = {
+/* Per thread so --threads instances don't share a sequence */
+static __thread mwc_t __mwc = {
 	MWC_SEED_W,
 	MWC_SEED_Z
 };
 
-static uint8_t mwc_n8, mwc_n16;
+static __thread uint8_t mwc_n8, mwc_n16;
 
 static inline void mwc_flush(void)
 {
@@ -104,7 +105,7 @@ HOT OPTIMIZE3 uint64_t mwc64(void)
  */
 HOT OPTIMIZE3 uint16_t mwc16(void)
 {
-	static uint32_t mwc_saved;
+	static __thread uint32_t mwc_saved;
 
 	if (mwc_n16) {
 		mwc_n16--;
@@ -122,7 +123,7 @@ HOT OPTIMIZE3 uint16_t mwc16(void)
  */
 HOT OPTIMIZE3 uint8_t mwc8(void)
 {
-	static uint32_t mwc_saved;
+	static __thread uint32_t mwc_saved;
 
 	if (LIKELY(mwc_n8)) {
 		mwc_n8--;
@@ -0,0 +1,1128 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+#include "sgx/utils.h"
+
+#if defined(STRESS_PERF_STATS)
+
+#include <elf.h>
+#include <link.h>
+#include <linux/perf_event.h>
+
+/* Ring buffer data pages of a CPU, a power of 2 */
+#define PERF_SAMPLE_PAGES	(16)
+
+/* Time between ring buffer drains */
+#define PERF_SAMPLE_POLL_USEC	(50000)
+
+/* Polls to look for the enclave of a process */
+#define PERF_SAMPLE_MAPS_TRIES	(40)
+
+/* Parents walked up to find the instance of a forked process */
+#define PERF_SAMPLE_PPID_DEPTH	(8)
+
+/* Forked processes tracked on top of the instances */
+#define PERF_SAMPLE_PROCS_EXTRA	(1024)
+
+/* Deepest call chain walked */
+#define PERF_SAMPLE_CHAIN_MAX	(128)
+
+/* Shared objects to resolve symbols in */
+#define PERF_SAMPLE_IMAGES_MAX	(64)
+
+/* Symbol ids of samples that no symbol covers */
+#define PERF_SAMPLE_UNKNOWN	(~0U)
+
+/* A function symbol */
+typedef struct {
+	uint64_t addr;			/* ELF address */
+	uint64_t size;			/* size, 0 if unknown */
+	const char *name;		/* name in the image's strtab copy */
+} perf_sym_t;
+
+/* Function symbols of an ELF image */
+typedef struct {
+	char *path;			/* file the symbols were read from */
+	uint64_t start;			/* runtime start of the code */
+	uint64_t end;			/* runtime end of the code */
+	uint64_t bias;			/* runtime minus ELF address */
+	perf_sym_t *syms;		/* sorted by address */
+	size_t n;			/* number of symbols */
+	char *strtab;			/* copy of the names */
+	uint32_t first;			/* symbol id of syms[0] */
+} perf_image_t;
+
+/* A sampled process, an instance or a process it forked */
+typedef struct {
+	proc_info_t *pi;		/* stressor the samples go to, NULL if none */
+	pid_t pid;			/* process id, 0 if a free slot */
+	bool instance;			/* stressor instance, never evicted */
+	const perf_image_t *enclave;	/* enclave image of an SGX stressor */
+	uint64_t enclave_start;		/* enclave range in the process */
+	uint64_t enclave_end;
+	int maps_tries;			/* polls left to find the enclave */
+} perf_sample_proc_t;
+
+/* Ring buffer of a CPU, every sampled task on the CPU writes to it */
+typedef struct {
+	int fd;				/* event that owns the buffer */
+	void *map;			/* metadata page then the data pages */
+} perf_sample_cpu_t;
+
+static uint32_t perf_sample_hz;		/* --perf-sample */
+static bool perf_sample_callchain;	/* --perf-sample-callchain */
+static uint32_t perf_sample_top = DEFAULT_PERF_SAMPLE_TOP;
+
+static perf_image_t perf_images[PERF_SAMPLE_IMAGES_MAX];
+static size_t perf_images_n;		/* images of the stress-ng process */
+static perf_image_t perf_enclave_cpu;	/* enclave_cpu.signed.so */
+static perf_image_t perf_enclave_vm;	/* enclave_vm.signed.so */
+static uint32_t perf_syms_n;		/* symbol ids handed out */
+
+static perf_sample_proc_t *perf_procs;	/* hash table of sampled processes */
+static size_t perf_procs_n;		/* slots in use */
+static size_t perf_procs_max;		/* slots in use before evicting */
+static size_t perf_procs_mask;		/* slots - 1, a power of 2 */
+static uint64_t perf_sample_orphans;	/* samples of no known stressor */
+static perf_sample_cpu_t *perf_cpus;
+static int32_t perf_cpus_n;
+static int *perf_fds;			/* all sampling events */
+static size_t perf_fds_n;
+static size_t perf_fds_max;
+static size_t perf_map_size;		/* bytes mapped per CPU */
+static pthread_t perf_sample_thread;
+static volatile bool perf_sample_run;	/* false to stop the drain thread */
+static bool perf_sample_running;	/* drain thread created */
+
+/*
+ *  stress_set_perf_sample()
+ *	set the sampling frequency in Hz
+ */
+void stress_set_perf_sample(const char *opt)
+{
+	perf_sample_hz = get_uint32(opt);
+	check_range("perf-sample", perf_sample_hz,
+		MIN_PERF_SAMPLE, MAX_PERF_SAMPLE);
+}
+
+/*
+ *  stress_set_perf_sample_top()
+ *	set the number of functions to report per stressor
+ */
+void stress_set_perf_sample_top(const char *opt)
+{
+	perf_sample_top = get_uint32(opt);
+	check_range("perf-sample-top", perf_sample_top,
+		MIN_PERF_SAMPLE_TOP, MAX_PERF_SAMPLE_TOP);
+}
+
+/*
+ *  stress_set_perf_sample_callchain()
+ *	also sample the call chains
+ */
+void stress_set_perf_sample_callchain(void)
+{
+	perf_sample_callchain = true;
+}
+
+/*
+ *  perf_sym_cmp()
+ *	sort symbols by address
+ */
+static int perf_sym_cmp(const void *p1, const void *p2)
+{
+	const perf_sym_t *s1 = (const perf_sym_t *)p1;
+	const perf_sym_t *s2 = (const perf_sym_t *)p2;
+
+	return (s1->addr > s2->addr) - (s1->addr < s2->addr);
+}
+
+/*
+ *  perf_image_load()
+ *	read the function symbols of an ELF file, from its
+ *	symtab or else its dynsym, returns -1 if it has none
+ */
+static int perf_image_load(perf_image_t *img, const char *path)
+{
+	const ElfW(Ehdr) *ehdr;
+	const ElfW(Shdr) *shdr, *symtab = NULL, *strtab;
+	const ElfW(Sym) *sym;
+	struct stat statbuf;
+	uint8_t *base;
+	size_t i, n;
+	int fd, rc = -1;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if ((fstat(fd, &statbuf) < 0) ||
+	    ((size_t)statbuf.st_size < sizeof(*ehdr))) {
+		(void)close(fd);
+		return -1;
+	}
+	base = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void)close(fd);
+	if (base == MAP_FAILED)
+		return -1;
+
+	ehdr = (const ElfW(Ehdr) *)base;
+	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+	    (ehdr->e_ident[EI_CLASS] != (sizeof(void *) == 8 ? ELFCLASS64 : ELFCLASS32)) ||
+	    (ehdr->e_shentsize != sizeof(*shdr)) ||
+	    (ehdr->e_shoff + (uint64_t)ehdr->e_shnum * sizeof(*shdr) >
+	     (uint64_t)statbuf.st_size))
+		goto out;
+
+	shdr = (const ElfW(Shdr) *)(base + ehdr->e_shoff);
+	for (i = 0; i < ehdr->e_shnum; i++) {
+		if (shdr[i].sh_type == SHT_SYMTAB)
+			symtab = &shdr[i];
+		else if ((shdr[i].sh_type == SHT_DYNSYM) && !symtab)
+			symtab = &shdr[i];
+	}
+	if (!symtab || (symtab->sh_link >= ehdr->e_shnum) ||
+	    (symtab->sh_entsize != sizeof(*sym)))
+		goto out;
+	strtab = &shdr[symtab->sh_link];
+	if ((symtab->sh_offset + symtab->sh_size > (uint64_t)statbuf.st_size) ||
+	    (strtab->sh_offset + strtab->sh_size > (uint64_t)statbuf.st_size) ||
+	    !strtab->sh_size)
+		goto out;
+
+	n = symtab->sh_size / sizeof(*sym);
+	img->syms = calloc(n, sizeof(*img->syms));
+	img->strtab = malloc(strtab->sh_size + 1);
+	if (!img->syms || !img->strtab)
+		goto out;
+	(void)memcpy(img->strtab, base + strtab->sh_offset, strtab->sh_size);
+	img->strtab[strtab->sh_size] = '\0';
+
+	sym = (const ElfW(Sym) *)(base + symtab->sh_offset);
+	for (img->n = 0, i = 0; i < n; i++) {
+		const int type = sym[i].st_info & 0xf;
+
+		if (((type != STT_FUNC) && (type != STT_GNU_IFUNC)) ||
+		    (sym[i].st_shndx == SHN_UNDEF) || !sym[i].st_value ||
+		    (sym[i].st_name >= strtab->sh_size))
+			continue;
+		img->syms[img->n].addr = sym[i].st_value;
+		img->syms[img->n].size = sym[i].st_size;
+		img->syms[img->n].name = img->strtab + sym[i].st_name;
+		img->n++;
+	}
+	if (!img->n)
+		goto out;
+	qsort(img->syms, img->n, sizeof(*img->syms), perf_sym_cmp);
+
+	img->path = strdup(path);
+	img->first = perf_syms_n;
+	perf_syms_n += (uint32_t)img->n;
+	rc = 0;
+out:
+	if (rc < 0) {
+		free(img->syms);
+		free(img->strtab);
+		img->syms = NULL;
+		img->strtab = NULL;
+		img->n = 0;
+	}
+	(void)munmap(base, (size_t)statbuf.st_size);
+	return rc;
+}
+
+/*
+ *  perf_image_free()
+ *	free the symbols of an image
+ */
+static void perf_image_free(perf_image_t *img)
+{
+	free(img->path);
+	free(img->syms);
+	free(img->strtab);
+	(void)memset(img, 0, sizeof(*img));
+}
+
+/*
+ *  perf_image_phdr()
+ *	dl_iterate_phdr() callback, load the symbols of the
+ *	program and its shared objects, which the instances
+ *	inherit at the same addresses when they are forked
+ */
+static int perf_image_phdr(struct dl_phdr_info *info, size_t size, void *data)
+{
+	perf_image_t *img;
+	uint64_t start = ~0ULL, end = 0;
+	const char *path;
+	int i;
+
+	(void)size;
+	(void)data;
+
+	if (perf_images_n >= PERF_SAMPLE_IMAGES_MAX)
+		return 1;
+
+	for (i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+
+		if ((phdr->p_type != PT_LOAD) || !(phdr->p_flags & PF_X))
+			continue;
+		if (phdr->p_vaddr < start)
+			start = phdr->p_vaddr;
+		if (phdr->p_vaddr + phdr->p_memsz > end)
+			end = phdr->p_vaddr + phdr->p_memsz;
+	}
+	if (start >= end)
+		return 0;
+
+	/* The program itself has no name */
+	path = (info->dlpi_name && *info->dlpi_name) ?
+		info->dlpi_name : "/proc/self/exe";
+	img = &perf_images[perf_images_n];
+	if (perf_image_load(img, path) < 0)
+		return 0;
+	img->bias = info->dlpi_addr;
+	img->start = img->bias + start;
+	img->end = img->bias + end;
+	perf_images_n++;
+
+	return 0;
+}
+
+/*
+ *  perf_image_lookup()
+ *	symbol id of the function at ELF address addr of an
+ *	image, PERF_SAMPLE_UNKNOWN if no symbol covers it
+ */
+static uint32_t perf_image_lookup(const perf_image_t *img, const uint64_t addr)
+{
+	size_t lo = 0, hi = img->n;
+	const perf_sym_t *sym;
+
+	if (!img->n || (addr < img->syms[0].addr))
+		return PERF_SAMPLE_UNKNOWN;
+
+	/* Last symbol at or below addr */
+	while (hi - lo > 1) {
+		const size_t mid = (lo + hi) / 2;
+
+		if (img->syms[mid].addr <= addr)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	sym = &img->syms[lo];
+	if (sym->size && (addr >= sym->addr + sym->size))
+		return PERF_SAMPLE_UNKNOWN;
+	return img->first + (uint32_t)lo;
+}
+
+/*
+ *  perf_sample_resolve()
+ *	symbol id of an address sampled in a process
+ */
+static uint32_t perf_sample_resolve(const perf_sample_proc_t *proc, const uint64_t ip)
+{
+	size_t i;
+
+	if (proc->enclave && (ip >= proc->enclave_start) && (ip < proc->enclave_end))
+		return perf_image_lookup(proc->enclave, ip - proc->enclave_start);
+
+	for (i = 0; i < perf_images_n; i++) {
+		const perf_image_t *img = &perf_images[i];
+
+		if ((ip >= img->start) && (ip < img->end))
+			return perf_image_lookup(img, ip - img->bias);
+	}
+	return PERF_SAMPLE_UNKNOWN;
+}
+
+/*
+ *  perf_sample_name()
+ *	name of a symbol id, with the image it is
+ *	in unless that is stress-ng itself
+ */
+static const char *perf_sample_name(const uint32_t id, char *buf, const size_t len)
+{
+	const perf_image_t *images[PERF_SAMPLE_IMAGES_MAX + 2];
+	size_t i, n = 0;
+
+	if (id == PERF_SAMPLE_UNKNOWN)
+		return "[unknown]";
+
+	for (i = 0; i < perf_images_n; i++)
+		images[n++] = &perf_images[i];
+	images[n++] = &perf_enclave_cpu;
+	images[n++] = &perf_enclave_vm;
+
+	for (i = 0; i < n; i++) {
+		const perf_image_t *img = images[i];
+		const char *base;
+
+		if (!img->n || (id < img->first) || (id >= img->first + img->n))
+			continue;
+		if (img == &perf_images[0])
+			return img->syms[id - img->first].name;
+		base = strrchr(img->path, '/');
+		(void)snprintf(buf, len, "%s [%s]",
+			img->syms[id - img->first].name, base ? base + 1 : img->path);
+		return buf;
+	}
+	return "[unknown]";
+}
+
+/*
+ *  perf_sample_hot()
+ *	hot spot entry of a symbol id in a stressor's fixed size
+ *	table, NULL once the table is full
+ */
+static perf_hot_t *perf_sample_hot(proc_info_t *pi, const uint32_t id)
+{
+	const uint32_t key = id + 1;	/* 0 marks a free entry */
+	uint32_t i, h = (key * 2654435761U) & (PERF_SAMPLE_HOT_MAX - 1);
+
+	for (i = 0; i < PERF_SAMPLE_HOT_MAX; i++) {
+		perf_hot_t *hot = &pi->perf_hot[(h + i) & (PERF_SAMPLE_HOT_MAX - 1)];
+
+		if (hot->key == key)
+			return hot;
+		if (!hot->key) {
+			hot->key = key;
+			return hot;
+		}
+	}
+	return NULL;
+}
+
+/*
+ *  perf_sample_add()
+ *	add a sample to the hot spots of the process's stressor,
+ *	the function at ip gets a self sample and every function
+ *	in the call chain one total sample
+ */
+static void perf_sample_add(
+	const perf_sample_proc_t *proc,
+	const uint64_t ip,
+	const uint64_t *chain,
+	const uint64_t nr)
+{
+	proc_info_t *pi = proc->pi;
+	uint32_t seen[PERF_SAMPLE_CHAIN_MAX + 1];
+	size_t n = 0;
+	uint64_t i;
+	perf_hot_t *hot;
+
+	pi->perf_samples++;
+	seen[n++] = perf_sample_resolve(proc, ip);
+	for (i = 0; (i < nr) && (n < SIZEOF_ARRAY(seen)); i++) {
+		uint32_t id;
+		size_t k;
+
+		/* Skip the user and kernel context markers */
+		if (chain[i] >= (uint64_t)PERF_CONTEXT_MAX)
+			continue;
+		id = perf_sample_resolve(proc, chain[i]);
+		for (k = 0; (k < n) && (seen[k] != id); k++)
+			;
+		if (k == n)
+			seen[n++] = id;
+	}
+
+	hot = perf_sample_hot(pi, seen[0]);
+	if (!hot) {
+		pi->perf_other++;
+		return;
+	}
+	hot->self++;
+	for (i = 0; i < n; i++) {
+		hot = perf_sample_hot(pi, seen[i]);
+		if (hot)
+			hot->total++;
+	}
+}
+
+/*
+ *  perf_sample_copy()
+ *	copy len bytes at offset off out of the ring buffer
+ */
+static void perf_sample_copy(
+	void *dst,
+	const uint8_t *data,
+	const uint64_t size,
+	const uint64_t off,
+	const size_t len)
+{
+	const uint64_t pos = off & (size - 1);
+	const size_t first = (pos + len > size) ? (size_t)(size - pos) : len;
+
+	(void)memcpy(dst, data + pos, first);
+	(void)memcpy((uint8_t *)dst + first, data, len - first);
+}
+
+/*
+ *  perf_sample_enclave_dev()
+ *	true if a /proc/pid/maps line maps an enclave device,
+ *	the in-kernel driver's /dev/sgx_enclave or the out of
+ *	tree drivers' /dev/isgx, /dev/sgx or /dev/sgx/enclave,
+ *	but not the libsgx_* host libraries
+ */
+static bool perf_sample_enclave_dev(const char *line)
+{
+	static const char * const devs[] = {
+		"/dev/sgx_enclave",
+		"/dev/isgx",
+		"/dev/sgx",
+		"/dev/sgx/enclave",
+	};
+	const char *path = strchr(line, '/');
+	size_t i, len;
+
+	if (!path)
+		return false;
+	len = strcspn(path, " \n");
+	for (i = 0; i < SIZEOF_ARRAY(devs); i++) {
+		if ((len == strlen(devs[i])) && !strncmp(path, devs[i], len))
+			return true;
+	}
+	return false;
+}
+
+/*
+ *  perf_sample_maps()
+ *	find the enclave range of a process of an SGX
+ *	stressor, the enclave device mappings in its
+ *	address space
+ */
+static void perf_sample_maps(perf_sample_proc_t *proc)
+{
+	char path[PATH_MAX], line[PATH_MAX + 128];
+	FILE *fp;
+
+	proc->maps_tries--;
+	(void)snprintf(path, sizeof(path), "/proc/%d/maps", (int)proc->pid);
+	fp = fopen(path, "r");
+	if (!fp)
+		return;
+	while (fgets(line, sizeof(line), fp)) {
+		uint64_t start, end;
+
+		if (!perf_sample_enclave_dev(line))
+			continue;
+		if (sscanf(line, "%" SCNx64 "-%" SCNx64, &start, &end) != 2)
+			continue;
+		if (!proc->enclave_end || (start < proc->enclave_start))
+			proc->enclave_start = start;
+		if (end > proc->enclave_end)
+			proc->enclave_end = end;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  perf_sample_proc_slot()
+ *	slot of process pid in the hash table, or the
+ *	free slot it goes in if it is not there
+ */
+static perf_sample_proc_t *perf_sample_proc_slot(const pid_t pid)
+{
+	size_t i = ((uint32_t)pid * 2654435761U) & perf_procs_mask;
+
+	while (perf_procs[i].pid && (perf_procs[i].pid != pid))
+		i = (i + 1) & perf_procs_mask;
+	return &perf_procs[i];
+}
+
+/*
+ *  perf_sample_proc_evict()
+ *	drop the forked processes that have exited from
+ *	the hash table, the instances are kept
+ */
+static void perf_sample_proc_evict(void)
+{
+	perf_sample_proc_t *live;
+	size_t i, n = 0;
+
+	live = malloc(perf_procs_n * sizeof(*live));
+	if (!live)
+		return;
+	for (i = 0; i <= perf_procs_mask; i++) {
+		const perf_sample_proc_t *proc = &perf_procs[i];
+
+		if (!proc->pid)
+			continue;
+		if (!proc->instance && (kill(proc->pid, 0) < 0) && (errno == ESRCH))
+			continue;
+		live[n++] = *proc;
+	}
+	(void)memset(perf_procs, 0, (perf_procs_mask + 1) * sizeof(*perf_procs));
+	for (i = 0; i < n; i++)
+		*perf_sample_proc_slot(live[i].pid) = live[i];
+	perf_procs_n = n;
+	free(live);
+}
+
+/*
+ *  perf_sample_proc_add()
+ *	start attributing the samples of process pid to pi,
+ *	NULL if the table is full of live processes
+ */
+static perf_sample_proc_t *perf_sample_proc_add(
+	proc_info_t *pi,
+	const pid_t pid,
+	const perf_image_t *enclave,
+	const bool instance)
+{
+	perf_sample_proc_t *proc;
+
+	if (perf_procs_n >= perf_procs_max) {
+		perf_sample_proc_evict();
+		if (perf_procs_n >= perf_procs_max)
+			return NULL;
+	}
+	proc = perf_sample_proc_slot(pid);
+	if (!proc->pid)
+		perf_procs_n++;
+	(void)memset(proc, 0, sizeof(*proc));
+	proc->pi = pi;
+	proc->pid = pid;
+	proc->instance = instance;
+	proc->enclave = enclave;
+	proc->maps_tries = PERF_SAMPLE_MAPS_TRIES;
+	return proc;
+}
+
+/*
+ *  perf_sample_ppid()
+ *	parent of process pid, -1 if it has gone
+ */
+static pid_t perf_sample_ppid(const pid_t pid)
+{
+	char path[64], buf[512], *ptr;
+	int ppid;
+	ssize_t ret;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	ret = system_read(path, buf, sizeof(buf) - 1);
+	if (ret <= 0)
+		return -1;
+	buf[ret] = '\0';
+	/* The command name may hold spaces and parentheses */
+	ptr = strrchr(buf, ')');
+	if (!ptr || (sscanf(ptr + 1, " %*c %d", &ppid) != 1))
+		return -1;
+	return (pid_t)ppid;
+}
+
+/*
+ *  perf_sample_proc()
+ *	process a sample of pid is attributed to. Inherited
+ *	events also sample the processes an instance forks,
+ *	such as the sgx-vm worker, these are found from their
+ *	parents and added, as are processes no stressor could
+ *	be found for so that their later samples are not
+ *	looked up again. NULL if the samples cannot be
+ *	attributed, *pi is then the stressor of the nearest
+ *	known parent, if there is one
+ */
+static perf_sample_proc_t *perf_sample_proc(const pid_t pid, proc_info_t **pi)
+{
+	const perf_sample_proc_t *parent = NULL;
+	perf_sample_proc_t *proc;
+	pid_t ppid = pid;
+	int depth;
+
+	proc = perf_sample_proc_slot(pid);
+	if (proc->pid) {
+		*pi = proc->pi;
+		return proc->pi ? proc : NULL;
+	}
+	for (depth = 0; depth < PERF_SAMPLE_PPID_DEPTH; depth++) {
+		ppid = perf_sample_ppid(ppid);
+		if (ppid <= 1)
+			break;
+		proc = perf_sample_proc_slot(ppid);
+		if (proc->pid) {
+			parent = proc;
+			break;
+		}
+	}
+	*pi = parent ? parent->pi : NULL;
+	proc = perf_sample_proc_add(*pi, pid, parent ? parent->enclave : NULL, false);
+	if (!proc || !proc->pi)
+		return NULL;
+	if (proc->enclave)
+		perf_sample_maps(proc);
+	return proc;
+}
+
+/*
+ *  perf_sample_drain()
+ *	consume the samples in a CPU's ring buffer
+ */
+static void perf_sample_drain(perf_sample_cpu_t *cpu)
+{
+	struct perf_event_mmap_page *meta = cpu->map;
+	const uint8_t *data = (const uint8_t *)cpu->map + meta->data_offset;
+	const uint64_t size = meta->data_size;
+	const uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+	uint64_t tail = meta->data_tail;
+
+	while (tail + sizeof(struct perf_event_header) <= head) {
+		struct perf_event_header hdr;
+		/* ip, pid and tid, nr then the call chain */
+		uint64_t rec[3 + PERF_SAMPLE_CHAIN_MAX];
+		perf_sample_proc_t *proc;
+		proc_info_t *pi;
+		size_t len;
+
+		perf_sample_copy(&hdr, data, size, tail, sizeof(hdr));
+		if ((hdr.size < sizeof(hdr)) || (tail + hdr.size > head))
+			break;
+		len = hdr.size - sizeof(hdr);
+		if (len > sizeof(rec))
+			len = sizeof(rec);
+		perf_sample_copy(rec, data, size, tail + sizeof(hdr), len);
+
+		if ((hdr.type == PERF_RECORD_SAMPLE) && (len >= 2 * sizeof(rec[0]))) {
+			uint64_t nr = 0;
+
+			/* pid is the low 32 bits of the pid, tid pair */
+			proc = perf_sample_proc((pid_t)(uint32_t)rec[1], &pi);
+			if (proc) {
+				if (perf_sample_callchain && (len >= 3 * sizeof(rec[0]))) {
+					nr = rec[2];
+					if (nr > (len / sizeof(rec[0])) - 3)
+						nr = (len / sizeof(rec[0])) - 3;
+				}
+				perf_sample_add(proc, rec[0], &rec[3], nr);
+			} else if (pi) {
+				/* Stressor known but the process table is full */
+				pi->perf_samples++;
+				pi->perf_other++;
+			} else {
+				perf_sample_orphans++;
+			}
+		} else if ((hdr.type == PERF_RECORD_LOST) && (len >= 3 * sizeof(rec[0]))) {
+			/* id, lost then the sample_id pid, tid pair */
+			(void)perf_sample_proc((pid_t)(uint32_t)rec[2], &pi);
+			if (pi)
+				pi->perf_lost += rec[1];
+		}
+		tail += hdr.size;
+	}
+	__atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+/*
+ *  perf_sample_drain_all()
+ *	look for the enclaves not yet found then
+ *	consume the samples of every CPU
+ */
+static void perf_sample_drain_all(void)
+{
+	size_t i;
+	int32_t c;
+
+	for (i = 0; perf_procs && (i <= perf_procs_mask); i++) {
+		perf_sample_proc_t *proc = &perf_procs[i];
+
+		if (proc->pid && proc->enclave && !proc->enclave_end &&
+		    (proc->maps_tries > 0))
+			perf_sample_maps(proc);
+	}
+	for (c = 0; c < perf_cpus_n; c++)
+		if (perf_cpus[c].map)
+			perf_sample_drain(&perf_cpus[c]);
+}
+
+/*
+ *  perf_sample_thread_func()
+ *	drain the ring buffers until told to stop
+ */
+static void *perf_sample_thread_func(void *arg)
+{
+	(void)arg;
+
+	while (perf_sample_run) {
+		perf_sample_drain_all();
+		(void)shim_usleep(PERF_SAMPLE_POLL_USEC);
+	}
+	return NULL;
+}
+
+/*
+ *  perf_sample_open()
+ *	open a sampling event on thread tid while it runs on
+ *	cpu, CPU cycles where there is a PMU or else the CPU
+ *	clock. The event is inherited by the threads and
+ *	processes tid creates and all events on a CPU share
+ *	the ring buffer of the first one opened there
+ */
+static int perf_sample_open(const pid_t tid, const int32_t cpu)
+{
+	struct perf_event_attr attr;
+	perf_sample_cpu_t *pc = &perf_cpus[cpu];
+	int fd;
+
+	if (perf_fds_n >= perf_fds_max) {
+		const size_t max = perf_fds_max ? perf_fds_max * 2 : 64;
+		int *fds;
+
+		fds = realloc(perf_fds, max * sizeof(*fds));
+		if (!fds)
+			return -1;
+		perf_fds = fds;
+		perf_fds_max = max;
+	}
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.freq = 1;
+	attr.sample_freq = perf_sample_hz;
+	attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID |
+		(perf_sample_callchain ? PERF_SAMPLE_CALLCHAIN : 0);
+	attr.sample_id_all = 1;
+	attr.inherit = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.exclude_callchain_kernel = 1;
+
+	fd = syscall(__NR_perf_event_open, &attr, tid, cpu, -1, 0);
+	if (fd < 0) {
+		attr.type = PERF_TYPE_SOFTWARE;
+		attr.config = PERF_COUNT_SW_CPU_CLOCK;
+		fd = syscall(__NR_perf_event_open, &attr, tid, cpu, -1, 0);
+		if (fd < 0)
+			return -1;
+	}
+	if (!pc->map) {
+		void *map;
+
+		map = mmap(NULL, perf_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (map == MAP_FAILED) {
+			(void)close(fd);
+			return -1;
+		}
+		pc->fd = fd;
+		pc->map = map;
+	} else if (ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT, pc->fd) < 0) {
+		(void)close(fd);
+		return -1;
+	}
+	perf_fds[perf_fds_n++] = fd;
+	return 0;
+}
+
+/*
+ *  perf_sample_tasks()
+ *	open the sampling events of every thread of an instance
+ *	on every CPU. The threads are listed before the main one
+ *	is opened, threads it creates after that inherit its
+ *	events and are not opened twice. Returns the number of
+ *	events opened
+ */
+static size_t perf_sample_tasks(const pid_t pid)
+{
+	char path[64];
+	DIR *dir;
+	struct dirent *entry;
+	pid_t *tids = NULL;
+	size_t tids_n = 0, tids_max = 0, i, opened = 0;
+	int32_t c;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+	dir = opendir(path);
+	if (dir) {
+		while ((entry = readdir(dir)) != NULL) {
+			const pid_t tid = (pid_t)atoi(entry->d_name);
+
+			if ((tid <= 0) || (tid == pid))
+				continue;
+			if (tids_n >= tids_max) {
+				const size_t max = tids_max ? tids_max * 2 : 16;
+				pid_t *tmp = realloc(tids, max * sizeof(*tids));
+
+				if (!tmp)
+					break;
+				tids = tmp;
+				tids_max = max;
+			}
+			tids[tids_n++] = tid;
+		}
+		(void)closedir(dir);
+	}
+
+	for (c = 0; c < perf_cpus_n; c++) {
+		if (perf_sample_open(pid, c) == 0)
+			opened++;
+		for (i = 0; i < tids_n; i++)
+			if (perf_sample_open(tids[i], c) == 0)
+				opened++;
+	}
+	free(tids);
+	return opened;
+}
+
+/*
+ *  perf_sample_enclave()
+ *	enclave image of the stressor, NULL if it has none
+ */
+static const perf_image_t *perf_sample_enclave(const proc_info_t *pi)
+{
+	const perf_image_t *img;
+
+	if (!stress_sgx_stressor(pi->stressor->id))
+		return NULL;
+	img = (pi->stressor->id == STRESS_SGX_VM) ?
+		&perf_enclave_vm : &perf_enclave_cpu;
+	return img->n ? img : NULL;
+}
+
+/*
+ *  perf_sample_start()
+ *	start sampling the instances of the stressors in
+ *	procs_list, and every thread and process they create,
+ *	whose samples a thread drains into each stressor's
+ *	hot spot table
+ */
+void perf_sample_start(proc_info_t *procs_list)
+{
+	proc_info_t *pi;
+	size_t slots = 1;
+	int ret;
+
+	if (!perf_sample_hz)
+		return;
+
+	if (!perf_images_n) {
+		(void)dl_iterate_phdr(perf_image_phdr, NULL);
+		(void)perf_image_load(&perf_enclave_cpu, ENCLAVE_CPU_FILENAME);
+		(void)perf_image_load(&perf_enclave_vm, ENCLAVE_VM_FILENAME);
+	}
+
+	perf_cpus_n = stress_get_processors_configured();
+	if (perf_cpus_n < 1)
+		perf_cpus_n = 1;
+	perf_cpus = calloc((size_t)perf_cpus_n, sizeof(*perf_cpus));
+	if (!perf_cpus)
+		return;
+	perf_map_size = (PERF_SAMPLE_PAGES + 1) * stress_get_pagesize();
+
+	/*
+	 *  Room for every instance and a bounded number of the
+	 *  processes they fork, the table is kept at most half
+	 *  full so the hash probes stay short
+	 */
+	perf_procs_max = PERF_SAMPLE_PROCS_EXTRA;
+	for (pi = procs_list; pi; pi = pi->next)
+		perf_procs_max += (size_t)pi->started_procs;
+	while (slots < perf_procs_max * 2)
+		slots <<= 1;
+	perf_procs = calloc(slots, sizeof(*perf_procs));
+	if (!perf_procs) {
+		free(perf_cpus);
+		perf_cpus = NULL;
+		return;
+	}
+	perf_procs_mask = slots - 1;
+	perf_procs_n = 0;
+	perf_sample_orphans = 0;
+
+	for (pi = procs_list; pi; pi = pi->next) {
+		int32_t j;
+
+		if (!pi->perf_hot) {
+			pi->perf_hot = calloc(PERF_SAMPLE_HOT_MAX, sizeof(*pi->perf_hot));
+			if (!pi->perf_hot)
+				continue;
+		}
+		for (j = 0; j < pi->started_procs; j++) {
+			/* --threads instances share a process */
+			if ((pi->pids[j] <= 0) || (j && (pi->pids[j] == pi->pids[0])))
+				continue;
+			if (!perf_sample_tasks(pi->pids[j])) {
+				pr_dbg("perf-sample: cannot sample %s instance %"
+					PRId32 ", errno=%d (%s)\n",
+					munge_underscore(pi->stressor->name), j,
+					errno, strerror(errno));
+				continue;
+			}
+			(void)perf_sample_proc_add(pi, pi->pids[j],
+				perf_sample_enclave(pi), true);
+		}
+	}
+	if (!perf_fds_n)
+		return;
+
+	perf_sample_run = true;
+	ret = pthread_create(&perf_sample_thread, NULL, perf_sample_thread_func, NULL);
+	perf_sample_running = (ret == 0);
+	if (!perf_sample_running)
+		pr_err("Cannot create perf sampling thread, errno=%d (%s)\n",
+			ret, strerror(ret));
+}
+
+/*
+ *  perf_sample_stop()
+ *	stop sampling, drain what is left and close
+ */
+void perf_sample_stop(void)
+{
+	size_t i;
+	int32_t c;
+
+	if (perf_sample_running) {
+		perf_sample_run = false;
+		(void)pthread_join(perf_sample_thread, NULL);
+		perf_sample_running = false;
+	}
+	if (perf_cpus) {
+		perf_sample_drain_all();
+		for (c = 0; c < perf_cpus_n; c++)
+			if (perf_cpus[c].map)
+				(void)munmap(perf_cpus[c].map, perf_map_size);
+	}
+	for (i = 0; i < perf_fds_n; i++)
+		(void)close(perf_fds[i]);
+	free(perf_fds);
+	perf_fds = NULL;
+	perf_fds_n = 0;
+	perf_fds_max = 0;
+	free(perf_cpus);
+	perf_cpus = NULL;
+	perf_cpus_n = 0;
+	free(perf_procs);
+	perf_procs = NULL;
+	perf_procs_n = 0;
+	perf_procs_max = 0;
+	perf_procs_mask = 0;
+}
+
+/*
+ *  perf_hot_cmp()
+ *	sort hot spots by self samples, then total samples
+ */
+static int perf_hot_cmp(const void *p1, const void *p2)
+{
+	const perf_hot_t *h1 = (const perf_hot_t *)p1;
+	const perf_hot_t *h2 = (const perf_hot_t *)p2;
+
+	if (h1->self != h2->self)
+		return (h1->self < h2->self) - (h1->self > h2->self);
+	return (h1->total < h2->total) - (h1->total > h2->total);
+}
+
+/*
+ *  perf_sample_dump()
+ *	dump the top functions of each stressor by samples
+ */
+void perf_sample_dump(FILE *yaml, proc_info_t *procs_head)
+{
+	proc_info_t *pi;
+	bool dumped_heading = false;
+	perf_hot_t *hots;
+
+	if (!perf_sample_hz)
+		return;
+	hots = calloc(PERF_SAMPLE_HOT_MAX, sizeof(*hots));
+	if (!hots)
+		return;
+
+	for (pi = procs_head; pi; pi = pi->next) {
+		const char *munged = munge_underscore(pi->stressor->name);
+		const double samples = (double)pi->perf_samples;
+		size_t i, n = 0;
+
+		if (!pi->perf_hot || !pi->perf_samples)
+			continue;
+
+		for (i = 0; i < PERF_SAMPLE_HOT_MAX; i++)
+			if (pi->perf_hot[i].key)
+				hots[n++] = pi->perf_hot[i];
+		qsort(hots, n, sizeof(*hots), perf_hot_cmp);
+
+		if (!dumped_heading) {
+			dumped_heading = true;
+			pr_yaml(yaml, "perf-samples:\n");
+		}
+		pr_inf("%s: %" PRIu64 " samples at %" PRIu32 " Hz, %" PRIu64
+			" lost\n", munged, pi->perf_samples, perf_sample_hz,
+			pi->perf_lost);
+		if (perf_sample_callchain)
+			pr_inf("%8s %8s  %s\n", "self", "total", "function");
+		else
+			pr_inf("%8s  %s\n", "self", "function");
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      frequency: %" PRIu32 "\n", perf_sample_hz);
+		pr_yaml(yaml, "      samples: %" PRIu64 "\n", pi->perf_samples);
+		pr_yaml(yaml, "      lost: %" PRIu64 "\n", pi->perf_lost);
+		pr_yaml(yaml, "      functions:\n");
+
+		for (i = 0; (i < n) && (i < perf_sample_top); i++) {
+			char buf[256];
+			const char *name = perf_sample_name(hots[i].key - 1, buf, sizeof(buf));
+			const double self = 100.0 * (double)hots[i].self / samples;
+			const double total = 100.0 * (double)hots[i].total / samples;
+
+			if (perf_sample_callchain)
+				pr_inf("%7.2f%% %7.2f%%  %s\n", self, total, name);
+			else
+				pr_inf("%7.2f%%  %s\n", self, name);
+			pr_yaml(yaml, "        - function: %s\n", name);
+			pr_yaml(yaml, "          self-percent: %f\n", self);
+			if (perf_sample_callchain)
+				pr_yaml(yaml, "          total-percent: %f\n", total);
+		}
+		if (pi->perf_other) {
+			pr_inf("%7.2f%%  %s\n", 100.0 * (double)pi->perf_other / samples,
+				"[other, beyond the hot spot or process table]");
+			pr_yaml(yaml, "      other-percent: %f\n",
+				100.0 * (double)pi->perf_other / samples);
+		}
+	}
+	if (dumped_heading)
+		pr_yaml(yaml, "\n");
+	if (perf_sample_orphans)
+		pr_inf("perf-sample: %" PRIu64 " samples of processes whose "
+			"stressor could not be found\n", perf_sample_orphans);
+	free(hots);
+}
+
+/*
+ *  perf_sample_free()
+ *	free the hot spots and symbols
+ */
+void perf_sample_free(proc_info_t *procs_head)
+{
+	proc_info_t *pi;
+	size_t i;
+
+	for (pi = procs_head; pi; pi = pi->next) {
+		free(pi->perf_hot);
+		pi->perf_hot = NULL;
+	}
+	for (i = 0; i < perf_images_n; i++)
+		perf_image_free(&perf_images[i]);
+	perf_images_n = 0;
+	perf_image_free(&perf_enclave_cpu);
+	perf_image_free(&perf_enclave_vm);
+	perf_syms_n = 0;
+}
+#endif
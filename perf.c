@@ -50,13 +50,6 @@ typedef struct {
 	char *label;			/* human readable name for perf type */
 } perf_info_t;
 
-/* perf data */
-typedef struct {
-	uint64_t counter;		/* perf counter */
-	uint64_t time_enabled;		/* perf time enabled */
-	uint64_t time_running;		/* perf time running */
-} perf_data_t;
-
 typedef struct {
 	double		threshold;
 	double		scale;
@@ -76,11 +69,14 @@ typedef struct {
 	{ PERF_TYPE_SOFTWARE, PERF_COUNT_ ## config, NULL, label }
 
 /* Hardware Cache */
+#define PERF_HW_CACHE_CONFIG(cache_id, op_id, result_id)	\
+	((PERF_COUNT_HW_CACHE_ ## cache_id) |			\
+	 ((PERF_COUNT_HW_CACHE_OP_ ## op_id) << 8) |		\
+	 ((PERF_COUNT_HW_CACHE_RESULT_ ## result_id) << 16))
+
 #define PERF_INFO_HW_C(cache_id, op_id, result_id, label)	\
-	{ PERF_TYPE_HW_CACHE, 					\
-	  (PERF_COUNT_HW_CACHE_ ## cache_id) |			\
-	  ((PERF_COUNT_HW_CACHE_OP_ ## op_id) << 8) |		\
-	  ((PERF_COUNT_HW_CACHE_RESULT_ ## result_id) << 16),	\
+	{ PERF_TYPE_HW_CACHE,					\
+	  PERF_HW_CACHE_CONFIG(cache_id, op_id, result_id),	\
 	  NULL, label }
 
 #define STRESS_PERF_DEFINED(x) _SNG_PERF_COUNT_ ## x
@@ -300,6 +296,23 @@ static inline void perf_type_tracepoint_resolve_config(perf_info_t *pi)
 	pi->config = config;
 }
 
+/* --sample-interval counters, labels are YAML and CSV names */
+static const perf_info_t perf_series_info[PERF_SERIES_MAX] = {
+	PERF_INFO_HW(HW_CPU_CYCLES,		"cpu-cycles"),
+	PERF_INFO_HW(HW_INSTRUCTIONS,		"instructions"),
+	PERF_INFO_HW_C(LL, READ, MISS,		"llc-misses"),
+	PERF_INFO_HW_C(DTLB, READ, MISS,	"dtlb-misses"),
+	PERF_INFO_SW(SW_CONTEXT_SWITCHES,	"context-switches"),
+	PERF_INFO_SW(SW_PAGE_FAULTS,		"page-faults"),
+};
+
+/* RAPL energy-pkg counters, one per package */
+#define PERF_ENERGY_MAX		(64)
+
+static int perf_energy_fds[PERF_ENERGY_MAX];
+static int perf_energy_n;
+static double perf_energy_scale;	/* joules per count */
+
 void perf_init(void)
 {
 	size_t i;
@@ -351,13 +364,78 @@ static char *perf_yaml_label(char *dst, const char *src, const size_t n)
 	return dst;
 }
 
+/*
+ *  perf_hw_event()
+ *	true for events counted by the PMU's hardware counters
+ */
+static inline bool perf_hw_event(const perf_info_t *pi)
+{
+	return (pi->type == PERF_TYPE_HARDWARE) ||
+	       (pi->type == PERF_TYPE_HW_CACHE);
+}
+
+/*
+ *  perf_open_event()
+ *	open event i, as a new group leader if leader is -1
+ *	or else as a member of the leader's group
+ */
+static int perf_open_event(stress_perf_t *sp, const size_t i, const int leader)
+{
+	struct perf_event_attr attr;
+	int fd;
+
+	(void)memset(&attr, 0, sizeof(attr));
+	attr.type = perf_info[i].type;
+	attr.config = perf_info[i].config;
+	/* Members follow the leader when it is enabled */
+	attr.disabled = (leader < 0);
+	attr.inherit = 1;
+	attr.read_format = PERF_FORMAT_GROUP |
+			   PERF_FORMAT_TOTAL_TIME_ENABLED |
+			   PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attr.size = sizeof(attr);
+	fd = sys_perf_event_open(&attr, 0, -1,
+		(leader < 0) ? -1 : sp->perf_stat[leader].fd, 0);
+	if (fd < 0)
+		return -1;
+
+	sp->perf_stat[i].fd = fd;
+	sp->perf_stat[i].leader = (leader < 0) ? (int)i : leader;
+	sp->perf_opened++;
+	return 0;
+}
+
+/*
+ *  perf_group_close()
+ *	close all the events of the group led by leader,
+ *	a closed group reads as invalid counters
+ */
+static void perf_group_close(stress_perf_t *sp, const int leader)
+{
+	size_t i;
+
+	for (i = (size_t)leader; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		if (sp->perf_stat[i].leader != leader)
+			continue;
+		if (sp->perf_stat[i].fd > -1)
+			(void)close(sp->perf_stat[i].fd);
+		sp->perf_stat[i].fd = -1;
+	}
+}
+
 /*
  *  perf_open()
- *	open perf, get leader and perf fd's
+ *	open perf events in groups that are counted together and
+ *	read with one read(). An event that the kernel will not
+ *	add to the current group, because the PMU has no counter
+ *	left for it, leads a new group, so hardware groups are
+ *	sized to the PMU's counters. Hardware and software events
+ *	are kept in separate groups
  */
 int perf_open(stress_perf_t *sp)
 {
 	size_t i;
+	int leader = -1;
 
 	if (!sp)
 		return -1;
@@ -369,26 +447,20 @@ int perf_open(stress_perf_t *sp)
 
 	for (i = 0; i < STRESS_PERF_MAX; i++) {
 		sp->perf_stat[i].fd = -1;
+		sp->perf_stat[i].leader = -1;
 		sp->perf_stat[i].counter = 0;
 	}
 
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
-		if (perf_info[i].config != UNRESOLVED) {
-			struct perf_event_attr attr;
-
-			(void)memset(&attr, 0, sizeof(attr));
-			attr.type = perf_info[i].type;
-			attr.config = perf_info[i].config;
-			attr.disabled = 1;
-			attr.inherit = 1;
-			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
-					   PERF_FORMAT_TOTAL_TIME_RUNNING;
-			attr.size = sizeof(attr);
-			sp->perf_stat[i].fd =
-				sys_perf_event_open(&attr, 0, -1, -1, 0);
-			if (sp->perf_stat[i].fd > -1)
-				sp->perf_opened++;
-		}
+		if (perf_info[i].config == UNRESOLVED)
+			continue;
+		if ((leader >= 0) &&
+		    (perf_hw_event(&perf_info[leader]) != perf_hw_event(&perf_info[i])))
+			leader = -1;
+		if ((leader >= 0) && (perf_open_event(sp, i, leader) == 0))
+			continue;
+		if (perf_open_event(sp, i, -1) == 0)
+			leader = (int)i;
 	}
 	if (!sp->perf_opened) {
 		pthread_spin_lock(&g_shared->perf.lock);
@@ -406,7 +478,7 @@ int perf_open(stress_perf_t *sp)
 
 /*
  *  perf_enable()
- *	enable perf counters
+ *	enable perf counters, a group at a time
  */
 int perf_enable(stress_perf_t *sp)
 {
@@ -420,26 +492,18 @@ int perf_enable(stress_perf_t *sp)
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
 		int fd = sp->perf_stat[i].fd;
 
-		if (fd > -1) {
-			if (ioctl(fd, PERF_EVENT_IOC_RESET,
-				  PERF_IOC_FLAG_GROUP) < 0) {
-				(void)close(fd);
-				sp->perf_stat[i].fd = -1;
-				continue;
-			}
-			if (ioctl(fd, PERF_EVENT_IOC_ENABLE,
-				  PERF_IOC_FLAG_GROUP) < 0) {
-				(void)close(fd);
-				sp->perf_stat[i].fd = -1;
-			}
-		}
+		if ((fd < 0) || (sp->perf_stat[i].leader != (int)i))
+			continue;
+		if ((ioctl(fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) < 0) ||
+		    (ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) < 0))
+			perf_group_close(sp, (int)i);
 	}
 	return 0;
 }
 
 /*
  *  perf_disable()
- *	disable perf counters
+ *	disable perf counters, a group at a time
  */
 int perf_disable(stress_perf_t *sp)
 {
@@ -453,66 +517,74 @@ int perf_disable(stress_perf_t *sp)
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
 		int fd = sp->perf_stat[i].fd;
 
-		if (fd > -1) {
-			if (ioctl(fd, PERF_EVENT_IOC_DISABLE,
-			          PERF_IOC_FLAG_GROUP) < 0) {
-				(void)close(fd);
-				sp->perf_stat[i].fd = -1;
-			}
-		}
+		if ((fd < 0) || (sp->perf_stat[i].leader != (int)i))
+			continue;
+		if (ioctl(fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP) < 0)
+			perf_group_close(sp, (int)i);
 	}
 	return 0;
 }
 
 /*
  *  perf_close()
- *	read counters and close
+ *	read the counters a group at a time, scaled up for the
+ *	time the PMU multiplexed the group out, and close
  */
 int perf_close(stress_perf_t *sp)
 {
-	size_t i = 0;
-	perf_data_t data;
-	ssize_t ret;
-	int rc = -1;
-	double scale;
+	size_t i;
 
 	if (!sp)
 		return -1;
-	if (!sp->perf_opened)
-		goto out_ok;
 
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
-		int fd = sp->perf_stat[i].fd;
-		if (fd < 0 ) {
-			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
+		/* nr, time enabled, time running, then a value per member */
+		uint64_t data[3 + STRESS_PERF_MAX];
+		const int leader = (int)i;
+		double scale = 0.0;
+		uint64_t nr = 0, n;
+		size_t k;
+		ssize_t ret;
+
+		if (sp->perf_stat[i].leader != leader) {
+			if (sp->perf_stat[i].leader < 0)
+				sp->perf_stat[i].counter = STRESS_PERF_INVALID;
 			continue;
 		}
 
-		(void)memset(&data, 0, sizeof(data));
-		ret = read(fd, &data, sizeof(data));
-		if (ret != sizeof(data))
-			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
-		else {
-			/* Ensure we don't get division by zero */
-			if (data.time_running == 0) {
-				scale = (data.time_enabled == 0) ? 1.0 : 0.0;
+		(void)memset(data, 0, sizeof(data));
+		ret = (sp->perf_stat[i].fd < 0) ? -1 :
+			read(sp->perf_stat[i].fd, data, sizeof(data));
+		if ((ret >= (ssize_t)(3 * sizeof(uint64_t))) &&
+		    (data[0] <= STRESS_PERF_MAX) &&
+		    (ret >= (ssize_t)((3 + data[0]) * sizeof(uint64_t))) &&
+		    (data[2] > 0)) {
+			nr = data[0];
+			scale = (double)data[1] / (double)data[2];
+		}
+
+		/* Members are read in the order they joined the group */
+		for (n = 0, k = i; k < STRESS_PERF_MAX && perf_info[k].label; k++) {
+			perf_stat_t *ps = &sp->perf_stat[k];
+
+			if (ps->leader != leader)
+				continue;
+			if (n < nr) {
+				ps->counter = (uint64_t)((double)data[3 + n] * scale);
+				ps->time_enabled = data[1];
+				ps->time_running = data[2];
 			} else {
-				scale = (double)data.time_enabled /
-					data.time_running;
+				/* Never scheduled on the PMU or unreadable */
+				ps->counter = STRESS_PERF_INVALID;
 			}
-			sp->perf_stat[i].counter = (uint64_t)
-				((double)data.counter * scale);
+			n++;
 		}
-		(void)close(fd);
-		sp->perf_stat[i].fd = -1;
+		perf_group_close(sp, leader);
 	}
-
-out_ok:
-	rc = 0;
 	for (; i < STRESS_PERF_MAX; i++)
 		sp->perf_stat[i].counter = STRESS_PERF_INVALID;
 
-	return rc;
+	return 0;
 }
 
 /*
@@ -554,6 +626,55 @@ static const char *perf_stat_scale(const uint64_t counter, const double duration
 	return buffer;
 }
 
+/*
+ *  perf_stat_total()
+ *	total of the event of type and config, 0 if
+ *	it was not counted
+ */
+static uint64_t perf_stat_total(
+	const uint64_t *totals,
+	const unsigned long type,
+	const unsigned long config)
+{
+	size_t p;
+
+	for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
+		if ((perf_info[p].type == type) && (perf_info[p].config == config))
+			return (totals[p] == STRESS_PERF_INVALID) ? 0 : totals[p];
+	}
+	return 0;
+}
+
+/*
+ *  perf_stat_derived()
+ *	dump a metric derived from the counters, skipping
+ *	it if the counters it needs were not counted
+ */
+static void perf_stat_derived(
+	FILE *yaml,
+	const char *munged,
+	const char *label,
+	const char *yaml_label,
+	const int better,
+	const bool percent,
+	const uint64_t numerator,
+	const uint64_t denominator,
+	const double scale)
+{
+	double value;
+
+	if (!numerator || !denominator)
+		return;
+
+	value = scale * (double)numerator / (double)denominator;
+	if (percent)
+		pr_inf("%25.2f%% %s\n", value, label);
+	else
+		pr_inf("%26.3f %s\n", value, label);
+	pr_yaml(yaml, "      %s: %f\n", yaml_label, value);
+	compare_add(munged, yaml_label, better, value);
+}
+
 void perf_stat_dump(FILE *yaml, proc_info_t *procs_head, const double duration)
 {
 	bool no_perf_stats = true;
@@ -565,42 +686,38 @@ void perf_stat_dump(FILE *yaml, proc_info_t *procs_head, const double duration)
 
 	for (pi = procs_head; pi; pi = pi->next) {
 		int p;
+		int32_t j;
 		uint64_t counter_totals[STRESS_PERF_MAX];
-		uint64_t total_cpu_cycles = 0;
-		uint64_t total_cache_refs = 0;
-		uint64_t total_branches = 0;
+		uint64_t time_enabled[STRESS_PERF_MAX];
+		uint64_t time_running[STRESS_PERF_MAX];
+		uint64_t cycles, instructions;
 		bool got_data = false;
 		char *munged;
 
 		(void)memset(counter_totals, 0, sizeof(counter_totals));
+		(void)memset(time_enabled, 0, sizeof(time_enabled));
+		(void)memset(time_running, 0, sizeof(time_running));
 
 		/* Sum totals across all instances of the stressor */
-		for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
-			int32_t j;
-			stress_perf_t *sp = &pi->stats[0]->sp;
+		for (j = 0; j < pi->started_procs; j++) {
+			const stress_perf_t *sp = &pi->stats[j]->sp;
 
 			if (!perf_stat_succeeded(sp))
 				continue;
 
-			for (j = 0; j < pi->started_procs; j++) {
-				const uint64_t counter = sp->perf_stat[p].counter;
+			for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
+				const perf_stat_t *ps = &sp->perf_stat[p];
 
-				if (counter == STRESS_PERF_INVALID) {
+				if (counter_totals[p] == STRESS_PERF_INVALID)
+					continue;
+				if (ps->counter == STRESS_PERF_INVALID) {
 					counter_totals[p] = STRESS_PERF_INVALID;
-					break;
+					continue;
 				}
-				counter_totals[p] += counter;
-				got_data |= (counter > 0);
-			}
-			if (perf_info[p].type == PERF_TYPE_HARDWARE) {
-				unsigned long config = perf_info[p].config;
-
-				if (config == PERF_COUNT_HW_CPU_CYCLES)
-					total_cpu_cycles = counter_totals[p];
-				else if (config == PERF_COUNT_HW_CACHE_REFERENCES)
-					total_cache_refs = counter_totals[p];
-				else if (config == PERF_COUNT_HW_BRANCH_INSTRUCTIONS)
-					total_branches = counter_totals[p];
+				counter_totals[p] += ps->counter;
+				time_enabled[p] += ps->time_enabled;
+				time_running[p] += ps->time_running;
+				got_data |= (ps->counter > 0);
 			}
 		}
 
@@ -619,40 +736,83 @@ void perf_stat_dump(FILE *yaml, proc_info_t *procs_head, const double duration)
 			if (l && (ct != STRESS_PERF_INVALID)) {
 				char extra[32];
 				char yaml_label[128];
+				char metric[160];
 				*extra = '\0';
 
 				no_perf_stats = false;
 
-				if (perf_info[p].type == PERF_TYPE_HARDWARE) {
-					unsigned long config = perf_info[p].config;
-					if ((config == PERF_COUNT_HW_INSTRUCTIONS) &&
-					    (total_cpu_cycles > 0))
-						(void)snprintf(extra, sizeof(extra),
-							" (%.3f instr. per cycle)",
-							(double)ct / (double)total_cpu_cycles);
-					else if ((config == PERF_COUNT_HW_CACHE_MISSES) &&
-					     (total_cache_refs > 0))
-						(void)snprintf(extra, sizeof(extra),
-							" (%5.2f%%)",
-							100.0 * (double)ct / (double)total_cache_refs);
-					else if ((config == PERF_COUNT_HW_BRANCH_MISSES) &&
-					    (total_branches > 0))
-						(void)snprintf(extra, sizeof(extra),
-							" (%5.2f%%)",
-							100.0 * (double)ct / (double)total_branches);
+				perf_yaml_label(yaml_label, l, sizeof(yaml_label));
+
+				/* Counted for only part of the run and scaled up */
+				if (time_running[p] < time_enabled[p]) {
+					const double counted = 100.0 *
+						(double)time_running[p] / (double)time_enabled[p];
+
+					(void)snprintf(extra, sizeof(extra),
+						" (scaled, %.1f%% counted)", counted);
+					pr_yaml(yaml, "      %s_counted_percent: %f\n",
+						yaml_label, counted);
 				}
 
 				pr_inf("%'26" PRIu64 " %-24s %s%s\n",
 					ct, l, perf_stat_scale(ct, duration),
 					extra);
 
-				perf_yaml_label(yaml_label, l, sizeof(yaml_label));
 				pr_yaml(yaml, "      %s_total: %" PRIu64
 					"\n", yaml_label, ct);
 				pr_yaml(yaml, "      %s_per_second: %f\n",
 					yaml_label, (double)ct / duration);
+				(void)snprintf(metric, sizeof(metric), "%s_per_second",
+					yaml_label);
+				compare_add(munged, metric, COMPARE_NEUTRAL,
+					(double)ct / duration);
 			}
 		}
+
+		/* Metrics derived from the hardware counters */
+		cycles = perf_stat_total(counter_totals, PERF_TYPE_HARDWARE,
+			PERF_COUNT_HW_CPU_CYCLES);
+		instructions = perf_stat_total(counter_totals, PERF_TYPE_HARDWARE,
+			PERF_COUNT_HW_INSTRUCTIONS);
+
+		perf_stat_derived(yaml, munged, "Instructions Per Cycle",
+			"instructions_per_cycle", COMPARE_HIGHER, false,
+			instructions, cycles, 1.0);
+		perf_stat_derived(yaml, munged, "Cache Miss Rate",
+			"cache_miss_percent", COMPARE_LOWER, true,
+			perf_stat_total(counter_totals, PERF_TYPE_HARDWARE,
+				PERF_COUNT_HW_CACHE_MISSES),
+			perf_stat_total(counter_totals, PERF_TYPE_HARDWARE,
+				PERF_COUNT_HW_CACHE_REFERENCES), 100.0);
+		perf_stat_derived(yaml, munged, "Branch Miss Rate",
+			"branch_miss_percent", COMPARE_LOWER, true,
+			perf_stat_total(counter_totals, PERF_TYPE_HARDWARE,
+				PERF_COUNT_HW_BRANCH_MISSES),
+			perf_stat_total(counter_totals, PERF_TYPE_HARDWARE,
+				PERF_COUNT_HW_BRANCH_INSTRUCTIONS), 100.0);
+#if STRESS_PERF_DEFINED(HW_CACHE_DTLB)
+		perf_stat_derived(yaml, munged, "DTLB Misses Per 1K Instr.",
+			"dtlb_misses_per_kilo_instruction", COMPARE_LOWER, false,
+			perf_stat_total(counter_totals, PERF_TYPE_HW_CACHE,
+				PERF_HW_CACHE_CONFIG(DTLB, READ, MISS)) +
+			perf_stat_total(counter_totals, PERF_TYPE_HW_CACHE,
+				PERF_HW_CACHE_CONFIG(DTLB, WRITE, MISS)),
+			instructions, 1000.0);
+#endif
+#if STRESS_PERF_DEFINED(HW_STALLED_CYCLES_FRONTEND)
+		perf_stat_derived(yaml, munged, "Frontend Stalled Cycles",
+			"stalled_cycles_frontend_percent", COMPARE_LOWER, true,
+			perf_stat_total(counter_totals, PERF_TYPE_HARDWARE,
+				PERF_COUNT_HW_STALLED_CYCLES_FRONTEND),
+			cycles, 100.0);
+#endif
+#if STRESS_PERF_DEFINED(HW_STALLED_CYCLES_BACKEND)
+		perf_stat_derived(yaml, munged, "Backend Stalled Cycles",
+			"stalled_cycles_backend_percent", COMPARE_LOWER, true,
+			perf_stat_total(counter_totals, PERF_TYPE_HARDWARE,
+				PERF_COUNT_HW_STALLED_CYCLES_BACKEND),
+			cycles, 100.0);
+#endif
 		pr_yaml(yaml, "\n");
 	}
 	if (no_perf_stats) {
@@ -680,4 +840,231 @@ void perf_stat_dump(FILE *yaml, proc_info_t *procs_head, const double duration)
 		}
 	}
 }
+
+/*
+ *  perf_energy_open_event()
+ *	open a system wide power/<event>/ RAPL counter on
+ *	the CPU perf reads each package through, returns
+ *	the number of counters opened
+ */
+static int perf_energy_open_event(const char *event)
+{
+	static const char *pmu = "/sys/bus/event_source/devices/power";
+	char path[PATH_MAX], buf[256], *ptr, *token, *saveptr = NULL;
+	unsigned long type, config;
+
+	perf_energy_n = 0;
+
+	(void)snprintf(path, sizeof(path), "%s/type", pmu);
+	if ((system_read(path, buf, sizeof(buf) - 1) <= 0) ||
+	    (sscanf(buf, "%lu", &type) != 1))
+		return 0;
+	(void)snprintf(path, sizeof(path), "%s/events/%s", pmu, event);
+	if ((system_read(path, buf, sizeof(buf) - 1) <= 0) ||
+	    (sscanf(buf, "event=%lx", &config) != 1))
+		return 0;
+	(void)snprintf(path, sizeof(path), "%s/events/%s.scale", pmu, event);
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return 0;
+	perf_energy_scale = strtod(buf, NULL);
+	if (perf_energy_scale <= 0.0)
+		return 0;
+	(void)snprintf(path, sizeof(path), "%s/cpumask", pmu);
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return 0;
+
+	for (ptr = buf; (token = strtok_r(ptr, ",\n", &saveptr)) != NULL; ptr = NULL) {
+		struct perf_event_attr attr;
+		int fd;
+
+		if (perf_energy_n >= PERF_ENERGY_MAX)
+			break;
+
+		(void)memset(&attr, 0, sizeof(attr));
+		attr.type = (uint32_t)type;
+		attr.config = config;
+		attr.size = sizeof(attr);
+		fd = sys_perf_event_open(&attr, -1, atoi(token), -1, 0);
+		if (fd > -1)
+			perf_energy_fds[perf_energy_n++] = fd;
+	}
+	return perf_energy_n;
+}
+
+/*
+ *  perf_energy_open()
+ *	open the power/energy-pkg/ counters, or the platform
+ *	power/energy-psys/ counter where packages are not
+ *	exposed, returns the number of counters opened
+ */
+int perf_energy_open(void)
+{
+	if (perf_energy_open_event("energy-pkg") > 0)
+		return perf_energy_n;
+	return perf_energy_open_event("energy-psys");
+}
+
+/*
+ *  perf_energy_read()
+ *	joules used by all packages since perf_energy_open(),
+ *	perf extends the counters to 64 bits so they do not wrap
+ */
+bool perf_energy_read(double *joules)
+{
+	uint64_t total = 0;
+	int i;
+
+	if (!perf_energy_n)
+		return false;
+
+	for (i = 0; i < perf_energy_n; i++) {
+		uint64_t count;
+
+		if (read(perf_energy_fds[i], &count, sizeof(count)) != sizeof(count))
+			return false;
+		total += count;
+	}
+	*joules = (double)total * perf_energy_scale;
+	return true;
+}
+
+/*
+ *  perf_energy_close()
+ *	close the RAPL counters
+ */
+void perf_energy_close(void)
+{
+	int i;
+
+	for (i = 0; i < perf_energy_n; i++)
+		(void)close(perf_energy_fds[i]);
+	perf_energy_n = 0;
+}
+
+/*
+ *  perf_series_label()
+ *	name of --sample-interval counter i
+ */
+const char *perf_series_label(const size_t i)
+{
+	return perf_series_info[i].label;
+}
+
+/*
+ *  perf_series_open()
+ *	start counting the --sample-interval counters of the
+ *	instance pid and the processes it forks, grouped like
+ *	perf_open() so a group is counted and read together.
+ *	A pid <= 0 leaves the counters closed
+ */
+void perf_series_open(perf_series_t *ps, const pid_t pid)
+{
+	int leader = -1;
+	size_t i;
+
+	(void)memset(ps, 0, sizeof(*ps));
+	for (i = 0; i < PERF_SERIES_MAX; i++) {
+		ps->perf_stat[i].fd = -1;
+		ps->perf_stat[i].leader = -1;
+	}
+	if (pid <= 0)
+		return;
+
+	for (i = 0; i < PERF_SERIES_MAX; i++) {
+		const perf_info_t *info = &perf_series_info[i];
+		struct perf_event_attr attr;
+		int fd = -1;
+
+		if ((leader >= 0) &&
+		    (perf_hw_event(&perf_series_info[leader]) != perf_hw_event(info)))
+			leader = -1;
+
+		(void)memset(&attr, 0, sizeof(attr));
+		attr.type = info->type;
+		attr.config = info->config;
+		attr.inherit = 1;
+		attr.read_format = PERF_FORMAT_GROUP |
+				   PERF_FORMAT_TOTAL_TIME_ENABLED |
+				   PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.size = sizeof(attr);
+		if (leader >= 0)
+			fd = sys_perf_event_open(&attr, pid, -1,
+				ps->perf_stat[leader].fd, 0);
+		if (fd < 0) {
+			fd = sys_perf_event_open(&attr, pid, -1, -1, 0);
+			if (fd < 0)
+				continue;
+			leader = (int)i;
+		}
+		ps->perf_stat[i].fd = fd;
+		ps->perf_stat[i].leader = leader;
+	}
+}
+
+/*
+ *  perf_series_read()
+ *	the count of each --sample-interval counter since the
+ *	last read, scaled up for the time the PMU multiplexed
+ *	its group out, or < 0 if it could not be counted
+ */
+void perf_series_read(perf_series_t *ps, double *counts)
+{
+	size_t i;
+
+	for (i = 0; i < PERF_SERIES_MAX; i++)
+		counts[i] = -1.0;
+
+	for (i = 0; i < PERF_SERIES_MAX; i++) {
+		/* nr, time enabled, time running, then a value per member */
+		uint64_t data[3 + PERF_SERIES_MAX];
+		perf_stat_t *leader = &ps->perf_stat[i];
+		uint64_t enabled, running, n;
+		size_t k;
+		ssize_t ret;
+
+		if ((leader->leader != (int)i) || (leader->fd < 0))
+			continue;
+		ret = read(leader->fd, data, sizeof(data));
+		if ((ret < (ssize_t)(3 * sizeof(uint64_t))) ||
+		    (data[0] > PERF_SERIES_MAX) ||
+		    (ret < (ssize_t)((3 + data[0]) * sizeof(uint64_t))))
+			continue;
+		enabled = data[1] - leader->time_enabled;
+		running = data[2] - leader->time_running;
+
+		/* Members are read in the order they joined the group */
+		for (n = 0, k = i; (k < PERF_SERIES_MAX) && (n < data[0]); k++) {
+			perf_stat_t *stat = &ps->perf_stat[k];
+
+			if (stat->leader != (int)i)
+				continue;
+			/* Not scheduled at all is no events, not unknown */
+			if (running)
+				counts[k] = (double)(data[3 + n] - stat->counter) *
+					(double)enabled / (double)running;
+			else if (!enabled)
+				counts[k] = 0.0;
+			stat->counter = data[3 + n];
+			n++;
+		}
+		leader->time_enabled = data[1];
+		leader->time_running = data[2];
+	}
+}
+
+/*
+ *  perf_series_close()
+ *	stop counting the --sample-interval counters
+ */
+void perf_series_close(perf_series_t *ps)
+{
+	size_t i;
+
+	for (i = 0; i < PERF_SERIES_MAX; i++) {
+		if (ps->perf_stat[i].fd > -1)
+			(void)close(ps->perf_stat[i].fd);
+		ps->perf_stat[i].fd = -1;
+		ps->perf_stat[i].leader = -1;
+	}
+}
 #endif
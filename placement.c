@@ -0,0 +1,478 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+
+enum {
+	PLACEMENT_NONE = 0,
+	PLACEMENT_SPREAD,
+	PLACEMENT_COMPACT,
+	PLACEMENT_SMT_PAIRS,
+	PLACEMENT_PER_LLC,
+	PLACEMENT_PER_NODE,
+};
+
+typedef struct {
+	const char *name;	/* policy name */
+	const int policy;	/* PLACEMENT_* */
+} placement_policy_t;
+
+static const placement_policy_t placement_policies[] = {
+	{ "spread",	PLACEMENT_SPREAD },
+	{ "compact",	PLACEMENT_COMPACT },
+	{ "smt-pairs",	PLACEMENT_SMT_PAIRS },
+	{ "per-llc",	PLACEMENT_PER_LLC },
+	{ "per-node",	PLACEMENT_PER_NODE },
+	{ NULL,		PLACEMENT_NONE }
+};
+
+/*
+ *  stress_set_placement()
+ *	set the instance placement policy
+ */
+int stress_set_placement(const char *name)
+{
+	const placement_policy_t *info;
+
+	for (info = placement_policies; info->name; info++) {
+		if (!strcmp(info->name, name)) {
+			set_setting("placement", TYPE_ID_INT, &info->policy);
+			return 0;
+		}
+	}
+
+	(void)fprintf(stderr, "placement must be one of:");
+	for (info = placement_policies; info->name; info++)
+		(void)fprintf(stderr, " %s", info->name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+#if defined(__linux__) && defined(HAVE_AFFINITY)
+
+#define PLACEMENT_SYS_CPU	"/sys/devices/system/cpu"
+#define PLACEMENT_SYS_NODE	"/sys/devices/system/node"
+
+typedef struct {
+	int32_t cpu;		/* logical CPU number */
+	int32_t core;		/* lowest CPU of its SMT siblings */
+	int32_t smt;		/* index among its SMT siblings */
+	int32_t llc;		/* lowest CPU sharing its last level cache */
+	int32_t node;		/* NUMA node */
+	int32_t core_rank;	/* index of its core within its LLC */
+	int32_t llc_rank;	/* index of its LLC within its node */
+} placement_cpu_t;
+
+static int placement_policy = PLACEMENT_NONE;
+static placement_cpu_t *placement_cpus;	/* usable CPUs in policy order */
+static int32_t placement_n;		/* number of usable CPUs */
+static int32_t *placement_domains;	/* LLCs or nodes in policy order */
+static int32_t placement_domains_n;	/* number of domains */
+
+/*
+ *  placement_cpulist()
+ *	parse a sysfs CPU list such as "0-3,8-11" into set
+ */
+static int placement_cpulist(const char *path, cpu_set_t *set)
+{
+	char buf[4096], *str, *token, *saveptr = NULL;
+
+	CPU_ZERO(set);
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return -1;
+
+	for (str = buf; (token = strtok_r(str, ",\n", &saveptr)) != NULL; str = NULL) {
+		int lo, hi, i;
+
+		if (sscanf(token, "%d-%d", &lo, &hi) != 2) {
+			if (sscanf(token, "%d", &lo) != 1)
+				continue;
+			hi = lo;
+		}
+		for (i = lo; (i <= hi) && (i < CPU_SETSIZE); i++)
+			CPU_SET(i, set);
+	}
+	return 0;
+}
+
+/*
+ *  placement_first()
+ *	lowest CPU in set, or dflt if it is empty
+ */
+static int32_t placement_first(const cpu_set_t *set, const int32_t dflt)
+{
+	int32_t i;
+
+	for (i = 0; i < CPU_SETSIZE; i++)
+		if (CPU_ISSET(i, set))
+			return i;
+	return dflt;
+}
+
+/*
+ *  placement_llc()
+ *	lowest CPU sharing cpu's highest level cache
+ */
+static int32_t placement_llc(const int32_t cpu)
+{
+	char path[PATH_MAX], buf[16];
+	int32_t index, level = -1, llc = cpu;
+
+	for (index = 0; ; index++) {
+		cpu_set_t set;
+		int32_t l;
+
+		(void)snprintf(path, sizeof(path), PLACEMENT_SYS_CPU
+			"/cpu%" PRId32 "/cache/index%" PRId32 "/level", cpu, index);
+		if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+			break;
+		l = atoi(buf);
+		if (l <= level)
+			continue;
+		(void)snprintf(path, sizeof(path), PLACEMENT_SYS_CPU
+			"/cpu%" PRId32 "/cache/index%" PRId32 "/shared_cpu_list", cpu, index);
+		if (placement_cpulist(path, &set) < 0)
+			continue;
+		level = l;
+		llc = placement_first(&set, cpu);
+	}
+	return llc;
+}
+
+/*
+ *  placement_rank()
+ *	number of distinct values of key below that of
+ *	cpu i among the CPUs in the same group
+ */
+static int32_t placement_rank(
+	const int32_t i,
+	const size_t key,
+	const size_t group)
+{
+	const placement_cpu_t *c = placement_cpus;
+	const int32_t *ki = (const int32_t *)((const char *)&c[i] + key);
+	const int32_t *gi = (const int32_t *)((const char *)&c[i] + group);
+	int32_t j, rank = 0;
+
+	for (j = 0; j < placement_n; j++) {
+		const int32_t *kj = (const int32_t *)((const char *)&c[j] + key);
+		const int32_t *gj = (const int32_t *)((const char *)&c[j] + group);
+		int32_t k;
+
+		if ((*gj != *gi) || (*kj >= *ki))
+			continue;
+		/* Only count the first CPU with each key value */
+		for (k = 0; k < j; k++)
+			if (*(const int32_t *)((const char *)&c[k] + key) == *kj)
+				break;
+		if (k == j)
+			rank++;
+	}
+	return rank;
+}
+
+#define PLACEMENT_CMP(a, b, field)			\
+	do {						\
+		if ((a)->field != (b)->field)		\
+			return ((a)->field < (b)->field) ? -1 : 1; \
+	} while (0)
+
+/*
+ *  placement_cmp()
+ *	order CPUs in the order instances are placed on them
+ */
+static int placement_cmp(const void *p1, const void *p2)
+{
+	const placement_cpu_t *a = (const placement_cpu_t *)p1;
+	const placement_cpu_t *b = (const placement_cpu_t *)p2;
+
+	switch (placement_policy) {
+	case PLACEMENT_SPREAD:
+		/* One thread per core, round robin over nodes and LLCs */
+		PLACEMENT_CMP(a, b, smt);
+		PLACEMENT_CMP(a, b, core_rank);
+		PLACEMENT_CMP(a, b, llc_rank);
+		PLACEMENT_CMP(a, b, node);
+		break;
+	case PLACEMENT_SMT_PAIRS:
+		/* Both threads of a core, cores spread as above */
+		PLACEMENT_CMP(a, b, core_rank);
+		PLACEMENT_CMP(a, b, llc_rank);
+		PLACEMENT_CMP(a, b, node);
+		PLACEMENT_CMP(a, b, core);
+		PLACEMENT_CMP(a, b, smt);
+		break;
+	case PLACEMENT_PER_LLC:
+		/* LLCs round robin over nodes */
+		PLACEMENT_CMP(a, b, llc_rank);
+		PLACEMENT_CMP(a, b, node);
+		PLACEMENT_CMP(a, b, llc);
+		break;
+	default:
+		/* Fill SMT siblings, cores, LLCs then nodes in turn */
+		PLACEMENT_CMP(a, b, node);
+		PLACEMENT_CMP(a, b, llc);
+		PLACEMENT_CMP(a, b, core);
+		PLACEMENT_CMP(a, b, smt);
+		break;
+	}
+	PLACEMENT_CMP(a, b, cpu);
+	return 0;
+}
+
+#undef PLACEMENT_CMP
+
+/*
+ *  placement_nodes()
+ *	NUMA node of each CPU, 0 if there is no NUMA information
+ */
+static void placement_nodes(void)
+{
+	DIR *dir;
+	struct dirent *entry;
+
+	dir = opendir(PLACEMENT_SYS_NODE);
+	if (!dir)
+		return;
+
+	while ((entry = readdir(dir)) != NULL) {
+		char path[PATH_MAX];
+		cpu_set_t set;
+		int32_t node, i;
+
+		if (strncmp(entry->d_name, "node", 4) ||
+		    (sscanf(entry->d_name + 4, "%" SCNd32, &node) != 1))
+			continue;
+		(void)snprintf(path, sizeof(path), PLACEMENT_SYS_NODE
+			"/%s/cpulist", entry->d_name);
+		if (placement_cpulist(path, &set) < 0)
+			continue;
+		for (i = 0; i < placement_n; i++)
+			if (CPU_ISSET(placement_cpus[i].cpu, &set))
+				placement_cpus[i].node = node;
+	}
+	(void)closedir(dir);
+}
+
+/*
+ *  placement_init()
+ *	build the topology of the CPUs this process may run
+ *	on, honouring --taskset, and order it for the policy
+ */
+void placement_init(void)
+{
+	cpu_set_t allowed;
+	int32_t i, j;
+
+	if (!get_setting("placement", &placement_policy) ||
+	    (placement_policy == PLACEMENT_NONE))
+		return;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_err("placement: cannot get CPU affinity, errno=%d (%s)\n",
+			errno, strerror(errno));
+		placement_policy = PLACEMENT_NONE;
+		return;
+	}
+	placement_cpus = calloc((size_t)CPU_COUNT(&allowed), sizeof(*placement_cpus));
+	placement_domains = calloc((size_t)CPU_COUNT(&allowed), sizeof(*placement_domains));
+	if (!placement_cpus || !placement_domains) {
+		pr_err("placement: cannot allocate CPU topology\n");
+		placement_free();
+		return;
+	}
+
+	for (placement_n = 0, i = 0; i < CPU_SETSIZE; i++) {
+		placement_cpu_t *c = &placement_cpus[placement_n];
+		char path[PATH_MAX];
+		cpu_set_t siblings;
+
+		if (!CPU_ISSET(i, &allowed))
+			continue;
+		c->cpu = i;
+		c->core = i;
+		(void)snprintf(path, sizeof(path), PLACEMENT_SYS_CPU
+			"/cpu%" PRId32 "/topology/thread_siblings_list", i);
+		if (placement_cpulist(path, &siblings) == 0) {
+			c->core = placement_first(&siblings, i);
+			for (j = 0; j < i; j++)
+				c->smt += !!CPU_ISSET(j, &siblings);
+		}
+		c->llc = placement_llc(i);
+		placement_n++;
+	}
+	placement_nodes();
+
+	for (i = 0; i < placement_n; i++) {
+		placement_cpus[i].core_rank = placement_rank(i,
+			offsetof(placement_cpu_t, core),
+			offsetof(placement_cpu_t, llc));
+		placement_cpus[i].llc_rank = placement_rank(i,
+			offsetof(placement_cpu_t, llc),
+			offsetof(placement_cpu_t, node));
+	}
+	qsort(placement_cpus, (size_t)placement_n, sizeof(*placement_cpus),
+		placement_cmp);
+
+	/* Distinct LLCs or nodes, in policy order */
+	for (i = 0; i < placement_n; i++) {
+		const int32_t domain = (placement_policy == PLACEMENT_PER_NODE) ?
+			placement_cpus[i].node : placement_cpus[i].llc;
+
+		for (j = 0; j < placement_domains_n; j++)
+			if (placement_domains[j] == domain)
+				break;
+		if (j == placement_domains_n)
+			placement_domains[placement_domains_n++] = domain;
+	}
+
+	pr_dbg("placement: %" PRId32 " CPUs, %" PRId32 " %s\n", placement_n,
+		placement_domains_n,
+		(placement_policy == PLACEMENT_PER_NODE) ? "nodes" : "LLCs");
+}
+
+/*
+ *  placement_set()
+ *	pin the calling process or thread, running the given
+ *	instance of a stressor, as the policy says and write
+ *	the CPUs it was pinned to into cpus
+ */
+void placement_set(const uint32_t instance, char *cpus, const size_t len)
+{
+	cpu_set_t set;
+	int32_t i, lo = -1, hi = -1;
+	size_t n = 0;
+
+	if (!placement_n)
+		return;
+
+	CPU_ZERO(&set);
+	if ((placement_policy == PLACEMENT_PER_LLC) ||
+	    (placement_policy == PLACEMENT_PER_NODE)) {
+		const int32_t domain = placement_domains[instance % placement_domains_n];
+
+		for (i = 0; i < placement_n; i++) {
+			const int32_t d = (placement_policy == PLACEMENT_PER_NODE) ?
+				placement_cpus[i].node : placement_cpus[i].llc;
+
+			if (d == domain)
+				CPU_SET(placement_cpus[i].cpu, &set);
+		}
+	} else {
+		CPU_SET(placement_cpus[instance % placement_n].cpu, &set);
+	}
+
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		pr_dbg("placement: cannot set CPU affinity, errno=%d (%s)\n",
+			errno, strerror(errno));
+		return;
+	}
+
+	/* Format as a CPU list, ranges collapsed */
+	*cpus = '\0';
+	for (i = 0; i <= CPU_SETSIZE; i++) {
+		if ((i < CPU_SETSIZE) && CPU_ISSET(i, &set)) {
+			if (lo < 0)
+				lo = i;
+			hi = i;
+			continue;
+		}
+		if (lo < 0)
+			continue;
+		if (n < len)
+			n += (size_t)snprintf(cpus + n, len - n, (lo == hi) ?
+				"%s%" PRId32 : "%s%" PRId32 "-%" PRId32,
+				n ? "," : "", lo, hi);
+		lo = -1;
+	}
+}
+
+/*
+ *  placement_dump()
+ *	dump the CPUs each instance was pinned to
+ */
+void placement_dump(FILE *yaml, proc_info_t *procs_head)
+{
+	const placement_policy_t *info;
+	const char *policy = "none";
+	proc_info_t *pi;
+
+	if (!placement_n)
+		return;
+	for (info = placement_policies; info->name; info++)
+		if (info->policy == placement_policy)
+			policy = info->name;
+
+	pr_yaml(yaml, "placement:\n");
+	for (pi = procs_head; pi; pi = pi->next) {
+		int32_t j;
+
+		if (!pi->started_procs)
+			continue;
+		pr_yaml(yaml, "    - stressor: %s\n", munge_underscore(pi->stressor->name));
+		pr_yaml(yaml, "      policy: %s\n", policy);
+		pr_yaml(yaml, "      instance-cpus:\n");
+		for (j = 0; j < pi->started_procs; j++)
+			pr_yaml(yaml, "        - \"%s\"\n", pi->stats[j]->placement);
+	}
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  placement_free()
+ *	free the topology
+ */
+void placement_free(void)
+{
+	free(placement_cpus);
+	free(placement_domains);
+	placement_cpus = NULL;
+	placement_domains = NULL;
+	placement_n = 0;
+	placement_domains_n = 0;
+}
+
+#else
+
+void placement_init(void)
+{
+	int policy = PLACEMENT_NONE;
+
+	if (get_setting("placement", &policy) && (policy != PLACEMENT_NONE))
+		pr_inf("placement: CPU affinity is not supported, ignoring --placement\n");
+}
+
+void placement_set(const uint32_t instance, char *cpus, const size_t len)
+{
+	(void)instance;
+	(void)cpus;
+	(void)len;
+}
+
+void placement_dump(FILE *yaml, proc_info_t *procs_head)
+{
+	(void)yaml;
+	(void)procs_head;
+}
+
+void placement_free(void)
+{
+}
+
+#endif
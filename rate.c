@@ -0,0 +1,207 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+#include <math.h>
+
+/* Step and sine period without a --timeout */
+#define RATE_DEFAULT_PERIOD	(60.0)
+
+/* Number of rate steps of the step profile */
+#define RATE_STEPS		(4)
+
+enum {
+	RATE_CONSTANT = 0,
+	RATE_POISSON,
+	RATE_STEP,
+	RATE_SINE,
+};
+
+typedef struct {
+	const char *name;	/* profile name */
+	const int profile;	/* RATE_* */
+} rate_profile_t;
+
+static const rate_profile_t rate_profiles[] = {
+	{ "constant",	RATE_CONSTANT },
+	{ "poisson",	RATE_POISSON },
+	{ "step",	RATE_STEP },
+	{ "sine",	RATE_SINE },
+	{ NULL,		0 }
+};
+
+static uint64_t rate_target;		/* --rate bogo ops/s per stressor */
+static int rate_profile = RATE_CONSTANT;	/* --rate-profile */
+
+/*
+ *  stress_set_rate()
+ *	set the open loop bogo op rate of each stressor
+ */
+void stress_set_rate(const char *opt)
+{
+	rate_target = get_uint64(opt);
+	check_range("rate", rate_target, MIN_RATE, MAX_RATE);
+}
+
+/*
+ *  stress_set_rate_profile()
+ *	set how the bogo op rate varies over time
+ */
+int stress_set_rate_profile(const char *name)
+{
+	const rate_profile_t *info;
+
+	for (info = rate_profiles; info->name; info++) {
+		if (!strcmp(info->name, name)) {
+			rate_profile = info->profile;
+			return 0;
+		}
+	}
+
+	(void)fprintf(stderr, "rate-profile must be one of:");
+	for (info = rate_profiles; info->name; info++)
+		(void)fprintf(stderr, " %s", info->name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  rate_now()
+ *	monotonic time in ns
+ */
+static uint64_t rate_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return 0;
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ *  rate_interval()
+ *	ns between the bogo op due at t secs into the run
+ *	and the next one, for an instance's share of --rate
+ */
+static double rate_interval(const args_t *args, const double t)
+{
+	const double period = g_opt_timeout ?
+		(double)g_opt_timeout : RATE_DEFAULT_PERIOD;
+	double rate = (double)rate_target / (double)args->num_instances;
+	double u;
+	int step;
+
+	switch (rate_profile) {
+	case RATE_POISSON:
+		/* Exponential inter-arrival times, u in (0, 1] */
+		u = ((double)mwc32() + 1.0) / 4294967296.0;
+		return -log(u) * 1E9 / rate;
+	case RATE_STEP:
+		/* 1/4, 2/4, 3/4 then all of the rate */
+		step = (int)(t * RATE_STEPS / period) + 1;
+		if (step > RATE_STEPS)
+			step = RATE_STEPS;
+		rate = rate * (double)step / RATE_STEPS;
+		break;
+	case RATE_SINE:
+		/* Between 1/2 and 3/2 of the rate, once per run */
+		rate = rate * (1.0 + (0.5 * sin(2.0 * M_PI * t / period)));
+		break;
+	default:
+		break;
+	}
+	return 1E9 / rate;
+}
+
+/*
+ *  stress_rate_wait()
+ *	--rate, wait until the next bogo op of the instance is
+ *	due and return when it was due in ns. An instance that
+ *	is behind schedule issues its bogo ops straight away
+ *	and the time it is behind counts as latency; a bogo op
+ *	issued after the following one was already due is a
+ *	missed deadline
+ */
+uint64_t stress_rate_wait(const args_t *args)
+{
+	stress_rate_t *const rate = args->rate;
+	const uint64_t now = rate_now();
+	uint64_t due;
+
+	if (!rate->start)
+		rate->start = rate->next = now;
+
+	due = rate->next;
+	rate->next = due + (uint64_t)rate_interval(args,
+		(double)(due - rate->start) / 1E9);
+	rate->issued++;
+
+	if (now < due) {
+		struct timespec ts;
+		uint64_t woken;
+
+		ts.tv_sec = (time_t)(due / 1000000000ULL);
+		ts.tv_nsec = (long)(due % 1000000000ULL);
+		while ((clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					&ts, NULL) == EINTR) &&
+		       g_keep_stressing_flag)
+			;
+		/* Cut short by the end of the run */
+		woken = rate_now();
+		if (woken < due)
+			return woken;
+	} else if (now >= rate->next) {
+		rate->missed++;
+	}
+	return due;
+}
+
+/*
+ *  rate_metrics_dump()
+ *	output how well the instances of a
+ *	stressor kept to the --rate schedule
+ */
+void rate_metrics_dump(FILE *yaml, const proc_info_t *pi)
+{
+	const rate_profile_t *info;
+	const char *profile = "constant";
+	uint64_t issued = 0, missed = 0;
+	int32_t j;
+
+	for (j = 0; j < pi->started_procs; j++) {
+		issued += pi->stats[j]->rate.issued;
+		missed += pi->stats[j]->rate.missed;
+	}
+	if (!issued)
+		return;
+
+	for (info = rate_profiles; info->name; info++)
+		if (info->profile == rate_profile)
+			profile = info->name;
+
+	pr_inf("  %-15s %" PRIu64 " ops/s %s, %" PRIu64 " ops issued, "
+		"%" PRIu64 " missed deadlines (%.2f%%)\n", "rate",
+		rate_target, profile, issued, missed,
+		100.0 * (double)missed / (double)issued);
+
+	pr_yaml(yaml, "      rate-target: %" PRIu64 "\n", rate_target);
+	pr_yaml(yaml, "      rate-profile: %s\n", profile);
+	pr_yaml(yaml, "      rate-ops-issued: %" PRIu64 "\n", issued);
+	pr_yaml(yaml, "      rate-missed-deadlines: %" PRIu64 "\n", missed);
+}
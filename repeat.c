@@ -0,0 +1,285 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+#include <math.h>
+
+/* Longest sleep between checks for the end of a run */
+#define REPEAT_POLL_USEC	(100000)
+
+static uint32_t repeat_runs;		/* --repeat, 0 if not given */
+static double repeat_until_ci;		/* --until-ci percent, 0 if not given */
+static uint64_t repeat_warmup;		/* --warmup seconds */
+
+#if defined(HAVE_LIB_PTHREAD)
+static pthread_t repeat_thread;
+static proc_info_t *repeat_procs;	/* stressors being warmed up */
+static volatile bool repeat_run;	/* false at the end of a run */
+static bool repeat_running;		/* warm-up thread created */
+#endif
+
+/*
+ *  stress_set_repeat()
+ *	set the number of times to run the stressors
+ */
+void stress_set_repeat(const char *opt)
+{
+	repeat_runs = get_uint32(opt);
+	check_range("repeat", repeat_runs, MIN_REPEAT, MAX_REPEAT);
+}
+
+/*
+ *  stress_set_until_ci()
+ *	set the 95% confidence interval, in percent of the
+ *	mean ops/s, at which to stop repeating runs
+ */
+void stress_set_until_ci(const char *opt)
+{
+	char *end;
+
+	repeat_until_ci = strtod(opt, &end);
+	if ((end == opt) || *end || (repeat_until_ci <= 0.0) ||
+	    (repeat_until_ci > 100.0)) {
+		(void)fprintf(stderr, "until-ci must be a percentage "
+			"greater than 0 and at most 100\n");
+		longjmp(g_error_env, 1);
+	}
+}
+
+/*
+ *  stress_set_warmup()
+ *	set the time at the start of each run that is
+ *	left out of the repeated run statistics
+ */
+void stress_set_warmup(const char *opt)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	repeat_warmup = get_uint64_time(opt);
+	check_range("warmup", repeat_warmup, MIN_WARMUP, MAX_WARMUP);
+#else
+	(void)opt;
+
+	(void)fprintf(stderr, "warmup is not supported without pthreads\n");
+	longjmp(g_error_env, 1);
+#endif
+}
+
+/*
+ *  repeat_init()
+ *	get the number of runs to do with --repeat, --until-ci
+ *	or --warmup, 0 if none of them were given, returns -1
+ *	if the warm-up is not shorter than the runs
+ */
+int repeat_init(uint32_t *runs)
+{
+	*runs = 0;
+	if (repeat_warmup && g_opt_timeout &&
+	    (repeat_warmup >= g_opt_timeout)) {
+		pr_err("warmup of %" PRIu64 " seconds leaves nothing of "
+			"the %" PRIu64 " second runs\n",
+			repeat_warmup, g_opt_timeout);
+		return -1;
+	}
+	if (repeat_runs)
+		*runs = repeat_runs;
+	else if (repeat_until_ci > 0.0)
+		*runs = DEFAULT_UNTIL_CI_REPEAT;
+	else if (repeat_warmup)
+		*runs = 1;
+	return 0;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  repeat_thread_func()
+ *	at the end of the warm-up, note each
+ *	instance's bogo op counter and the time
+ */
+static void *repeat_thread_func(void *arg)
+{
+	const double t_end = time_now() + (double)repeat_warmup;
+	proc_info_t *pi;
+
+	(void)arg;
+
+	while (repeat_run && (time_now() < t_end))
+		(void)shim_usleep(REPEAT_POLL_USEC);
+	if (!repeat_run)
+		return NULL;
+
+	for (pi = repeat_procs; pi; pi = pi->next) {
+		int32_t j;
+
+		for (j = 0; j < pi->started_procs; j++) {
+			proc_stats_t *const stats = pi->stats[j];
+
+			stats->warmup_counter =
+				__atomic_load_n(&stats->counter, __ATOMIC_RELAXED);
+			stats->warmup_time = time_now();
+		}
+	}
+	return NULL;
+}
+#endif
+
+/*
+ *  repeat_warmup_start()
+ *	start timing the warm-up of a run
+ */
+void repeat_warmup_start(proc_info_t *procs_list)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	int ret;
+
+	if (!repeat_warmup)
+		return;
+
+	repeat_procs = procs_list;
+	repeat_run = true;
+	ret = pthread_create(&repeat_thread, NULL, repeat_thread_func, NULL);
+	repeat_running = (ret == 0);
+	if (!repeat_running)
+		pr_err("Cannot create warm-up thread, errno=%d (%s)\n",
+			ret, strerror(ret));
+#else
+	(void)procs_list;
+#endif
+}
+
+/*
+ *  repeat_warmup_stop()
+ *	stop timing the warm-up at the end of a run
+ */
+void repeat_warmup_stop(void)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	if (repeat_running) {
+		repeat_run = false;
+		(void)pthread_join(repeat_thread, NULL);
+		repeat_running = false;
+	}
+	repeat_procs = NULL;
+#endif
+}
+
+/*
+ *  repeat_stats()
+ *	mean of a stressor's ops/s over its runs, the half
+ *	width of its 95% confidence interval and the
+ *	coefficient of variation, returns the number of runs
+ */
+size_t repeat_stats(
+	const proc_info_t *pi,
+	double *mean,
+	double *ci,
+	double *cv)
+{
+	double sum = 0.0, sum_sq = 0.0, sd;
+	size_t i;
+
+	*mean = *ci = *cv = 0.0;
+	if (!pi->repeat_n)
+		return 0;
+
+	for (i = 0; i < pi->repeat_n; i++)
+		sum += pi->repeat_rates[i];
+	*mean = sum / (double)pi->repeat_n;
+	if (pi->repeat_n < 2)
+		return pi->repeat_n;
+
+	for (i = 0; i < pi->repeat_n; i++)
+		sum_sq += (pi->repeat_rates[i] - *mean) *
+			  (pi->repeat_rates[i] - *mean);
+	sd = sqrt(sum_sq / (double)(pi->repeat_n - 1));
+	*ci = compare_t_crit(0.05, (double)(pi->repeat_n - 1)) *
+		sd / sqrt((double)pi->repeat_n);
+	*cv = (*mean > 0.0) ? sd / *mean : 0.0;
+
+	return pi->repeat_n;
+}
+
+/*
+ *  repeat_add()
+ *	record the ops/s of each stressor's run after its
+ *	warm-up, returns true once every stressor's 95%
+ *	confidence interval is within --until-ci of its mean
+ */
+bool repeat_add(proc_info_t *procs_list, const uint32_t max_runs)
+{
+	proc_info_t *pi;
+	bool stable = (repeat_until_ci > 0.0);
+
+	for (pi = procs_list; pi; pi = pi->next) {
+		uint64_t c_total = 0;
+		double r_total = 0.0, mean, ci, cv;
+		int32_t j, n = 0;
+
+		if (!pi->started_procs)
+			continue;
+
+		if (!pi->repeat_rates) {
+			pi->repeat_rates = calloc(max_runs, sizeof(*pi->repeat_rates));
+			if (!pi->repeat_rates)
+				continue;
+		}
+		if (pi->repeat_n >= max_runs)
+			continue;
+
+		/* Instances that ended during the warm-up do not count */
+		for (j = 0; j < pi->started_procs; j++) {
+			const proc_stats_t *const stats = pi->stats[j];
+			const double start = repeat_warmup ?
+				stats->warmup_time : stats->start;
+
+			if ((start <= 0.0) || (stats->finish <= start))
+				continue;
+			c_total += stats->counter - (repeat_warmup ?
+				stats->warmup_counter : 0);
+			r_total += stats->finish - start;
+			n++;
+		}
+		r_total = n ? r_total / (double)n : 0.0;
+		pi->repeat_rates[pi->repeat_n++] =
+			(r_total > 0.0) ? (double)c_total / r_total : 0.0;
+
+		(void)repeat_stats(pi, &mean, &ci, &cv);
+		pr_dbg("%s: run %zu, %.2f bogo ops/s, mean %.2f +/- %.2f\n",
+			munge_underscore(pi->stressor->name), pi->repeat_n,
+			pi->repeat_rates[pi->repeat_n - 1], mean, ci);
+		/* Two runs can agree by chance, trust three or more */
+		if ((pi->repeat_n < 3) ||
+		    (ci > mean * repeat_until_ci / 100.0))
+			stable = false;
+	}
+	return stable;
+}
+
+/*
+ *  repeat_free()
+ *	free the per run ops/s
+ */
+void repeat_free(proc_info_t *procs_head)
+{
+	proc_info_t *pi;
+
+	for (pi = procs_head; pi; pi = pi->next) {
+		free(pi->repeat_rates);
+		pi->repeat_rates = NULL;
+		pi->repeat_n = 0;
+	}
+}
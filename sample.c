@@ -0,0 +1,531 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+
+#if defined(HAVE_LIB_PTHREAD)
+
+/* Longest sleep between checks for a stop request */
+#define SAMPLE_POLL_USEC	(100000)
+
+static pthread_t sample_thread;
+static proc_info_t *sample_procs;	/* stressors being sampled */
+static volatile bool sample_run;	/* false to stop the sampler */
+static bool sample_running;		/* sampler thread created */
+static double sample_interval;		/* seconds between samples */
+static double sample_base = -1.0;	/* time of the first run */
+static FILE *sample_csv;		/* CSV time series, may be NULL */
+static bool sample_energy;		/* sampling --energy power */
+static double sample_joules;		/* energy at the last sample */
+static bool sample_perf;		/* sampling --perf counters */
+
+/*
+ *  stress_set_sample_interval()
+ *	set the time between throughput samples
+ */
+void stress_set_sample_interval(const char *opt)
+{
+	uint64_t interval;
+
+	interval = get_uint64_time(opt);
+	check_range("sample-interval", interval,
+		MIN_SAMPLE_INTERVAL, MAX_SAMPLE_INTERVAL);
+	set_setting("sample-interval", TYPE_ID_UINT64, &interval);
+}
+
+/*
+ *  sample_counter()
+ *	read a bogo op counter the child is updating. On 32 bit
+ *	systems the child's two word store can be seen half done,
+ *	so re-read until two reads are consistent with a counter
+ *	that only ever goes up, falling back to the last sample
+ */
+static uint64_t sample_counter(const uint64_t *counter, const uint64_t last)
+{
+#if UINTPTR_MAX == 0xffffffff
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		const uint64_t v1 = __atomic_load_n(counter, __ATOMIC_RELAXED);
+		const uint64_t v2 = __atomic_load_n(counter, __ATOMIC_RELAXED);
+
+		if ((v1 >= last) && (v2 >= v1) && (v2 - v1 < 0x80000000ULL))
+			return v1;
+	}
+	return last;
+#else
+	const uint64_t v = __atomic_load_n(counter, __ATOMIC_RELAXED);
+
+	return v >= last ? v : last;
+#endif
+}
+
+/*
+ *  sample_name()
+ *	munge_underscore() into a caller buffer, the
+ *	main thread may be using munge_underscore()'s
+ */
+static void sample_name(const proc_info_t *pi, char *name, const size_t len)
+{
+	const char *src;
+	size_t i;
+
+	for (src = pi->stressor->name, i = 0; *src && (i < len - 1); src++, i++)
+		name[i] = (*src == '_') ? '-' : *src;
+	name[i] = '\0';
+}
+
+/*
+ *  sample_perf_csv()
+ *	format --perf counts as counts per second CSV
+ *	fields, left empty for counters not counted
+ */
+static void sample_perf_csv(
+	char *buf,
+	const size_t len,
+	const double *counts,
+	const double dt)
+{
+	size_t i, n = 0;
+
+	*buf = '\0';
+	for (i = 0; sample_perf && (i < PERF_SERIES_MAX) && (n < len); i++) {
+		if (counts[i] >= 0.0)
+			n += (size_t)snprintf(buf + n, len - n, ",%.3f", counts[i] / dt);
+		else
+			n += (size_t)snprintf(buf + n, len - n, ",");
+	}
+}
+
+/*
+ *  sample_add()
+ *	append a stressor's ops/s, and the --perf
+ *	counts per second if counted, to its time series
+ */
+static void sample_add(
+	proc_info_t *pi,
+	const double t,
+	const double rate,
+	const double watts,
+	const double *perf)
+{
+	size_t i;
+
+	if (pi->samples_n >= pi->samples_max) {
+		const size_t max = pi->samples_max ? pi->samples_max * 2 : 256;
+		sample_t *samples;
+
+		samples = realloc(pi->samples, max * sizeof(*samples));
+		if (!samples)
+			return;
+		pi->samples = samples;
+		pi->samples_max = max;
+	}
+	pi->samples[pi->samples_n].time = t;
+	pi->samples[pi->samples_n].rate = rate;
+	pi->samples[pi->samples_n].watts = watts;
+	for (i = 0; i < PERF_SERIES_MAX; i++)
+		pi->samples[pi->samples_n].perf[i] = perf ? perf[i] : -1.0;
+	pi->samples_n++;
+}
+
+/*
+ *  sample_take()
+ *	sample every instance's counter and record the ops/s
+ *	of each stressor, the --energy power and the --perf
+ *	counter rates since the previous sample
+ */
+static void sample_take(const double t_prev, const double t_now)
+{
+	const double dt = t_now - t_prev;
+	const double t = t_now - sample_base;
+	double watts = -1.0, joules;
+	char power[32] = "";
+	proc_info_t *pi;
+
+	if (dt <= 0.0)
+		return;
+
+	if (sample_energy && energy_read(&joules)) {
+		watts = (joules - sample_joules) / dt;
+		sample_joules = joules;
+		(void)snprintf(power, sizeof(power), ",%.3f", watts);
+	}
+
+	for (pi = sample_procs; pi; pi = pi->next) {
+		char name[64], perf_csv[PERF_SERIES_MAX * 24];
+		double perf[PERF_SERIES_MAX], counts[PERF_SERIES_MAX];
+		uint64_t ops = 0;
+		int32_t j;
+		size_t i;
+
+		if (!pi->sample_counters)
+			continue;
+		sample_name(pi, name, sizeof(name));
+		for (i = 0; i < PERF_SERIES_MAX; i++)
+			perf[i] = counts[i] = -1.0;
+		for (j = 0; j < pi->num_procs; j++) {
+			const uint64_t last = pi->sample_counters[j];
+			const uint64_t now = sample_counter(&pi->stats[j]->counter, last);
+
+			ops += now - last;
+			pi->sample_counters[j] = now;
+#if defined(STRESS_PERF_STATS)
+			if (pi->perf_series) {
+				perf_series_read(&pi->perf_series[j], counts);
+				for (i = 0; i < PERF_SERIES_MAX; i++) {
+					if (counts[i] < 0.0)
+						continue;
+					perf[i] = (perf[i] < 0.0) ?
+						counts[i] : perf[i] + counts[i];
+				}
+			}
+#endif
+			if (sample_csv && (g_opt_flags & OPT_FLAGS_SAMPLE_INSTANCES)) {
+				sample_perf_csv(perf_csv, sizeof(perf_csv), counts, dt);
+				(void)fprintf(sample_csv, "%.3f,%s,%" PRId32 ",%" PRIu64 ",%.3f%s%s\n",
+					t, name, j, now - last, (double)(now - last) / dt,
+					power, perf_csv);
+			}
+		}
+		for (i = 0; i < PERF_SERIES_MAX; i++)
+			if (perf[i] >= 0.0)
+				perf[i] /= dt;
+		sample_add(pi, t, (double)ops / dt, watts, perf);
+		if (sample_csv) {
+			for (i = 0; i < PERF_SERIES_MAX; i++)
+				counts[i] = (perf[i] >= 0.0) ? perf[i] * dt : -1.0;
+			sample_perf_csv(perf_csv, sizeof(perf_csv), counts, dt);
+			(void)fprintf(sample_csv, "%.3f,%s,all,%" PRIu64 ",%.3f%s%s\n",
+				t, name, ops, (double)ops / dt, power, perf_csv);
+		}
+	}
+	if (sample_csv)
+		(void)fflush(sample_csv);
+}
+
+/*
+ *  sample_thread_func()
+ *	take a sample every interval until told to stop, plus
+ *	a last partial one unless it is too short to be useful
+ */
+static void *sample_thread_func(void *arg)
+{
+	double t_prev = time_now(), t_next = t_prev + sample_interval;
+
+	(void)arg;
+
+	while (sample_run) {
+		const double t_now = time_now();
+
+		if (t_now >= t_next) {
+			sample_take(t_prev, t_now);
+			t_prev = t_now;
+			/* Keep to the schedule, skipping missed samples */
+			while (t_next <= t_now)
+				t_next += sample_interval;
+		} else {
+			const double wait = (t_next - t_now) * 1000000.0;
+
+			(void)shim_usleep(wait < SAMPLE_POLL_USEC ?
+				(uint64_t)wait : SAMPLE_POLL_USEC);
+		}
+	}
+	if (time_now() - t_prev >= sample_interval / 2.0)
+		sample_take(t_prev, time_now());
+
+	return NULL;
+}
+
+/*
+ *  sample_instance_start()
+ *	start counting the --perf counters of instance j of
+ *	a stressor as soon as it is forked, so processes it
+ *	forks and threads it creates are counted with it
+ */
+void sample_instance_start(proc_info_t *pi, const int32_t j)
+{
+#if defined(STRESS_PERF_STATS)
+	uint64_t interval;
+	int32_t i;
+
+	if (!(g_opt_flags & OPT_FLAGS_PERF_STATS) ||
+	    !get_setting("sample-interval", &interval))
+		return;
+	if (!pi->perf_series) {
+		pi->perf_series = calloc((size_t)pi->num_procs,
+			sizeof(*pi->perf_series));
+		if (!pi->perf_series)
+			return;
+		for (i = 0; i < pi->num_procs; i++)
+			perf_series_open(&pi->perf_series[i], -1);
+	}
+	/* --threads instances share a process */
+	if (j && (pi->pids[j] == pi->pids[0]))
+		return;
+	perf_series_open(&pi->perf_series[j], pi->pids[j]);
+#else
+	(void)pi;
+	(void)j;
+#endif
+}
+
+/*
+ *  sample_csv_header()
+ *	name the CSV columns, the --energy and
+ *	--perf ones only if they are sampled
+ */
+static void sample_csv_header(void)
+{
+	(void)fprintf(sample_csv, "time,stressor,instance,"
+		"bogo-ops,bogo-ops-per-second%s",
+		sample_energy ? ",watts" : "");
+#if defined(STRESS_PERF_STATS)
+	if (sample_perf) {
+		size_t i;
+
+		for (i = 0; i < PERF_SERIES_MAX; i++)
+			(void)fprintf(sample_csv, ",%s-per-second",
+				perf_series_label(i));
+	}
+#endif
+	(void)fprintf(sample_csv, "\n");
+}
+
+/*
+ *  sample_start()
+ *	start sampling the bogo op counters of the
+ *	stressors in procs_list with --sample-interval
+ */
+void sample_start(proc_info_t *procs_list)
+{
+	uint64_t interval;
+	char *filename;
+	proc_info_t *pi;
+	int ret;
+
+	if (!get_setting("sample-interval", &interval))
+		return;
+
+	sample_energy = energy_read(&sample_joules);
+#if defined(STRESS_PERF_STATS)
+	sample_perf = !!(g_opt_flags & OPT_FLAGS_PERF_STATS);
+#endif
+	if (sample_base < 0.0) {
+		sample_base = time_now();
+		if (get_setting("sample-file", &filename)) {
+			sample_csv = fopen(filename, "w");
+			if (sample_csv)
+				sample_csv_header();
+			else
+				pr_err("Cannot output samples to %s\n", filename);
+		}
+	}
+
+	for (pi = procs_list; pi; pi = pi->next) {
+		int32_t j;
+
+		if (!pi->num_procs)
+			continue;
+		pi->sample_counters = calloc((size_t)pi->num_procs,
+			sizeof(*pi->sample_counters));
+		if (!pi->sample_counters)
+			continue;
+		for (j = 0; j < pi->num_procs; j++)
+			pi->sample_counters[j] =
+				sample_counter(&pi->stats[j]->counter, 0);
+#if defined(STRESS_PERF_STATS)
+		/* Counted since the fork, start the first interval now */
+		if (pi->perf_series) {
+			double counts[PERF_SERIES_MAX];
+
+			for (j = 0; j < pi->num_procs; j++)
+				perf_series_read(&pi->perf_series[j], counts);
+		}
+#endif
+	}
+
+	sample_procs = procs_list;
+	sample_interval = (double)interval;
+	sample_run = true;
+	ret = pthread_create(&sample_thread, NULL, sample_thread_func, NULL);
+	sample_running = (ret == 0);
+	if (!sample_running)
+		pr_err("Cannot create sampling thread, errno=%d (%s)\n",
+			ret, strerror(ret));
+}
+
+/*
+ *  sample_stop()
+ *	stop the sampler and take the last sample
+ */
+void sample_stop(void)
+{
+	proc_info_t *pi;
+
+	if (sample_running) {
+		sample_run = false;
+		(void)pthread_join(sample_thread, NULL);
+		sample_running = false;
+	}
+
+	for (pi = sample_procs; pi; pi = pi->next) {
+		free(pi->sample_counters);
+		pi->sample_counters = NULL;
+#if defined(STRESS_PERF_STATS)
+		if (pi->perf_series) {
+			int32_t j;
+
+			for (j = 0; j < pi->num_procs; j++)
+				perf_series_close(&pi->perf_series[j]);
+			free(pi->perf_series);
+			pi->perf_series = NULL;
+		}
+#endif
+	}
+	sample_procs = NULL;
+}
+
+/*
+ *  sample_dump()
+ *	dump the ops/s time series, summarised by
+ *	the slowest and fastest interval, and the
+ *	--perf counter time series
+ */
+void sample_dump(FILE *yaml, proc_info_t *procs_head)
+{
+	proc_info_t *pi;
+	bool dumped_heading = false;
+
+	for (pi = procs_head; pi; pi = pi->next) {
+		const char *munged = munge_underscore(pi->stressor->name);
+		double min, max, sum = 0.0;
+		size_t i;
+#if defined(STRESS_PERF_STATS)
+		size_t k;
+#endif
+
+		if (!pi->samples_n)
+			continue;
+
+		if (!dumped_heading) {
+			dumped_heading = true;
+			pr_inf("%-13s %8s %13s %13s %13s\n",
+				"stressor", "samples", "min ops/s", "mean ops/s", "max ops/s");
+			pr_yaml(yaml, "time-series:\n");
+		}
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      interval: %.3f\n", sample_interval);
+		pr_yaml(yaml, "      bogo-ops-per-second:\n");
+
+		min = max = pi->samples[0].rate;
+		for (i = 0; i < pi->samples_n; i++) {
+			const double rate = pi->samples[i].rate;
+
+			if (rate < min)
+				min = rate;
+			if (rate > max)
+				max = rate;
+			sum += rate;
+			pr_yaml(yaml, "        - [ %.3f, %.3f ]\n",
+				pi->samples[i].time, rate);
+		}
+		if (pi->samples[0].watts >= 0.0) {
+			pr_yaml(yaml, "      watts:\n");
+			for (i = 0; i < pi->samples_n; i++)
+				pr_yaml(yaml, "        - [ %.3f, %.3f ]\n",
+					pi->samples[i].time, pi->samples[i].watts);
+		}
+#if defined(STRESS_PERF_STATS)
+		for (k = 0; k < PERF_SERIES_MAX; k++) {
+			for (i = 0; i < pi->samples_n; i++)
+				if (pi->samples[i].perf[k] >= 0.0)
+					break;
+			if (i == pi->samples_n)
+				continue;
+			pr_yaml(yaml, "      %s-per-second:\n", perf_series_label(k));
+			for (i = 0; i < pi->samples_n; i++)
+				if (pi->samples[i].perf[k] >= 0.0)
+					pr_yaml(yaml, "        - [ %.3f, %.3f ]\n",
+						pi->samples[i].time, pi->samples[i].perf[k]);
+		}
+#endif
+		pr_inf("%-13s %8zu %13.2f %13.2f %13.2f\n", munged,
+			pi->samples_n, min, sum / (double)pi->samples_n, max);
+	}
+	if (dumped_heading)
+		pr_yaml(yaml, "\n");
+}
+
+/*
+ *  sample_free()
+ *	free the time series and close the CSV file
+ */
+void sample_free(proc_info_t *procs_head)
+{
+	proc_info_t *pi;
+
+	for (pi = procs_head; pi; pi = pi->next) {
+		free(pi->samples);
+		pi->samples = NULL;
+		pi->samples_n = 0;
+		pi->samples_max = 0;
+	}
+	if (sample_csv) {
+		(void)fclose(sample_csv);
+		sample_csv = NULL;
+	}
+}
+
+#else
+
+void stress_set_sample_interval(const char *opt)
+{
+	(void)opt;
+
+	(void)fprintf(stderr, "sample-interval is not supported without pthreads\n");
+	longjmp(g_error_env, 1);
+}
+
+void sample_start(proc_info_t *procs_list)
+{
+	(void)procs_list;
+}
+
+void sample_stop(void)
+{
+}
+
+void sample_instance_start(proc_info_t *pi, const int32_t j)
+{
+	(void)pi;
+	(void)j;
+}
+
+void sample_dump(FILE *yaml, proc_info_t *procs_head)
+{
+	(void)yaml;
+	(void)procs_head;
+}
+
+void sample_free(proc_info_t *procs_head)
+{
+	(void)procs_head;
+}
+
+#endif
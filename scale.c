@@ -0,0 +1,301 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+#include <math.h>
+
+static uint32_t scale_counts[MAX_SCALE_SWEEP];	/* instance counts, ascending */
+static size_t scale_n;				/* number of instance counts */
+
+/*
+ *  scale_cmp()
+ *	sort instance counts
+ */
+static int scale_cmp(const void *p1, const void *p2)
+{
+	const uint32_t n1 = *(const uint32_t *)p1;
+	const uint32_t n2 = *(const uint32_t *)p2;
+
+	return (n1 > n2) - (n1 < n2);
+}
+
+/*
+ *  stress_set_scale_sweep()
+ *	set the comma separated instance counts to run
+ *	each stressor with
+ */
+void stress_set_scale_sweep(const char *opt)
+{
+	char *str, *ptr, *token, *saveptr = NULL;
+	size_t i, n = 0;
+
+	str = strdup(opt);
+	if (!str) {
+		(void)fprintf(stderr, "Cannot allocate scale-sweep list\n");
+		longjmp(g_error_env, 1);
+	}
+
+	for (ptr = str; (token = strtok_r(ptr, ",", &saveptr)) != NULL; ptr = NULL) {
+		uint32_t count;
+
+		if (n >= MAX_SCALE_SWEEP) {
+			(void)fprintf(stderr, "scale-sweep allows at most %d "
+				"instance counts\n", MAX_SCALE_SWEEP);
+			free(str);
+			longjmp(g_error_env, 1);
+		}
+		count = get_uint32(token);
+		check_range("scale-sweep", count, 1, STRESS_PROCS_MAX);
+		scale_counts[n++] = count;
+	}
+	free(str);
+
+	if (!n) {
+		(void)fprintf(stderr, "scale-sweep needs at least one instance count\n");
+		longjmp(g_error_env, 1);
+	}
+
+	/* Ascending, without duplicates */
+	qsort(scale_counts, n, sizeof(*scale_counts), scale_cmp);
+	for (scale_n = 0, i = 0; i < n; i++)
+		if (!scale_n || (scale_counts[scale_n - 1] != scale_counts[i]))
+			scale_counts[scale_n++] = scale_counts[i];
+}
+
+/*
+ *  scale_sweep_counts()
+ *	instance counts of the sweep, returns 0 with no --scale-sweep
+ */
+size_t scale_sweep_counts(const uint32_t **counts)
+{
+	*counts = scale_counts;
+	return scale_n;
+}
+
+/*
+ *  scale_sweep_add()
+ *	record the aggregate bogo ops/s of a stressor's run
+ *	with the i'th instance count, over the average wall
+ *	clock time of its instances as --metrics reports it
+ */
+void scale_sweep_add(proc_info_t *pi, const size_t i)
+{
+	uint64_t c_total = 0;
+	double r_total = 0.0;
+	int32_t j;
+
+	if (!pi->scale_rates) {
+		pi->scale_rates = calloc(scale_n, sizeof(*pi->scale_rates));
+		if (!pi->scale_rates)
+			return;
+	}
+
+	for (j = 0; j < pi->started_procs; j++) {
+		c_total += pi->stats[j]->counter;
+		r_total += pi->stats[j]->finish - pi->stats[j]->start;
+	}
+	r_total = pi->started_procs ? r_total / (double)pi->started_procs : 0.0;
+	pi->scale_rates[i] = (r_total > 0.0) ? (double)c_total / r_total : 0.0;
+}
+
+/*
+ *  scale_solve()
+ *	solve the m by m linear system a x = b by Gaussian
+ *	elimination with partial pivoting, returns false
+ *	if it is singular
+ */
+static bool scale_solve(double a[3][3], double b[3], double x[3], const int m)
+{
+	int i, j, k;
+
+	for (i = 0; i < m; i++) {
+		int pivot = i;
+
+		for (j = i + 1; j < m; j++)
+			if (fabs(a[j][i]) > fabs(a[pivot][i]))
+				pivot = j;
+		if (fabs(a[pivot][i]) < 1E-12)
+			return false;
+		if (pivot != i) {
+			double tmp;
+
+			for (k = 0; k < m; k++) {
+				tmp = a[i][k];
+				a[i][k] = a[pivot][k];
+				a[pivot][k] = tmp;
+			}
+			tmp = b[i];
+			b[i] = b[pivot];
+			b[pivot] = tmp;
+		}
+		for (j = i + 1; j < m; j++) {
+			const double f = a[j][i] / a[i][i];
+
+			for (k = i; k < m; k++)
+				a[j][k] -= f * a[i][k];
+			b[j] -= f * b[i];
+		}
+	}
+	for (i = m - 1; i >= 0; i--) {
+		x[i] = b[i];
+		for (k = i + 1; k < m; k++)
+			x[i] -= a[i][k] * x[k];
+		x[i] /= a[i][i];
+	}
+	return true;
+}
+
+/*
+ *  scale_regress()
+ *	least squares fit of n / X(n) = c0 + c1 * (n - 1) +
+ *	c2 * n * (n - 1) to the rates, with c2 = 0 if m is 2
+ */
+static bool scale_regress(const double *rates, double c[3], const int m)
+{
+	double a[3][3] = { { 0.0 } }, b[3] = { 0.0 };
+	size_t i;
+	int j, k, points = 0;
+
+	for (i = 0; i < scale_n; i++) {
+		const double n = (double)scale_counts[i];
+		const double x[3] = { 1.0, n - 1.0, n * (n - 1.0) };
+		double y;
+
+		if (rates[i] <= 0.0)
+			continue;
+		y = n / rates[i];
+		for (j = 0; j < m; j++) {
+			for (k = 0; k < m; k++)
+				a[j][k] += x[j] * x[k];
+			b[j] += x[j] * y;
+		}
+		points++;
+	}
+	c[2] = 0.0;
+	return (points >= m) && scale_solve(a, b, c, m);
+}
+
+/*
+ *  scale_fit()
+ *	least squares fit of Amdahl's law and the Universal
+ *	Scalability Law to the aggregate bogo ops/s X(n),
+ *
+ *	  X(n) = lambda * n / (1 + sigma * (n - 1) + kappa * n * (n - 1))
+ *
+ *	with kappa = 0 and sigma the serial fraction for Amdahl.
+ *	The single instance rate lambda is fitted too, so the
+ *	counts need not start at 1 and no point is assumed to
+ *	scale perfectly. A negative kappa is noise, the USL then
+ *	falls back to the Amdahl fit. Returns false with too few
+ *	points, kappa is 0 with only two
+ */
+static bool scale_fit(
+	const double *rates,
+	double *lambda,
+	double *serial,
+	double *sigma,
+	double *kappa)
+{
+	double c[3];
+
+	if (!scale_regress(rates, c, 2) || (c[0] <= 0.0))
+		return false;
+	*serial = c[1] / c[0];
+	*lambda = 1.0 / c[0];
+	*sigma = *serial;
+	*kappa = 0.0;
+
+	if (scale_regress(rates, c, 3) && (c[0] > 0.0) && (c[2] >= 0.0)) {
+		*lambda = 1.0 / c[0];
+		*sigma = c[1] / c[0];
+		*kappa = c[2] / c[0];
+	}
+	return true;
+}
+
+/*
+ *  scale_sweep_dump()
+ *	dump speedup and parallel efficiency against the smallest
+ *	instance count, and the fitted scalability coefficients
+ */
+void scale_sweep_dump(FILE *yaml, proc_info_t *procs_head)
+{
+	proc_info_t *pi;
+	bool dumped_heading = false;
+
+	for (pi = procs_head; pi; pi = pi->next) {
+		const char *munged = munge_underscore(pi->stressor->name);
+		double base, lambda, serial, sigma, kappa;
+		size_t i;
+
+		if (!pi->scale_rates)
+			continue;
+
+		if (!dumped_heading) {
+			dumped_heading = true;
+			pr_inf("%-13s %9s %13s %9s %10s\n", "stressor",
+				"instances", "bogo ops/s", "speedup", "efficiency");
+			pr_yaml(yaml, "scale-sweep:\n");
+		}
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      points:\n");
+
+		/* Per instance rate of the smallest run */
+		base = pi->scale_rates[0] / (double)scale_counts[0];
+		for (i = 0; i < scale_n; i++) {
+			const double speedup = (base > 0.0) ?
+				pi->scale_rates[i] / base : 0.0;
+			const double efficiency = speedup / (double)scale_counts[i];
+
+			pr_inf("%-13s %9" PRIu32 " %13.2f %9.2f %9.1f%%\n",
+				munged, scale_counts[i], pi->scale_rates[i],
+				speedup, efficiency * 100.0);
+			pr_yaml(yaml, "        - instances: %" PRIu32 "\n", scale_counts[i]);
+			pr_yaml(yaml, "          bogo-ops-per-second: %f\n", pi->scale_rates[i]);
+			pr_yaml(yaml, "          speedup: %f\n", speedup);
+			pr_yaml(yaml, "          efficiency: %f\n", efficiency);
+		}
+
+		if (scale_fit(pi->scale_rates, &lambda, &serial, &sigma, &kappa)) {
+			pr_inf("%-13s Amdahl serial fraction %.4f, "
+				"USL sigma %.4f kappa %.6f, "
+				"%.2f bogo ops/s for 1 instance\n",
+				munged, serial, sigma, kappa, lambda);
+			pr_yaml(yaml, "      amdahl-serial-fraction: %f\n", serial);
+			pr_yaml(yaml, "      usl-sigma: %f\n", sigma);
+			pr_yaml(yaml, "      usl-kappa: %f\n", kappa);
+			pr_yaml(yaml, "      usl-lambda: %f\n", lambda);
+		}
+	}
+	if (dumped_heading)
+		pr_yaml(yaml, "\n");
+}
+
+/*
+ *  scale_sweep_free()
+ *	free the sweep results
+ */
+void scale_sweep_free(proc_info_t *procs_head)
+{
+	proc_info_t *pi;
+
+	for (pi = procs_head; pi; pi = pi->next) {
+		free(pi->scale_rates);
+		pi->scale_rates = NULL;
+	}
+}
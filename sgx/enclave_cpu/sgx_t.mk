@@ -67,12 +67,19 @@ Flags_Just_For_C := -Wno-implicit-function-declaration -std=gnu99
 Common_C_Cpp_Flags := $(SGX_COMMON_CFLAGS) $(CONFIG_CFLAGS) -nostdinc -fvisibility=hidden -fpie $(Enclave_Include_Paths) -fno-builtin-printf -I.
 Enclave_C_Flags := $(Flags_Just_For_C) $(Common_C_Cpp_Flags)
 
+# sgx-lock counts the sleep/wake OCALLs of contended sgx_thread_* primitives
+Enclave_Wrap_Flags := -Wl,--wrap=sgx_thread_wait_untrusted_event_ocall \
+	-Wl,--wrap=sgx_thread_set_untrusted_event_ocall \
+	-Wl,--wrap=sgx_thread_setwait_untrusted_events_ocall \
+	-Wl,--wrap=sgx_thread_set_multiple_untrusted_events_ocall
+
 Enclave_Link_Flags := $(SGX_COMMON_CFLAGS) -Wl,--no-undefined -nostdlib -nodefaultlibs -nostartfiles -L$(SGX_LIBRARY_PATH) \
 	-Wl,--whole-archive -l$(Trts_Library_Name) -Wl,--no-whole-archive \
 	-Wl,--start-group -lsgx_tstdc -lsgx_tcxx -l$(Crypto_Library_Name) -l$(Service_Library_Name) -Wl,--end-group \
 	-Wl,-Bstatic -Wl,-Bsymbolic -Wl,--no-undefined \
 	-Wl,-pie,-eenclave_entry -Wl,--export-dynamic  \
 	-Wl,--defsym,__ImageBase=0 \
+	$(Enclave_Wrap_Flags) \
 	-Wl,--version-script=trusted/enclave.lds
 
 Enclave_C_Objects := $(Enclave_C_Files:.c=.o)
@@ -97,7 +104,7 @@ all: enclave_cpu.so
 	@echo "*********************************************************************************************************************************************************"
 	@echo
 else
-all: enclave_cpu.signed.so
+all: enclave_cpu.signed.so enclave_lock.signed.so
 endif
 
 run: all
@@ -117,7 +124,7 @@ trusted/enclave_t.o: ./trusted/enclave_t.c
 	$(CC) $(Enclave_C_Flags) -c $< -o $@
 	@echo "CC   <=  $<"
 
-trusted/%.o: trusted/%.c trusted/stress-cpu.c ../../config
+trusted/%.o: trusted/%.c trusted/stress-cpu.c trusted/stress-syscall.c trusted/stress-exception.c trusted/stress-lock.c ../../config
 	$(CC) $(Enclave_C_Flags) -c $< -o $@
 	@echo "CC  <=  $<"
 
@@ -128,5 +135,9 @@ enclave_cpu.so: trusted/enclave_t.o $(Enclave_C_Objects)
 enclave_cpu.signed.so: enclave_cpu.so
 	@$(SGX_ENCLAVE_SIGNER) sign -key trusted/enclave_private.pem -enclave enclave_cpu.so -out $@ -config trusted/enclave.config.xml
 	@echo "SIGN =>  $@"
+
+enclave_lock.signed.so: enclave_cpu.so
+	@$(SGX_ENCLAVE_SIGNER) sign -key trusted/enclave_private.pem -enclave enclave_cpu.so -out $@ -config trusted/lock.config.xml
+	@echo "SIGN =>  $@"
 clean:
 	@rm -f enclave.* trusted/enclave_t.*  $(Enclave_C_Objects)
@@ -103,6 +103,44 @@ double _Complex __muldc3(double __a, double __b, double __c, double __d)
 #define OPT_FLAGS_VERIFY	 0x00000000002000ULL	/* verify mode */
 #define OPT_FLAGS_LOG_BRIEF	 0x00010000000000ULL	/* --log-brief */
 
+/* sgx-syscall operation mix, keep in sync with stress-ng.h */
+#define SGX_SYSCALL_WRITE	(0x01)	/* pwrite the buffer */
+#define SGX_SYSCALL_READ	(0x02)	/* pread the buffer */
+#define SGX_SYSCALL_FSTAT	(0x04)	/* fstat the file */
+
+/* sgx-exception triggers, keep in sync with stress-ng.h */
+#define SGX_TRIGGER_DIV0	(0x01)	/* integer divide by zero, #DE */
+#define SGX_TRIGGER_UD2		(0x02)	/* undefined instruction, #UD */
+
+/* sgx-lock primitives, keep in sync with stress-ng.h */
+#define SGX_LOCK_MUTEX		(0)	/* sgx_thread_mutex_t */
+#define SGX_LOCK_SPIN		(1)	/* sgx_spinlock_t */
+#define SGX_LOCK_ATOMIC		(2)	/* lock-free atomic add */
+#define SGX_LOCK_CONDVAR	(3)	/* producer/consumer on sgx_thread_cond_t */
+#define SGX_LOCK_MAX		(4)
+
+/* Log ring shared with the untrusted side, keep in sync with sgx/utils.h */
+#define SGX_LOG_SLOTS		(256)
+#define SGX_LOG_MSG_LEN		(240)
+
+#define SGX_LOG_DBG		(0x01)	/* pr_dbg */
+#define SGX_LOG_ERR		(0x02)	/* pr_err */
+#define SGX_LOG_FAIL		(0x04)	/* pr_fail */
+
+typedef struct {
+	volatile uint64_t seq;		/* slot index + 1 once written */
+	uint32_t level;			/* SGX_LOG_* */
+	char msg[SGX_LOG_MSG_LEN];	/* NUL terminated message */
+} sgx_log_rec_t;
+
+typedef struct {
+	volatile uint64_t head;		/* next slot to fill */
+	volatile uint64_t tail;		/* next slot to drain */
+	volatile uint64_t dropped;	/* messages lost to a full ring */
+	uint32_t levels;		/* SGX_LOG_* levels worth sending */
+	sgx_log_rec_t rec[SGX_LOG_SLOTS];
+} sgx_log_ring_t;
+
 #define STRESS_VECTOR	1
 #define CASE_FALLTHROUGH __attribute__((fallthrough)) /* Fallthrough */
 #define NORETURN 	__attribute__ ((noreturn))
@@ -286,6 +324,45 @@ typedef struct {
 	size_t page_size;		/* page size */
 } args_t;
 
+static sgx_log_ring_t *g_log_ring;	/* untrusted log ring, NULL to OCALL */
+
+/*
+ *  sgx_log_push()
+ *	format a message straight into a slot of the untrusted log
+ *	ring, so logging does not cost an enclave exit; returns false
+ *	if no ring was set up and the caller should OCALL instead
+ */
+static bool sgx_log_push(const uint32_t level, const char *fmt, va_list ap)
+{
+	sgx_log_ring_t *ring = g_log_ring;
+	sgx_log_rec_t *rec;
+	uint64_t head;
+	int n;
+
+	if (!ring)
+		return false;
+	if (!(ring->levels & level))
+		return true;
+
+	head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	do {
+		if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= SGX_LOG_SLOTS) {
+			__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+			return true;
+		}
+	} while (!__atomic_compare_exchange_n(&ring->head, &head, head + 1,
+			false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	/* head is ours, only the slot index is taken from it */
+	rec = &ring->rec[head % SGX_LOG_SLOTS];
+	rec->level = level;
+	n = vsnprintf(rec->msg, SGX_LOG_MSG_LEN, fmt, ap);
+	if (n >= SGX_LOG_MSG_LEN)
+		rec->msg[SGX_LOG_MSG_LEN - 2] = '\n';
+	__atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
 void pr_fail(const char *fmt, ...)
 {
 	int ret = 0;
@@ -293,9 +370,11 @@ void pr_fail(const char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-	ret = vsnprintf(buf, BUFSIZ, fmt, ap);
-	if (ret >= 0) {
-		ocall_pr_fail(buf);
+	if (!sgx_log_push(SGX_LOG_FAIL, fmt, ap)) {
+		ret = vsnprintf(buf, BUFSIZ, fmt, ap);
+		if (ret >= 0) {
+			ocall_pr_fail(buf);
+		}
 	}
 	va_end(ap);
 }
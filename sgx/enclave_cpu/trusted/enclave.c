@@ -18,6 +18,9 @@
  */
 #include "enclave_t.h"  /* print_string */
 #include "stress-cpu.c"
+#include "stress-syscall.c"
+#include "stress-exception.c"
+#include "stress-lock.c"
 #include <stdio.h>
 
 /*
@@ -32,11 +35,83 @@ bool HOT OPTIMIZE3 keep_stressing(const uint64_t rounds, uint64_t *const counter
 
 void run_stressor(const stress_cpu_method_info_t* info, const uint64_t rounds, uint64_t *const counter) {
 	do {
-		(info->func)("stress-sgx");
+		stress_cpu_method(info, "stress-sgx");
 		(*counter)++;
 	} while(keep_stressing(rounds, counter));
 }
 
+/*
+ *  run_stressor_load()
+ *	run at load % utilisation, busy for a slice then sleep for
+ *	the rest of the duty cycle. Time comes from the untrusted
+ *	clock, the enclave only leaves (to sleep) at slice boundaries.
+ *	load_slice < 0 is iterations per slice, 0 random slices of
+ *	up to 0.5 seconds, > 0 slice length in milliseconds. A slice
+ *	ends early once the counter reaches rounds, the --sgx-ops
+ *	limit or the --sgx-ops-per-ecall cap of this ECALL.
+ */
+void run_stressor_load(const stress_cpu_method_info_t* info, const uint64_t rounds,
+		uint64_t *const counter, const int32_t load, const int32_t load_slice) {
+	int64_t bias = 0;
+
+	do {
+		int64_t delay;
+		uint64_t t1, t2, t3;
+
+		t1 = *g_clock;
+		if (load_slice < 0) {
+			int32_t j;
+
+			for (j = 0; j < -load_slice; j++) {
+				stress_cpu_method(info, "stress-sgx");
+				if (!*g_keep_stressing_flag)
+					break;
+				(*counter)++;
+				if (!keep_stressing(rounds, counter))
+					break;
+			}
+			t2 = *g_clock;
+		} else {
+			const uint64_t slice_end = t1 + (load_slice ?
+				(uint64_t)load_slice * 1000000ULL :
+				((uint64_t)mwc16() * 1000000000ULL) / 131072ULL);
+
+			do {
+				stress_cpu_method(info, "stress-sgx");
+				t2 = *g_clock;
+				if (!*g_keep_stressing_flag)
+					break;
+				(*counter)++;
+			} while ((t2 < slice_end) && keep_stressing(rounds, counter));
+		}
+		/* Must not calculate this with zero % load */
+		delay = (int64_t)((t2 - t1) * (100 - load)) / load;
+		delay -= bias;
+		if (delay > 0) {
+			int ret;
+
+			(void)ocall_shim_usleep(&ret, (uint64_t)delay / 1000);
+		}
+
+		t3 = *g_clock;
+		/* Bias takes account of the time to do the delay */
+		bias = (int64_t)(t3 - t2) - delay;
+	} while (keep_stressing(rounds, counter));
+}
+
+/*
+ *  ecall_set_log_ring()
+ *	send pr_fail to an untrusted log ring,
+ *	NULL goes back to one OCALL per message
+ */
+int ecall_set_log_ring(void *ring)
+{
+	if (ring && !sgx_is_outside_enclave(ring, sizeof(sgx_log_ring_t)))
+		return -1;
+	g_log_ring = (sgx_log_ring_t *)ring;
+	return 0;
+}
+
 int ecall_cpu_method_exists(const char* method_name)
 {
 	stress_cpu_method_info_t const *info;
@@ -62,12 +137,35 @@ void ecall_get_cpu_methods_error(char* out_methods, int length)
 	}
 }
 
+int ecall_get_cpu_method_stats(uint64_t *ops, uint64_t *nsec,
+		char *names, size_t names_size, int max)
+{
+	stress_cpu_method_info_t const *info;
+	const size_t name_len = max > 0 ? names_size / max : 0;
+	int n = 0;
+
+	/* "all" only dispatches, its time is already in the other methods */
+	for (info = cpu_methods + 1; info->func && (n < max); info++) {
+		const size_t i = info - cpu_methods;
+
+		if ((i >= CPU_METHODS_MAX) || !cpu_method_ops[i])
+			continue;
+		ops[n] = cpu_method_ops[i];
+		nsec[n] = cpu_method_nsec[i];
+		(void)snprintf(names + (n * name_len), name_len, "%s", info->name);
+		n++;
+	}
+	return n;
+}
+
 int ecall_stress_cpu(const char* method_name, const uint64_t rounds,
-		uint64_t * const counter, bool* keep_stressing_flag, uint64_t opt_flags) {
+		uint64_t * const counter, bool* keep_stressing_flag, uint64_t opt_flags,
+		uint64_t *clock, int32_t load, int32_t load_slice) {
 	stress_cpu_method_info_t const *info;
 
 	g_opt_flags = opt_flags;
 	g_keep_stressing_flag = keep_stressing_flag;
+	g_clock = clock;
 
 	if (g_keep_stressing_flag == 0) {
 		return -1;
@@ -75,10 +173,87 @@ int ecall_stress_cpu(const char* method_name, const uint64_t rounds,
 
 	for (info = cpu_methods; info->func; info++) {
 		if (!strcmp(info->name, method_name)) {
-			run_stressor(info, rounds, counter);
+			if ((load > 0) && (load < 100) && g_clock)
+				run_stressor_load(info, rounds, counter, load, load_slice);
+			else
+				run_stressor(info, rounds, counter);
 			return 0;
 		}
 	}
 
 	return -1;
 }
+
+int ecall_stress_syscall(const char* path, int flags, uint32_t mix,
+		size_t io_size, const uint64_t rounds, uint64_t * const counter,
+		bool* keep_stressing_flag, uint64_t opt_flags) {
+	uint8_t *buf;
+	int ret = 0;
+
+	g_opt_flags = opt_flags;
+	g_keep_stressing_flag = keep_stressing_flag;
+
+	if (g_keep_stressing_flag == 0) {
+		return -1;
+	}
+
+	buf = malloc(io_size);
+	if (!buf) {
+		return -1;
+	}
+
+	do {
+		ret = stress_syscall(path, flags, mix, buf, io_size, *counter);
+		if (ret < 0)
+			break;
+		(*counter)++;
+	} while (keep_stressing(rounds, counter));
+
+	free(buf);
+	return ret;
+}
+
+int ecall_stress_exception(uint32_t triggers, const uint64_t rounds,
+		uint64_t * const counter, bool* keep_stressing_flag, uint64_t opt_flags) {
+	void *handler;
+	int ret = 0;
+
+	g_opt_flags = opt_flags;
+	g_keep_stressing_flag = keep_stressing_flag;
+
+	if (g_keep_stressing_flag == 0) {
+		return -1;
+	}
+
+	handler = sgx_register_exception_handler(1, stress_exception_handler);
+	if (!handler) {
+		return -1;
+	}
+
+	do {
+		ret = stress_exception(triggers, *counter);
+		if (ret < 0)
+			break;
+		(*counter)++;
+	} while (keep_stressing(rounds, counter));
+
+	(void)sgx_unregister_exception_handler(handler);
+	return ret;
+}
+
+int ecall_stress_lock(int primitive, int thread, bool* run, uint64_t *ops) {
+	if ((primitive < 0) || (primitive >= SGX_LOCK_MAX)) {
+		return -1;
+	}
+	*ops = stress_lock(primitive, thread, run);
+	return 0;
+}
+
+void ecall_stop_lock(void) {
+	stress_lock_stop();
+}
+
+void ecall_get_lock_ocalls(uint64_t *sleeps, uint64_t *wakes) {
+	*sleeps = __atomic_exchange_n(&lock_sleep_ocalls, 0, __ATOMIC_RELAXED);
+	*wakes = __atomic_exchange_n(&lock_wake_ocalls, 0, __ATOMIC_RELAXED);
+}
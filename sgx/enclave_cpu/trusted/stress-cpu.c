@@ -21,6 +21,7 @@
 
 uint64_t g_opt_flags;
 bool* g_keep_stressing_flag;
+volatile uint64_t *g_clock;	/* untrusted clock, NULL if not timing */
 
 #define GAMMA 		(0.57721566490153286060651209008240243104215933593992L)
 #define OMEGA		(0.56714329040978387299996866221035554975381578718651L)
@@ -99,6 +100,12 @@ typedef struct {
 
 static const stress_cpu_method_info_t cpu_methods[];
 
+#define CPU_METHODS_MAX	(96)
+
+/* Per method bogo ops and time, indexed as cpu_methods[] */
+static uint64_t cpu_method_ops[CPU_METHODS_MAX];
+static uint64_t cpu_method_nsec[CPU_METHODS_MAX];
+
 /* Don't make this static to ensure dithering does not get optimised out */
 uint8_t pixels[STRESS_CPU_DITHER_X][STRESS_CPU_DITHER_Y];
 
@@ -2167,6 +2174,25 @@ static void stress_cpu_enclave_transitions(const char *name)
 	}
 }
 
+/*
+ *  stress_cpu_method()
+ *	run a cpu method once and account for it
+ */
+static inline void HOT stress_cpu_method(
+	const stress_cpu_method_info_t *info,
+	const char *name)
+{
+	const size_t i = info - cpu_methods;
+	const uint64_t t = g_clock ? *g_clock : 0;
+
+	info->func(name);
+	if (LIKELY(i < CPU_METHODS_MAX)) {
+		cpu_method_ops[i]++;
+		if (g_clock)
+			cpu_method_nsec[i] += *g_clock - t;
+	}
+}
+
 /*
  *  stress_cpu_all()
  *	iterate over all cpu stressors
@@ -2175,7 +2201,7 @@ static HOT OPTIMIZE3 void stress_cpu_all(const char *name)
 {
 	static int i = 1;	/* Skip over stress_cpu_all */
 
-	cpu_methods[i++].func(name);
+	stress_cpu_method(&cpu_methods[i++], name);
 	if (!cpu_methods[i].func)
 		i = 1;
 }
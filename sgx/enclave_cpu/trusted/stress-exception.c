@@ -0,0 +1,90 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <sgx_trts_exception.h>
+
+/*
+ *  Both triggers are 2 byte instructions (divl %ecx is f7 f1,
+ *  ud2 is 0f 0b), the handler emulates them by skipping over
+ *  the faulting instruction, as an instruction emulator would
+ */
+#define TRIGGER_INSN_LEN	(2)
+
+static volatile uint64_t exceptions_handled;
+
+/*
+ *  stress_exception_handler()
+ *	handle #DE and #UD raised by the triggers, the AEX and
+ *	the two stage dispatch by the trts is what is stressed
+ */
+static int stress_exception_handler(sgx_exception_info_t *info)
+{
+	if ((info->exception_vector != SGX_EXCEPTION_VECTOR_DE) &&
+	    (info->exception_vector != SGX_EXCEPTION_VECTOR_UD))
+		return EXCEPTION_CONTINUE_SEARCH;
+
+#if defined(__x86_64__)
+	info->cpu_context.rip += TRIGGER_INSN_LEN;
+#else
+	info->cpu_context.eip += TRIGGER_INSN_LEN;
+#endif
+	exceptions_handled++;
+
+	return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+/*
+ *  stress_exception_trigger()
+ *	raise a #DE or #UD
+ */
+static inline void stress_exception_trigger(const uint32_t trigger)
+{
+	if (trigger == SGX_TRIGGER_DIV0) {
+		uint32_t a = 1, d = 0;
+
+		__asm__ __volatile__("divl %2"
+			: "+a" (a), "+d" (d)
+			: "c" (0)
+			: "cc");
+	} else {
+		__asm__ __volatile__("ud2");
+	}
+}
+
+/*
+ *  stress_exception()
+ *	raise one exception of each trigger in turn from the
+ *	triggers mask, returns 0 if it was handled
+ */
+static int stress_exception(const uint32_t triggers, const uint64_t counter)
+{
+	const uint64_t handled = exceptions_handled;
+	uint32_t trigger = triggers;
+
+	if (triggers == (SGX_TRIGGER_DIV0 | SGX_TRIGGER_UD2))
+		trigger = (counter & 1) ? SGX_TRIGGER_UD2 : SGX_TRIGGER_DIV0;
+
+	stress_exception_trigger(trigger);
+
+	if ((g_opt_flags & OPT_FLAGS_VERIFY) &&
+	    (exceptions_handled != handled + 1)) {
+		pr_fail("stress-sgx-exception: exception was not handled\n");
+		return -1;
+	}
+	return 0;
+}
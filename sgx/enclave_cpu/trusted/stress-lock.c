@@ -0,0 +1,173 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <sgx_thread.h>
+#include <sgx_spinlock.h>
+
+#define LOCK_QUEUE_MAX		(16)
+
+static sgx_thread_mutex_t lock_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+static sgx_thread_cond_t lock_not_empty = SGX_THREAD_COND_INITIALIZER;
+static sgx_thread_cond_t lock_not_full = SGX_THREAD_COND_INITIALIZER;
+static sgx_spinlock_t lock_spin = SGX_SPINLOCK_INITIALIZER;
+static volatile uint64_t lock_counter;
+static uint32_t lock_queue_len;
+
+/*
+ *  Contended sgx_thread_* primitives leave the enclave to sleep on
+ *  and wake untrusted events. The enclave is linked with --wrap on
+ *  these OCALLs (see sgx_t.mk) so that they can be counted here.
+ */
+static uint64_t lock_sleep_ocalls;
+static uint64_t lock_wake_ocalls;
+
+extern sgx_status_t __real_sgx_thread_wait_untrusted_event_ocall(int *retval,
+	const void *self);
+extern sgx_status_t __real_sgx_thread_set_untrusted_event_ocall(int *retval,
+	const void *waiter);
+extern sgx_status_t __real_sgx_thread_setwait_untrusted_events_ocall(int *retval,
+	const void *waiter, const void *self);
+extern sgx_status_t __real_sgx_thread_set_multiple_untrusted_events_ocall(int *retval,
+	const void **waiters, size_t total);
+
+sgx_status_t __wrap_sgx_thread_wait_untrusted_event_ocall(int *retval,
+	const void *self)
+{
+	__atomic_fetch_add(&lock_sleep_ocalls, 1, __ATOMIC_RELAXED);
+	return __real_sgx_thread_wait_untrusted_event_ocall(retval, self);
+}
+
+sgx_status_t __wrap_sgx_thread_set_untrusted_event_ocall(int *retval,
+	const void *waiter)
+{
+	__atomic_fetch_add(&lock_wake_ocalls, 1, __ATOMIC_RELAXED);
+	return __real_sgx_thread_set_untrusted_event_ocall(retval, waiter);
+}
+
+sgx_status_t __wrap_sgx_thread_setwait_untrusted_events_ocall(int *retval,
+	const void *waiter, const void *self)
+{
+	__atomic_fetch_add(&lock_sleep_ocalls, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&lock_wake_ocalls, 1, __ATOMIC_RELAXED);
+	return __real_sgx_thread_setwait_untrusted_events_ocall(retval, waiter, self);
+}
+
+sgx_status_t __wrap_sgx_thread_set_multiple_untrusted_events_ocall(int *retval,
+	const void **waiters, size_t total)
+{
+	__atomic_fetch_add(&lock_wake_ocalls, 1, __ATOMIC_RELAXED);
+	return __real_sgx_thread_set_multiple_untrusted_events_ocall(retval, waiters, total);
+}
+
+/*
+ *  stress_lock_produce()
+ *	queue one item, waiting while the queue is full
+ */
+static bool stress_lock_produce(volatile bool *run)
+{
+	(void)sgx_thread_mutex_lock(&lock_mutex);
+	while ((lock_queue_len >= LOCK_QUEUE_MAX) && *run)
+		(void)sgx_thread_cond_wait(&lock_not_full, &lock_mutex);
+	if (!*run) {
+		(void)sgx_thread_mutex_unlock(&lock_mutex);
+		return false;
+	}
+	lock_queue_len++;
+	(void)sgx_thread_cond_signal(&lock_not_empty);
+	(void)sgx_thread_mutex_unlock(&lock_mutex);
+	return true;
+}
+
+/*
+ *  stress_lock_consume()
+ *	dequeue one item, waiting while the queue is empty
+ */
+static bool stress_lock_consume(volatile bool *run)
+{
+	(void)sgx_thread_mutex_lock(&lock_mutex);
+	while (!lock_queue_len && *run)
+		(void)sgx_thread_cond_wait(&lock_not_empty, &lock_mutex);
+	if (!*run) {
+		(void)sgx_thread_mutex_unlock(&lock_mutex);
+		return false;
+	}
+	lock_queue_len--;
+	(void)sgx_thread_cond_signal(&lock_not_full);
+	(void)sgx_thread_mutex_unlock(&lock_mutex);
+	return true;
+}
+
+/*
+ *  stress_lock()
+ *	hammer the shared counter with primitive until *run
+ *	drops, returns the number of ops done by this thread.
+ *	For condvar even threads produce and odd threads consume,
+ *	only consumed items count as ops
+ */
+static uint64_t stress_lock(const int primitive, const int thread, volatile bool *run)
+{
+	uint64_t ops = 0;
+
+	switch (primitive) {
+	case SGX_LOCK_MUTEX:
+		while (*run) {
+			(void)sgx_thread_mutex_lock(&lock_mutex);
+			lock_counter++;
+			(void)sgx_thread_mutex_unlock(&lock_mutex);
+			ops++;
+		}
+		break;
+	case SGX_LOCK_SPIN:
+		while (*run) {
+			(void)sgx_spin_lock(&lock_spin);
+			lock_counter++;
+			(void)sgx_spin_unlock(&lock_spin);
+			ops++;
+		}
+		break;
+	case SGX_LOCK_ATOMIC:
+		while (*run) {
+			__atomic_fetch_add(&lock_counter, 1, __ATOMIC_SEQ_CST);
+			ops++;
+		}
+		break;
+	case SGX_LOCK_CONDVAR:
+		if (thread & 1) {
+			while (stress_lock_consume(run))
+				ops++;
+		} else {
+			while (stress_lock_produce(run))
+				;
+		}
+		break;
+	}
+	return ops;
+}
+
+/*
+ *  stress_lock_stop()
+ *	wake any producer or consumer still waiting, *run
+ *	must already be false
+ */
+static void stress_lock_stop(void)
+{
+	(void)sgx_thread_mutex_lock(&lock_mutex);
+	(void)sgx_thread_cond_broadcast(&lock_not_empty);
+	(void)sgx_thread_cond_broadcast(&lock_not_full);
+	(void)sgx_thread_mutex_unlock(&lock_mutex);
+}
@@ -0,0 +1,142 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ *  The enclave has no system calls of its own, so like a library OS
+ *  it forwards every file operation to the untrusted side through an
+ *  OCALL. Buffers are copied out of the enclave on write and back in
+ *  on read by the edger8r generated bridges. The OCALLs return
+ *  -errno on failure.
+ */
+
+/*
+ *  stress_syscall_fill()
+ *	fill buffer with a pattern derived from the bogo op counter
+ */
+static void stress_syscall_fill(uint8_t *buf, const size_t io_size, const uint64_t seed)
+{
+	register size_t i;
+	register uint8_t val = (uint8_t)seed;
+
+	for (i = 0; i < io_size; i++)
+		buf[i] = val++;
+}
+
+/*
+ *  stress_syscall_check()
+ *	check buffer holds the pattern written by stress_syscall_fill
+ */
+static bool stress_syscall_check(const uint8_t *buf, const size_t io_size, const uint64_t seed)
+{
+	register size_t i;
+	register uint8_t val = (uint8_t)seed;
+
+	for (i = 0; i < io_size; i++, val++)
+		if (buf[i] != val)
+			return false;
+	return true;
+}
+
+/*
+ *  stress_syscall()
+ *	one open, [pwrite], [fstat], [pread], close round trip
+ *	through the OCALL proxy, returns 0 on success. An OCALL
+ *	that fails at the SGX layer leaves its result untouched,
+ *	so results start as -1 and the status is checked too
+ */
+static int stress_syscall(
+	const char *path,
+	const int flags,
+	const uint32_t mix,
+	uint8_t *buf,
+	const size_t io_size,
+	const uint64_t seed)
+{
+	const bool verify = (g_opt_flags & OPT_FLAGS_VERIFY) &&
+		(mix & SGX_SYSCALL_WRITE) && (mix & SGX_SYSCALL_READ);
+	int ret = 0;
+	long fd = -1, n = -1;
+	uint64_t size;
+	sgx_status_t status;
+
+	status = ocall_open(&fd, path, flags, 0600);
+	if (status != SGX_SUCCESS) {
+		pr_fail("stress-sgx-syscall: open OCALL failed, status=%d\n", status);
+		return -1;
+	}
+	if (fd < 0) {
+		pr_fail("stress-sgx-syscall: open failed, errno=%ld\n", -fd);
+		return -1;
+	}
+	if (mix & SGX_SYSCALL_WRITE) {
+		if (verify)
+			stress_syscall_fill(buf, io_size, seed);
+		status = ocall_pwrite(&n, (int)fd, buf, io_size, 0);
+		if (status != SGX_SUCCESS) {
+			pr_fail("stress-sgx-syscall: pwrite OCALL failed, status=%d\n", status);
+			ret = -1;
+			goto close;
+		}
+		if (n != (long)io_size) {
+			pr_fail("stress-sgx-syscall: pwrite failed, returned %ld\n", n);
+			ret = -1;
+			goto close;
+		}
+	}
+	if (mix & SGX_SYSCALL_FSTAT) {
+		n = -1;
+		status = ocall_fstat(&n, (int)fd, &size);
+		if (status != SGX_SUCCESS) {
+			pr_fail("stress-sgx-syscall: fstat OCALL failed, status=%d\n", status);
+			ret = -1;
+			goto close;
+		}
+		if (n < 0) {
+			pr_fail("stress-sgx-syscall: fstat failed, errno=%ld\n", -n);
+			ret = -1;
+			goto close;
+		}
+	}
+	if (mix & SGX_SYSCALL_READ) {
+		n = -1;
+		status = ocall_pread(&n, (int)fd, buf, io_size, 0);
+		if (status != SGX_SUCCESS) {
+			pr_fail("stress-sgx-syscall: pread OCALL failed, status=%d\n", status);
+			ret = -1;
+			goto close;
+		}
+		if (n != (long)io_size) {
+			pr_fail("stress-sgx-syscall: pread failed, returned %ld\n", n);
+			ret = -1;
+			goto close;
+		}
+		if (verify && !stress_syscall_check(buf, io_size, seed)) {
+			pr_fail("stress-sgx-syscall: data read back does not "
+				"match data written\n");
+			ret = -1;
+		}
+	}
+close:
+	status = ocall_close(&n, (int)fd);
+	if (status != SGX_SUCCESS) {
+		pr_fail("stress-sgx-syscall: close OCALL failed, status=%d\n", status);
+		ret = -1;
+	}
+	return ret;
+}
@@ -98,7 +98,7 @@ all: enclave_vm.so
 	@echo "*********************************************************************************************************************************************************"
 	@echo
 else
-all: enclave_vm.signed.so
+all: enclave_vm.signed.so enclave_vm_threads.signed.so
 endif
 
 run: all
@@ -129,5 +129,9 @@ enclave_vm.so: trusted/vm_t.o $(Vm_C_Objects)
 enclave_vm.signed.so: enclave_vm.so
 	@$(SGX_ENCLAVE_SIGNER) sign -key trusted/vm_private.pem -enclave enclave_vm.so -out $@ -config trusted/vm.config.xml
 	@echo "SIGN =>  $@"
+
+enclave_vm_threads.signed.so: enclave_vm.so
+	@$(SGX_ENCLAVE_SIGNER) sign -key trusted/vm_private.pem -enclave enclave_vm.so -out $@ -config trusted/vm_threads.config.xml
+	@echo "SIGN =>  $@"
 clean:
 	@rm -f vm.* trusted/vm_t.*  $(Vm_C_Objects)
@@ -30,12 +30,13 @@ typedef struct {
 	uint32_t z;
 } mwc_t;
 
-static mwc_t __mwc = {
+/* Per thread, so --sgx-vm-threads can re-seed without clashing */
+static __thread mwc_t __mwc = {
 	MWC_SEED_W,
 	MWC_SEED_Z
 };
 
-static uint8_t mwc_n8, mwc_n16;
+static __thread uint8_t mwc_n8, mwc_n16;
 
 static inline void mwc_flush(void)
 {
@@ -94,7 +95,7 @@ HOT OPTIMIZE3 uint64_t mwc64(void)
  */
 HOT OPTIMIZE3 uint16_t mwc16(void)
 {
-	static uint32_t mwc_saved;
+	static __thread uint32_t mwc_saved;
 
 	if (mwc_n16) {
 		mwc_n16--;
@@ -112,7 +113,7 @@ HOT OPTIMIZE3 uint16_t mwc16(void)
  */
 HOT OPTIMIZE3 uint8_t mwc8(void)
 {
-	static uint32_t mwc_saved;
+	static __thread uint32_t mwc_saved;
 
 	if (LIKELY(mwc_n8)) {
 		mwc_n8--;
@@ -125,6 +126,45 @@ HOT OPTIMIZE3 uint8_t mwc8(void)
 }
 
 
+sgx_log_ring_t *g_log_ring;	/* untrusted log ring, NULL to OCALL */
+
+/*
+ *  sgx_log_push()
+ *	format a message straight into a slot of the untrusted log
+ *	ring, so logging does not cost an enclave exit; returns false
+ *	if no ring was set up and the caller should OCALL instead
+ */
+static bool sgx_log_push(const uint32_t level, const char *fmt, va_list ap)
+{
+	sgx_log_ring_t *ring = g_log_ring;
+	sgx_log_rec_t *rec;
+	uint64_t head;
+	int n;
+
+	if (!ring)
+		return false;
+	if (!(ring->levels & level))
+		return true;
+
+	head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	do {
+		if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= SGX_LOG_SLOTS) {
+			__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+			return true;
+		}
+	} while (!__atomic_compare_exchange_n(&ring->head, &head, head + 1,
+			false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	/* head is ours, only the slot index is taken from it */
+	rec = &ring->rec[head % SGX_LOG_SLOTS];
+	rec->level = level;
+	n = vsnprintf(rec->msg, SGX_LOG_MSG_LEN, fmt, ap);
+	if (n >= SGX_LOG_MSG_LEN)
+		rec->msg[SGX_LOG_MSG_LEN - 2] = '\n';
+	__atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
 void pr_dbg(const char *fmt, ...)
 {
 	int ret = 0;
@@ -132,9 +172,27 @@ void pr_dbg(const char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-	ret = vsnprintf(buf, BUFSIZ, fmt, ap);
-	if (ret >= 0) {
-		ocall_pr_dbg(buf);
+	if (!sgx_log_push(SGX_LOG_DBG, fmt, ap)) {
+		ret = vsnprintf(buf, BUFSIZ, fmt, ap);
+		if (ret >= 0) {
+			ocall_pr_dbg(buf);
+		}
+	}
+	va_end(ap);
+}
+
+void pr_err(const char *fmt, ...)
+{
+	int ret = 0;
+	char buf[BUFSIZ] = {'\0'};
+	va_list ap;
+
+	va_start(ap, fmt);
+	if (!sgx_log_push(SGX_LOG_ERR, fmt, ap)) {
+		ret = vsnprintf(buf, BUFSIZ, fmt, ap);
+		if (ret >= 0) {
+			ocall_pr_err(buf);
+		}
 	}
 	va_end(ap);
 }
@@ -146,9 +204,11 @@ void pr_fail(const char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-	ret = vsnprintf(buf, BUFSIZ, fmt, ap);
-	if (ret >= 0) {
-		ocall_pr_fail(buf);
+	if (!sgx_log_push(SGX_LOG_FAIL, fmt, ap)) {
+		ret = vsnprintf(buf, BUFSIZ, fmt, ap);
+		if (ret >= 0) {
+			ocall_pr_fail(buf);
+		}
 	}
 	va_end(ap);
 }
@@ -24,19 +24,49 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #define OPTIMIZE3 	__attribute__((optimize("-O3")))
 
 #define HOT		__attribute__ ((hot))
+#define NOINLINE	__attribute__ ((noinline))
 #define LIKELY(x)	__builtin_expect((x),1)
 
 #define OPT_FLAGS_MMAP_MINCORE	 0x00000000008000ULL	/* mincore force pages into mem */
 #define OPT_FLAGS_VERIFY	 0x00000000002000ULL	/* verify mode */
 #define OPT_FLAGS_SGX_VM_KEEP	 0x40000000000000ULL	/* Don't keep re-allocating */
+#define OPT_FLAGS_SGX_VM_COMMIT	 0x80000000000000ULL	/* Grow and re-allocate to time EPC commits */
 
 #define VM_BOGO_SHIFT		(12)
 
+/* First touch size buckets, keep in sync with stress-ng.h */
+#define SGX_VM_COMMIT_SIZES	(32)
+
+/* Log ring shared with the untrusted side, keep in sync with sgx/utils.h */
+#define SGX_LOG_SLOTS		(256)
+#define SGX_LOG_MSG_LEN		(240)
+
+#define SGX_LOG_DBG		(0x01)	/* pr_dbg */
+#define SGX_LOG_ERR		(0x02)	/* pr_err */
+#define SGX_LOG_FAIL		(0x04)	/* pr_fail */
+
+typedef struct {
+	volatile uint64_t seq;		/* slot index + 1 once written */
+	uint32_t level;			/* SGX_LOG_* */
+	char msg[SGX_LOG_MSG_LEN];	/* NUL terminated message */
+} sgx_log_rec_t;
+
+typedef struct {
+	volatile uint64_t head;		/* next slot to fill */
+	volatile uint64_t tail;		/* next slot to drain */
+	volatile uint64_t dropped;	/* messages lost to a full ring */
+	uint32_t levels;		/* SGX_LOG_* levels worth sending */
+	sgx_log_rec_t rec[SGX_LOG_SLOTS];
+} sgx_log_ring_t;
+
 #define DEFAULT_VM_HANG		(~0ULL)
 
 #define PAGE_4K_SHIFT		(12)
@@ -46,6 +76,7 @@
 #define PRIME_64		(0x8f0000000017116dULL)
 
 extern int mincore_touch_pages(void *buf, const size_t buf_len);
+extern sgx_log_ring_t *g_log_ring;
 
 typedef int pid_t;
 
@@ -35,12 +35,6 @@
 #define VM_ROWHAMMER_LOOPS	(1000000)
 
 
-#define SET_AND_TEST(ptr, val, bit_errors)	\
-{						\
-	*ptr = val;				\
-	bit_errors += (*ptr != val);		\
-}
-
 /*
  *  This compiles down to a load, ror, store in x86
  */
@@ -151,6 +145,117 @@ static inline size_t stress_vm_count_bits(uint64_t v)
 	return n;
 }
 
+/* 32 byte vectors, one AVX2 register or a pair of SSE2 registers */
+typedef uint64_t stress_vm_vec_t
+	__attribute__ ((vector_size (32), aligned (8), __may_alias__));
+
+#define VM_VERIFY_VECS		(8)	/* vectors folded per block */
+#define VM_VERIFY_BLOCK		(VM_VERIFY_VECS * sizeof(stress_vm_vec_t))
+#define VM_WALK_CHUNK		(64 * 1024)
+
+/* Verify phase accounting, shared by all --sgx-vm-threads */
+static uint64_t vm_verify_bytes;
+static uint64_t vm_verify_nsec;
+
+/*
+ *  stress_vm_count_diff()
+ *	count the bits that differ between buf and ref
+ */
+static size_t stress_vm_count_diff(
+	const uint8_t *buf,
+	const uint8_t *ref,
+	const size_t n)
+{
+	size_t i, bit_errors = 0;
+
+	for (i = 0; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+		uint64_t a, b;
+
+		(void)memcpy(&a, buf + i, sizeof(a));
+		(void)memcpy(&b, ref + i, sizeof(b));
+		bit_errors += stress_vm_count_bits(a ^ b);
+	}
+	for (; i < n; i++)
+		bit_errors += stress_vm_count_bits(buf[i] ^ ref[i]);
+
+	return bit_errors;
+}
+
+/*
+ *  stress_vm_cmp_ref()
+ *	count the bits of buf that differ from ref repeated over it,
+ *	ref_len must be a multiple of VM_VERIFY_BLOCK. Each block is
+ *	XORed against ref and folded with OR without branching, and
+ *	only blocks that differ get popcounted
+ */
+static size_t NOINLINE stress_vm_cmp_ref(
+	const uint8_t *buf,
+	const size_t sz,
+	const uint8_t *ref,
+	const size_t ref_len)
+{
+	size_t off, r = 0, bit_errors = 0;
+
+	for (off = 0; off + VM_VERIFY_BLOCK <= sz; off += VM_VERIFY_BLOCK) {
+		const stress_vm_vec_t *v = (const stress_vm_vec_t *)(buf + off);
+		const stress_vm_vec_t *p = (const stress_vm_vec_t *)(ref + r);
+		const stress_vm_vec_t diff =
+			(v[0] ^ p[0]) | (v[1] ^ p[1]) |
+			(v[2] ^ p[2]) | (v[3] ^ p[3]) |
+			(v[4] ^ p[4]) | (v[5] ^ p[5]) |
+			(v[6] ^ p[6]) | (v[7] ^ p[7]);
+
+		if (diff[0] | diff[1] | diff[2] | diff[3])
+			bit_errors += stress_vm_count_diff(buf + off,
+				ref + r, VM_VERIFY_BLOCK);
+		r += VM_VERIFY_BLOCK;
+		if (r >= ref_len)
+			r = 0;
+	}
+	return bit_errors + stress_vm_count_diff(buf + off, ref + r, sz - off);
+}
+
+/*
+ *  stress_vm_verify()
+ *	verify phase, count the bits of buf that differ from ref
+ *	repeated over it and account for the time taken
+ */
+static size_t stress_vm_verify(
+	const uint8_t *buf,
+	const size_t sz,
+	const uint8_t *ref,
+	const size_t ref_len)
+{
+	const uint64_t t = g_clock ? *g_clock : 0;
+	size_t bit_errors;
+
+	bit_errors = stress_vm_cmp_ref(buf, sz, ref, ref_len);
+	__atomic_fetch_add(&vm_verify_bytes, sz, __ATOMIC_RELAXED);
+	if (g_clock)
+		__atomic_fetch_add(&vm_verify_nsec, *g_clock - t,
+			__ATOMIC_RELAXED);
+
+	return bit_errors;
+}
+
+/*
+ *  stress_vm_verify_pattern()
+ *	verify phase, count the bits of buf that differ from pattern
+ */
+static size_t stress_vm_verify_pattern(
+	const uint8_t *buf,
+	const size_t sz,
+	const uint64_t pattern)
+{
+	uint64_t ref[VM_VERIFY_BLOCK / sizeof(uint64_t)];
+	size_t i;
+
+	for (i = 0; i < VM_VERIFY_BLOCK / sizeof(uint64_t); i++)
+		ref[i] = pattern;
+
+	return stress_vm_verify(buf, sz, (const uint8_t *)ref, sizeof(ref));
+}
+
 /*
  *  stress_vm_moving_inversion()
  *	work sequentially through memory setting 8 bytes at at a time
@@ -251,7 +356,8 @@ abort:
  *  stress_vm_modulo_x()
  *	set every 23rd byte to a random pattern and then set
  *	all the other bytes to the complement of this. Check
- *	that the random patterns are still set.
+ *	that the random patterns and their complements are
+ *	still set.
  */
 static size_t stress_vm_modulo_x(
 	uint8_t *buf,
@@ -261,6 +367,8 @@ static size_t stress_vm_modulo_x(
 {
 	uint32_t i, j;
 	const uint32_t stride = 23;	/* Small prime to hit cache */
+	/* stride whole verify blocks, the buffer repeats with this period */
+	uint8_t ref[23 * VM_VERIFY_BLOCK];
 	uint8_t pattern, compliment;
 	volatile uint8_t *ptr;
 	uint8_t *buf_end = buf + sz;
@@ -298,12 +406,11 @@ static size_t stress_vm_modulo_x(
 		}
 		inject_random_bit_errors(buf, sz);
 
-		for (ptr = buf + i; ptr < buf_end; ptr += stride) {
-			if (*ptr != pattern)
-				bit_errors++;
-			if (!(*g_keep_stressing_flag))
-				return bit_errors;
-		}
+		for (j = 0; j < sizeof(ref); j++)
+			ref[j] = ((j % stride) == i) ? pattern : compliment;
+		bit_errors += stress_vm_verify(buf, sz, ref, sizeof(ref));
+		if (!(*g_keep_stressing_flag))
+			break;
 	}
 
 abort:
@@ -316,7 +423,8 @@ abort:
 /*
  *  stress_vm_walking_one_data()
  *	for each byte, walk through each data line setting them to high
- *	setting each bit to see if none of the lines are stuck
+ *	setting each bit to see if none of the lines are stuck. Each
+ *	pattern is written over a chunk and then verified in one pass
  */
 static size_t stress_vm_walking_one_data(
 	uint8_t *buf,
@@ -324,21 +432,27 @@ static size_t stress_vm_walking_one_data(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	size_t bit_errors = 0;
-	volatile uint8_t *ptr;
-	uint8_t *buf_end = buf + sz;
+	size_t bit_errors = 0, off;
 	uint64_t c = *counter;
 
-	for (ptr = buf; ptr < buf_end; ptr++) {
-		SET_AND_TEST(ptr, 0x01, bit_errors);
-		SET_AND_TEST(ptr, 0x02, bit_errors);
-		SET_AND_TEST(ptr, 0x04, bit_errors);
-		SET_AND_TEST(ptr, 0x08, bit_errors);
-		SET_AND_TEST(ptr, 0x10, bit_errors);
-		SET_AND_TEST(ptr, 0x20, bit_errors);
-		SET_AND_TEST(ptr, 0x40, bit_errors);
-		SET_AND_TEST(ptr, 0x80, bit_errors);
-		c++;
+	for (off = 0; off < sz; ) {
+		size_t len = sz - off;
+		int bit;
+
+		if (len > VM_WALK_CHUNK)
+			len = VM_WALK_CHUNK;
+		if (max_ops && (len > max_ops - c))
+			len = max_ops - c;
+
+		for (bit = 0; bit < 8; bit++) {
+			const uint8_t val = (uint8_t)(1 << bit);
+
+			(void)memset(buf + off, val, len);
+			bit_errors += stress_vm_verify_pattern(buf + off, len,
+				val * 0x0101010101010101ULL);
+		}
+		off += len;
+		c += len;
 		if (max_ops && c >= max_ops)
 			break;
 		if (!(*g_keep_stressing_flag))
@@ -353,7 +467,8 @@ static size_t stress_vm_walking_one_data(
 /*
  *  stress_vm_walking_zero_data()
  *	for each byte, walk through each data line setting them to low
- *	setting each bit to see if none of the lines are stuck
+ *	setting each bit to see if none of the lines are stuck. Each
+ *	pattern is written over a chunk and then verified in one pass
  */
 static size_t stress_vm_walking_zero_data(
 	uint8_t *buf,
@@ -361,21 +476,27 @@ static size_t stress_vm_walking_zero_data(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	size_t bit_errors = 0;
-	volatile uint8_t *ptr;
-	uint8_t *buf_end = buf + sz;
+	size_t bit_errors = 0, off;
 	uint64_t c = *counter;
 
-	for (ptr = buf; ptr < buf_end; ptr++) {
-		SET_AND_TEST(ptr, 0xfe, bit_errors);
-		SET_AND_TEST(ptr, 0xfd, bit_errors);
-		SET_AND_TEST(ptr, 0xfb, bit_errors);
-		SET_AND_TEST(ptr, 0xf7, bit_errors);
-		SET_AND_TEST(ptr, 0xef, bit_errors);
-		SET_AND_TEST(ptr, 0xdf, bit_errors);
-		SET_AND_TEST(ptr, 0xbf, bit_errors);
-		SET_AND_TEST(ptr, 0x7f, bit_errors);
-		c++;
+	for (off = 0; off < sz; ) {
+		size_t len = sz - off;
+		int bit;
+
+		if (len > VM_WALK_CHUNK)
+			len = VM_WALK_CHUNK;
+		if (max_ops && (len > max_ops - c))
+			len = max_ops - c;
+
+		for (bit = 0; bit < 8; bit++) {
+			const uint8_t val = (uint8_t)~(1 << bit);
+
+			(void)memset(buf + off, val, len);
+			bit_errors += stress_vm_verify_pattern(buf + off, len,
+				val * 0x0101010101010101ULL);
+		}
+		off += len;
+		c += len;
 		if (max_ops && c >= max_ops)
 			break;
 		if (!(*g_keep_stressing_flag))
@@ -501,7 +622,7 @@ static size_t stress_vm_gray(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static uint8_t val;
+	static __thread uint8_t val;
 	uint8_t v, *buf_end = buf + sz;
 	volatile uint8_t *ptr;
 	size_t bit_errors = 0;
@@ -545,7 +666,7 @@ static size_t stress_vm_incdec(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static __thread uint8_t val = 0;
 	uint8_t *buf_end = buf + sz;
 	volatile uint8_t *ptr;
 	size_t bit_errors = 0;
@@ -592,7 +713,7 @@ static size_t stress_vm_prime_incdec(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static __thread uint8_t val = 0;
 	uint8_t *buf_end = buf + sz;
 	volatile uint8_t *ptr = buf;
 	size_t bit_errors = 0, i;
@@ -1002,8 +1123,6 @@ static size_t stress_vm_zero_one(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	volatile uint64_t *ptr;
-	uint64_t *buf_end = (uint64_t *)(buf + sz);
 	uint64_t c = *counter;
 	size_t bit_errors = 0;
 
@@ -1014,38 +1133,16 @@ static size_t stress_vm_zero_one(
 	inject_random_bit_errors(buf, sz);
 	c += sz / 8;
 
-	for (ptr = (uint64_t *)buf; ptr < buf_end; ptr += 8) {
-		bit_errors += stress_vm_count_bits(*(ptr + 0));
-		bit_errors += stress_vm_count_bits(*(ptr + 1));
-		bit_errors += stress_vm_count_bits(*(ptr + 2));
-		bit_errors += stress_vm_count_bits(*(ptr + 3));
-		bit_errors += stress_vm_count_bits(*(ptr + 4));
-		bit_errors += stress_vm_count_bits(*(ptr + 5));
-		bit_errors += stress_vm_count_bits(*(ptr + 6));
-		bit_errors += stress_vm_count_bits(*(ptr + 7));
-
-		if (!(*g_keep_stressing_flag))
-			goto abort;
-	}
+	bit_errors += stress_vm_verify_pattern(buf, sz, 0ULL);
+	if (!(*g_keep_stressing_flag))
+		goto abort;
 
 	(void)memset(buf, 0xff, sz);
 	(void)mincore_touch_pages(buf, sz);
 	inject_random_bit_errors(buf, sz);
 	c += sz / 8;
 
-	for (ptr = (uint64_t *)buf; ptr < buf_end; ptr += 8) {
-		bit_errors += stress_vm_count_bits(~*(ptr + 0));
-		bit_errors += stress_vm_count_bits(~*(ptr + 1));
-		bit_errors += stress_vm_count_bits(~*(ptr + 2));
-		bit_errors += stress_vm_count_bits(~*(ptr + 3));
-		bit_errors += stress_vm_count_bits(~*(ptr + 4));
-		bit_errors += stress_vm_count_bits(~*(ptr + 5));
-		bit_errors += stress_vm_count_bits(~*(ptr + 6));
-		bit_errors += stress_vm_count_bits(~*(ptr + 7));
-
-		if (!(*g_keep_stressing_flag))
-			break;
-	}
+	bit_errors += stress_vm_verify_pattern(buf, sz, ~0ULL);
 abort:
 	stress_vm_check("zero-one", bit_errors);
 	*counter = c;
@@ -1065,8 +1162,6 @@ static size_t stress_vm_galpat_zero(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	volatile uint64_t *ptr;
-	uint64_t *buf_end = (uint64_t *)(buf + sz);
 	size_t i, bit_errors = 0, bits_set = 0;
 	size_t bits_bad = sz / 4096;
 	uint64_t c = *counter;
@@ -1092,19 +1187,7 @@ static size_t stress_vm_galpat_zero(
 	(void)mincore_touch_pages(buf, sz);
 	inject_random_bit_errors(buf, sz);
 
-	for (ptr = (uint64_t *)buf; ptr < buf_end; ptr += 8) {
-		bits_set += stress_vm_count_bits(*(ptr + 0));
-		bits_set += stress_vm_count_bits(*(ptr + 1));
-		bits_set += stress_vm_count_bits(*(ptr + 2));
-		bits_set += stress_vm_count_bits(*(ptr + 3));
-		bits_set += stress_vm_count_bits(*(ptr + 4));
-		bits_set += stress_vm_count_bits(*(ptr + 5));
-		bits_set += stress_vm_count_bits(*(ptr + 6));
-		bits_set += stress_vm_count_bits(*(ptr + 7));
-
-		if (!(*g_keep_stressing_flag))
-			break;
-	}
+	bits_set = stress_vm_verify_pattern(buf, sz, 0ULL);
 
 	if (bits_set != bits_bad)
 		bit_errors += UNSIGNED_ABS(bits_set, bits_bad);
@@ -1127,8 +1210,6 @@ static size_t stress_vm_galpat_one(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	volatile uint64_t *ptr;
-	uint64_t *buf_end = (uint64_t *)(buf + sz);
 	size_t i, bit_errors = 0, bits_set = 0;
 	size_t bits_bad = sz / 4096;
 	uint64_t c = *counter;
@@ -1154,18 +1235,7 @@ static size_t stress_vm_galpat_one(
 	(void)mincore_touch_pages(buf, sz);
 	inject_random_bit_errors(buf, sz);
 
-	for (ptr = (uint64_t *)buf; ptr < buf_end; ptr += 8) {
-		bits_set += stress_vm_count_bits(~(*(ptr + 0)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 1)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 2)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 3)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 4)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 5)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 6)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 7)));
-		if (!(*g_keep_stressing_flag))
-			break;
-	}
+	bits_set = stress_vm_verify_pattern(buf, sz, ~0ULL);
 
 	if (bits_set != bits_bad)
 		bit_errors += UNSIGNED_ABS(bits_set, bits_bad);
@@ -1187,7 +1257,7 @@ static size_t stress_vm_inc_nybble(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static __thread uint8_t val = 0;
 	volatile uint8_t *ptr;
 	uint8_t *buf_end = buf + sz;
 	size_t bit_errors = 0;
@@ -1573,7 +1643,7 @@ static size_t stress_vm_write64(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static uint64_t val;
+	static __thread uint64_t val;
 	uint64_t *ptr = (uint64_t *)buf;
 	register uint64_t v = val;
 	register size_t i = 0, n = sz / (sizeof(*ptr) * 32);
@@ -1695,7 +1765,7 @@ static size_t stress_vm_rowhammer(
 {
 	size_t bit_errors = 0;
 	uint32_t *buf32 = (uint32_t *)buf;
-	static uint32_t val = 0xff5a00a5;
+	static __thread uint32_t val = 0xff5a00a5;
 	register size_t j;
 	register volatile uint32_t *addr0, *addr1;
 	register size_t errors = 0;
@@ -1753,6 +1823,125 @@ static size_t stress_vm_rowhammer(
 	return bit_errors;
 }
 
+#define VM_METHODS_MAX		(64)
+
+/* Per method bogo ops and time, indexed as vm_methods[] */
+static uint64_t vm_method_ops[VM_METHODS_MAX];
+static uint64_t vm_method_nsec[VM_METHODS_MAX];
+
+/*
+ *  stress_vm_method()
+ *	run a vm method once and account for it
+ */
+size_t stress_vm_method(
+	const stress_vm_method_info_t *info,
+	uint8_t *buf,
+	const size_t sz,
+	uint64_t *counter,
+	const uint64_t max_ops)
+{
+	const size_t i = info - vm_methods;
+	const uint64_t c = *counter;
+	const uint64_t t = g_clock ? *g_clock : 0;
+	size_t bit_errors;
+
+	bit_errors = info->func(buf, sz, counter, max_ops);
+	if (LIKELY(i < VM_METHODS_MAX)) {
+		/* Atomic, --sgx-vm-threads runs methods concurrently */
+		__atomic_fetch_add(&vm_method_ops[i], *counter - c,
+			__ATOMIC_RELAXED);
+		if (g_clock)
+			__atomic_fetch_add(&vm_method_nsec[i], *g_clock - t,
+				__ATOMIC_RELAXED);
+	}
+	return bit_errors;
+}
+
+/* First touch passes over fresh heap, bucketed by log2 of the pages */
+static uint64_t vm_commit_touches[SGX_VM_COMMIT_SIZES];
+static uint64_t vm_commit_pages[SGX_VM_COMMIT_SIZES];
+static uint64_t vm_commit_nsec[SGX_VM_COMMIT_SIZES];
+
+/*
+ *  stress_vm_first_touch()
+ *	touch every page of a freshly allocated buffer, making the
+ *	kernel commit EPC pages to it, and account for it separately
+ *	from the method that later runs on the buffer
+ */
+void stress_vm_first_touch(uint8_t *buf, const size_t sz, const size_t page_size)
+{
+	const size_t n_pages = sz / page_size;
+	const uint64_t t = g_clock ? *g_clock : 0;
+	size_t i;
+
+	(void)mincore_touch_pages(buf, sz);
+	if (!g_clock || !n_pages)
+		return;
+
+	for (i = 0; (i < SGX_VM_COMMIT_SIZES - 1) && (n_pages >> (i + 1)); i++)
+		;
+	vm_commit_touches[i]++;
+	vm_commit_pages[i] += n_pages;
+	vm_commit_nsec[i] += *g_clock - t;
+}
+
+/*
+ *  stress_vm_verify_stats()
+ *	copy out the verify phase accounting
+ */
+void stress_vm_verify_stats(uint64_t *bytes, uint64_t *nsec)
+{
+	*bytes = __atomic_load_n(&vm_verify_bytes, __ATOMIC_RELAXED);
+	*nsec = __atomic_load_n(&vm_verify_nsec, __ATOMIC_RELAXED);
+}
+
+/*
+ *  stress_vm_commit_stats()
+ *	copy out the first touch accounting
+ */
+void stress_vm_commit_stats(
+	uint64_t *touches,
+	uint64_t *pages,
+	uint64_t *nsec,
+	const int max)
+{
+	int i;
+
+	for (i = 0; (i < max) && (i < SGX_VM_COMMIT_SIZES); i++) {
+		touches[i] = vm_commit_touches[i];
+		pages[i] = vm_commit_pages[i];
+		nsec[i] = vm_commit_nsec[i];
+	}
+}
+
+/*
+ *  stress_vm_method_stats()
+ *	copy out the per method accounting, skipping "all"
+ *	as its time is already accounted to the methods it ran
+ */
+int stress_vm_method_stats(
+	uint64_t *ops,
+	uint64_t *nsec,
+	char *names,
+	const size_t name_len,
+	const int max)
+{
+	const stress_vm_method_info_t *info;
+	int n = 0;
+
+	for (info = vm_methods + 1; info->func && (n < max); info++) {
+		const size_t i = info - vm_methods;
+
+		if ((i >= VM_METHODS_MAX) || !vm_method_ops[i])
+			continue;
+		ops[n] = vm_method_ops[i];
+		nsec[n] = vm_method_nsec[i];
+		(void)snprintf(names + (n * name_len), name_len, "%s", info->name);
+		n++;
+	}
+	return n;
+}
+
 /*
  *  stress_vm_all()
  *	work through all vm stressors sequentially
@@ -1763,10 +1952,10 @@ static size_t stress_vm_all(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static int i = 1;
+	static __thread int i = 1;
 	size_t bit_errors = 0;
 
-	bit_errors = vm_methods[i].func(buf, sz, counter, max_ops);
+	bit_errors = stress_vm_method(&vm_methods[i], buf, sz, counter, max_ops);
 	i++;
 	if (vm_methods[i].func == NULL)
 		i = 1;
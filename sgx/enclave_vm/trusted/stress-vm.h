@@ -26,6 +26,7 @@
 
 bool* g_keep_stressing_flag;
 uint64_t g_opt_flags;
+extern volatile uint64_t *g_clock;	/* untrusted clock, NULL if not timing */
 
 
 /*
@@ -41,5 +42,16 @@ typedef struct {
 
 extern const stress_vm_method_info_t vm_methods[];
 
+extern size_t stress_vm_method(const stress_vm_method_info_t *info,
+		uint8_t *buf, const size_t sz, uint64_t *counter,
+		const uint64_t max_ops);
+extern int stress_vm_method_stats(uint64_t *ops, uint64_t *nsec,
+		char *names, const size_t name_len, const int max);
+extern void stress_vm_first_touch(uint8_t *buf, const size_t sz,
+		const size_t page_size);
+extern void stress_vm_verify_stats(uint64_t *bytes, uint64_t *nsec);
+extern void stress_vm_commit_stats(uint64_t *touches, uint64_t *pages,
+		uint64_t *nsec, const int max);
+
 
 #endif /* ENCLAVE_VM_TRUSTED_STRESS_VM_H_ */
@@ -24,6 +24,8 @@
 
 #define NO_MEM_RETRIES_MAX	(100)
 
+volatile uint64_t *g_clock;
+
 /*
  *  keep_stressing()
  *	returns true if we can keep on running a stressor
@@ -34,6 +36,18 @@ static bool HOT OPTIMIZE3 keep_stressing_vm(const uint64_t rounds,
 			&& LIKELY(!rounds || ((*counter >> VM_BOGO_SHIFT) < rounds)));
 }
 
+/*
+ *  ecall_set_vm_log_ring()
+ *	send pr_dbg, pr_err and pr_fail to an untrusted log ring,
+ *	NULL goes back to one OCALL per message
+ */
+int ecall_set_vm_log_ring(void *ring) {
+	if (ring && !sgx_is_outside_enclave(ring, sizeof(sgx_log_ring_t)))
+		return -1;
+	g_log_ring = (sgx_log_ring_t *)ring;
+	return 0;
+}
+
 int ecall_vm_method_exists(const char* method_name) {
 	stress_vm_method_info_t const *info;
 	for (info = vm_methods; info->func; info++) {
@@ -44,6 +58,13 @@ int ecall_vm_method_exists(const char* method_name) {
 	return 0;
 }
 
+int ecall_get_vm_method_stats(uint64_t *ops, uint64_t *nsec,
+		char *names, size_t names_size, int max) {
+	const size_t name_len = max > 0 ? names_size / max : 0;
+
+	return stress_vm_method_stats(ops, nsec, names, name_len, max);
+}
+
 void ecall_get_vm_methods_error(char* out_methods, int length) {
 	stress_vm_method_info_t const *info;
 	int counter = 0;
@@ -59,31 +80,87 @@ void ecall_get_vm_methods_error(char* out_methods, int length) {
 	}
 }
 
+void ecall_get_vm_verify_stats(uint64_t *bytes, uint64_t *nsec) {
+	stress_vm_verify_stats(bytes, nsec);
+}
+
+int ecall_get_vm_commit_stats(uint64_t *touches, uint64_t *pages,
+		uint64_t *nsec, int max) {
+	stress_vm_commit_stats(touches, pages, nsec, max);
+	return max < SGX_VM_COMMIT_SIZES ? max : SGX_VM_COMMIT_SIZES;
+}
+
+/*
+ *  stress_vm_commit()
+ *	allocate, first touch and free a buffer that doubles in size
+ *	every round up to buf_sz, so that only the cost of getting
+ *	EPC pages committed to fresh heap is measured
+ */
+static int stress_vm_commit(size_t buf_sz, const uint64_t rounds,
+		uint64_t * const counter, size_t page_size) {
+	size_t sz = page_size;
+	int no_mem_retries = 0;
+
+	do {
+		uint8_t *buf;
+
+		if (no_mem_retries >= NO_MEM_RETRIES_MAX) {
+			pr_err("stress-sgx-vm: gave up trying to allocate trusted memory, no available memory\n");
+			break;
+		}
+		buf = (uint8_t *) malloc(sz);
+		if (buf == NULL) {
+			int ret;
+
+			no_mem_retries++;
+			(void) ocall_shim_usleep(&ret, 100000);
+			continue; /* Try again */
+		}
+		no_mem_retries = 0;
+
+		stress_vm_first_touch(buf, sz, page_size);
+		free(buf);
+		*counter += sz / sizeof(uint64_t);
+
+		sz = (sz >= buf_sz) ? page_size : sz << 1;
+		if (sz > buf_sz)
+			sz = buf_sz;
+	} while (keep_stressing_vm(rounds, counter));
+
+	return EXIT_SUCCESS;
+}
+
 int ecall_stress_vm(size_t vm_bytes, const char* method_name,
 		const uint64_t rounds, uint64_t * const counter,
 		bool* keep_stressing_flag, uint64_t opt_flags,
-		uint64_t *bit_error_count, size_t page_size, uint64_t vm_hang) {
+		uint64_t *bit_error_count, size_t page_size, uint64_t vm_hang,
+		uint64_t *clock) {
 	uint8_t *buf = NULL;
 	int no_mem_retries = 0;
 	size_t buf_sz;
-	const bool keep = (g_opt_flags & OPT_FLAGS_SGX_VM_KEEP);
+	const bool keep = (opt_flags & OPT_FLAGS_SGX_VM_KEEP);
 	buf_sz = vm_bytes & ~(page_size - 1);
 	const stress_vm_method_info_t *info = &vm_methods[0];
-	stress_vm_func func;
 
 	g_opt_flags = opt_flags;
 	g_keep_stressing_flag = keep_stressing_flag;
+	g_clock = clock;
+
+	if (g_opt_flags & OPT_FLAGS_SGX_VM_COMMIT)
+		return stress_vm_commit(buf_sz, rounds, counter, page_size);
 
 	for (info = vm_methods; info->func; info++) {
-		if (!strcmp(info->name, method_name)) {
-			func = info->func;
+		if (!strcmp(info->name, method_name))
 			break;
-		}
 	}
+	if (!info->func)
+		return -1;
 
 	do {
+		bool fresh = false;
+
 		if (no_mem_retries >= NO_MEM_RETRIES_MAX) {
-			ocall_pr_err("stress-sgx-vm: gave up trying to allocate trusted memory, no available memory\n");
+			pr_err("stress-sgx-vm: gave up trying to allocate trusted memory, no available memory\n");
 			break;
 		}
 		if (!keep || (buf == NULL)) {
@@ -96,11 +173,16 @@ int ecall_stress_vm(size_t vm_bytes, const char* method_name,
 				(void) ocall_shim_usleep(&ret, 100000);
 				continue; /* Try again */
 			}
+			fresh = true;
 		}
 
 		no_mem_retries = 0;
-		(void) mincore_touch_pages(buf, buf_sz);
-		*bit_error_count += func(buf, buf_sz, counter, rounds << VM_BOGO_SHIFT);
+		if (fresh)
+			stress_vm_first_touch(buf, buf_sz, page_size);
+		else
+			(void) mincore_touch_pages(buf, buf_sz);
+		*bit_error_count += stress_vm_method(info, buf, buf_sz, counter,
+				rounds << VM_BOGO_SHIFT);
 
 		if (vm_hang == 0) {
 			for (;;) {
@@ -117,4 +199,86 @@ int ecall_stress_vm(size_t vm_bytes, const char* method_name,
 
 	if (keep && buf != NULL)
 		free(buf);
+
+	return EXIT_SUCCESS;
+}
+
+/* --sgx-vm-threads buffer, shared by all threads */
+static uint8_t *g_vm_buf;
+static size_t g_vm_buf_sz;
+
+/*
+ *  ecall_vm_threads_alloc()
+ *	allocate and first touch the buffer all threads partition,
+ *	must be called before any thread enters ecall_stress_vm_thread
+ */
+int ecall_vm_threads_alloc(size_t vm_bytes, bool* keep_stressing_flag,
+		uint64_t opt_flags, size_t page_size, uint64_t *clock) {
+	int no_mem_retries;
+
+	g_opt_flags = opt_flags;
+	g_keep_stressing_flag = keep_stressing_flag;
+	g_clock = clock;
+	g_vm_buf_sz = vm_bytes & ~(page_size - 1);
+
+	for (no_mem_retries = 0; no_mem_retries < NO_MEM_RETRIES_MAX; no_mem_retries++) {
+		int ret;
+
+		if (!*g_keep_stressing_flag)
+			return -1;
+		g_vm_buf = (uint8_t *) malloc(g_vm_buf_sz);
+		if (g_vm_buf != NULL) {
+			stress_vm_first_touch(g_vm_buf, g_vm_buf_sz, page_size);
+			return 0;
+		}
+		(void) ocall_shim_usleep(&ret, 100000);
+	}
+	pr_err("stress-sgx-vm: gave up trying to allocate trusted memory, no available memory\n");
+	return -1;
+}
+
+/*
+ *  ecall_vm_threads_free()
+ *	free the shared buffer once all threads have left
+ */
+void ecall_vm_threads_free(void) {
+	free(g_vm_buf);
+	g_vm_buf = NULL;
+}
+
+/*
+ *  ecall_stress_vm_thread()
+ *	run method over this thread's page aligned slice of the
+ *	shared buffer until told to stop, counting the passes made.
+ *	Each pass is also added atomically to the instance's
+ *	shared_counter so the bogo ops stay live while threads run
+ */
+int ecall_stress_vm_thread(const char* method_name, int thread, int threads,
+		const uint64_t rounds, uint64_t * const counter,
+		uint64_t * const shared_counter,
+		uint64_t *bit_error_count, uint64_t *passes, size_t page_size) {
+	const size_t part = (g_vm_buf_sz / threads) & ~(page_size - 1);
+	const stress_vm_method_info_t *info;
+
+	if (!g_vm_buf || !part || (thread < 0) || (thread >= threads))
+		return -1;
+
+	for (info = vm_methods; info->func; info++) {
+		if (!strcmp(info->name, method_name))
+			break;
+	}
+	if (!info->func)
+		return -1;
+
+	do {
+		const uint64_t before = *counter;
+
+		*bit_error_count += stress_vm_method(info, g_vm_buf + (part * thread),
+				part, counter, rounds << VM_BOGO_SHIFT);
+		(*passes)++;
+		(void)__atomic_add_fetch(shared_counter, *counter - before,
+			__ATOMIC_RELAXED);
+	} while (keep_stressing_vm(rounds, counter));
+
+	return EXIT_SUCCESS;
 }
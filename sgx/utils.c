@@ -18,11 +18,15 @@
  */
 #include "utils.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include <assert.h>
 
 #include <unistd.h>
 #include <pwd.h>
+#include <time.h>
+#include <sys/prctl.h>
 
 #define MAX_PATH FILENAME_MAX
 
@@ -198,3 +202,198 @@ int initialize_enclave(sgx_enclave_id_t* eid, char* enclave_file, char* enclave_
     fclose(fp);
     return 0;
 }
+
+/* Time between two updates of the untrusted clock */
+#define SGX_CLOCK_TICK_NSEC	(10000)
+
+static inline uint64_t sgx_clock_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* The clock of this process, what the sleep OCALLs pause */
+static sgx_clock_t *sgx_clock_current;
+
+/* Keep the shared clock up to date until told to stop */
+static void *sgx_clock_ticker(void *arg)
+{
+    sgx_clock_t *clk = (sgx_clock_t *)arg;
+    const struct timespec tick = { 0, SGX_CLOCK_TICK_NSEC };
+
+#if defined(PR_SET_TIMERSLACK)
+    /* The default 50us timer slack would set the resolution, not the tick */
+    (void)prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+#endif
+    while (clk->run) {
+        clk->nsec = sgx_clock_now();
+        if (clk->paused) {
+            /* Nobody reads the clock while the enclave sleeps */
+            (void)pthread_mutex_lock(&clk->lock);
+            while (clk->paused && clk->run)
+                (void)pthread_cond_wait(&clk->cond, &clk->lock);
+            (void)pthread_mutex_unlock(&clk->lock);
+            continue;
+        }
+        (void)nanosleep(&tick, NULL);
+    }
+    return NULL;
+}
+
+/* Start a ticker thread publishing the time to an enclave:
+ *   rdtsc is not allowed in SGX1 enclaves and an OCALL per time
+ *   stamp would dwarf what we want to measure, so the enclave
+ *   just reads clk->nsec through a [user_check] pointer.
+ *   The resolution is the 10us tick plus the host's wakeup
+ *   latency, typically a few more us, and the error averages
+ *   out over many method invocations. The ticker takes some
+ *   CPU time, so it is only started when something reads it
+ *   and it is parked while the enclave sleeps in an OCALL.
+ */
+int sgx_clock_start(sgx_clock_t *clk)
+{
+    clk->nsec = sgx_clock_now();
+    clk->paused = 0;
+    clk->run = true;
+    (void)pthread_mutex_init(&clk->lock, NULL);
+    (void)pthread_cond_init(&clk->cond, NULL);
+    if (pthread_create(&clk->thread, NULL, sgx_clock_ticker, clk) != 0) {
+        clk->run = false;
+        (void)pthread_cond_destroy(&clk->cond);
+        (void)pthread_mutex_destroy(&clk->lock);
+        return -1;
+    }
+    sgx_clock_current = clk;
+    return 0;
+}
+
+/* Stop the ticker thread, if it was started */
+void sgx_clock_stop(sgx_clock_t *clk)
+{
+    if (!clk->run)
+        return;
+    sgx_clock_current = NULL;
+    (void)pthread_mutex_lock(&clk->lock);
+    clk->run = false;
+    (void)pthread_cond_broadcast(&clk->cond);
+    (void)pthread_mutex_unlock(&clk->lock);
+    (void)pthread_join(clk->thread, NULL);
+    (void)pthread_cond_destroy(&clk->cond);
+    (void)pthread_mutex_destroy(&clk->lock);
+}
+
+/* Park the ticker while the calling enclave thread sleeps */
+void sgx_clock_pause(void)
+{
+    sgx_clock_t *clk = sgx_clock_current;
+
+    if (clk)
+        (void)__atomic_add_fetch(&clk->paused, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Bring the clock up to date before going back into the enclave */
+void sgx_clock_resume(void)
+{
+    sgx_clock_t *clk = sgx_clock_current;
+
+    if (!clk)
+        return;
+    (void)pthread_mutex_lock(&clk->lock);
+    clk->nsec = sgx_clock_now();
+    if (__atomic_sub_fetch(&clk->paused, 1, __ATOMIC_SEQ_CST) == 0)
+        (void)pthread_cond_signal(&clk->cond);
+    (void)pthread_mutex_unlock(&clk->lock);
+}
+
+/* pr_*() from log.c, the ring is drained into the usual log */
+extern void pr_dbg(const char *fmt, ...);
+extern void pr_inf(const char *fmt, ...);
+extern void pr_err(const char *fmt, ...);
+extern void pr_fail(const char *fmt, ...);
+
+/* Time between two passes of the log drainer */
+#define SGX_LOG_DRAIN_NSEC	(1000000)
+
+/* Hand every complete record in the ring to pr_*() */
+static void sgx_log_drain(sgx_log_ring_t *ring)
+{
+    for (;;) {
+        const uint64_t tail = ring->tail;
+        sgx_log_rec_t *rec = &ring->rec[tail % SGX_LOG_SLOTS];
+        char msg[SGX_LOG_MSG_LEN];
+        uint32_t level;
+
+        if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+            break;
+        /* Slot reserved but still being written */
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != tail + 1)
+            break;
+
+        level = rec->level;
+        (void)memcpy(msg, rec->msg, sizeof(msg));
+        msg[sizeof(msg) - 1] = '\0';
+        __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+        if (level & SGX_LOG_FAIL)
+            pr_fail("%s", msg);
+        else if (level & SGX_LOG_ERR)
+            pr_err("%s", msg);
+        else
+            pr_dbg("%s", msg);
+    }
+}
+
+static void *sgx_log_drainer(void *arg)
+{
+    sgx_log_t *log = (sgx_log_t *)arg;
+    const struct timespec tick = { 0, SGX_LOG_DRAIN_NSEC };
+
+    while (log->run) {
+        sgx_log_drain(&log->ring);
+        (void)nanosleep(&tick, NULL);
+    }
+    return NULL;
+}
+
+/* Start a log ring and a thread draining it, debug messages are
+ * only sent when they would be printed:
+ *   each OCALL to log a message exits and re-enters the enclave,
+ *   which a flood of bit error reports turns into the bottleneck.
+ *   Enclave threads instead claim a slot with a CAS on head and
+ *   fill it in place; a full ring drops the message and counts it.
+ *   Returns NULL if the ring can't be set up, messages then keep
+ *   going through OCALLs.
+ */
+sgx_log_t *sgx_log_start(const bool debug)
+{
+    sgx_log_t *log = calloc(1, sizeof(*log));
+
+    if (log == NULL)
+        return NULL;
+    log->ring.levels = SGX_LOG_ERR | SGX_LOG_FAIL;
+    if (debug)
+        log->ring.levels |= SGX_LOG_DBG;
+    log->run = true;
+    if (pthread_create(&log->thread, NULL, sgx_log_drainer, log) != 0) {
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+/* Stop the drainer once the enclave is done with the ring,
+ * flush what is left and report any messages that were lost */
+void sgx_log_stop(sgx_log_t *log)
+{
+    if (log == NULL)
+        return;
+    log->run = false;
+    (void)pthread_join(log->thread, NULL);
+    sgx_log_drain(&log->ring);
+    if (log->ring.dropped)
+        pr_inf("%" PRIu64 " enclave log messages dropped, log ring was full\n",
+            (uint64_t)log->ring.dropped);
+    free(log);
+}
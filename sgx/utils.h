@@ -20,6 +20,9 @@
 #define __SGX_UTILS
 
 #include <sgx_urts.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #ifndef TRUE
 # define TRUE 1
@@ -35,10 +38,59 @@
 
 # define TOKEN_CPU_FILENAME   "stress-sgx-cpu.token"
 # define ENCLAVE_CPU_FILENAME "enclave_cpu.signed.so"
+# define TOKEN_LOCK_FILENAME   "stress-sgx-lock.token"
+# define ENCLAVE_LOCK_FILENAME "enclave_lock.signed.so"	/* enclave_cpu with more TCS */
 # define TOKEN_VM_FILENAME   "stress-sgx-vm.token"
 # define ENCLAVE_VM_FILENAME "enclave_vm.signed.so"
+# define TOKEN_VM_THREADS_FILENAME   "stress-sgx-vm-threads.token"
+# define ENCLAVE_VM_THREADS_FILENAME "enclave_vm_threads.signed.so"	/* enclave_vm with more TCS */
+
+/* Log ring shared with the untrusted side, keep in sync with the enclaves' companion.h */
+#define SGX_LOG_SLOTS		(256)
+#define SGX_LOG_MSG_LEN		(240)
+
+#define SGX_LOG_DBG		(0x01)	/* pr_dbg */
+#define SGX_LOG_ERR		(0x02)	/* pr_err */
+#define SGX_LOG_FAIL		(0x04)	/* pr_fail */
+
+typedef struct {
+	volatile uint64_t seq;		/* slot index + 1 once written */
+	uint32_t level;			/* SGX_LOG_* */
+	char msg[SGX_LOG_MSG_LEN];	/* NUL terminated message */
+} sgx_log_rec_t;
+
+typedef struct {
+	volatile uint64_t head;		/* next slot to fill */
+	volatile uint64_t tail;		/* next slot to drain */
+	volatile uint64_t dropped;	/* messages lost to a full ring */
+	uint32_t levels;		/* SGX_LOG_* levels worth sending */
+	sgx_log_rec_t rec[SGX_LOG_SLOTS];
+} sgx_log_ring_t;
+
+/* Untrusted side of the log ring */
+typedef struct {
+	sgx_log_ring_t ring;		/* ring handed to the enclave */
+	volatile bool run;		/* false to stop the drainer */
+	pthread_t thread;		/* drainer thread */
+} sgx_log_t;
+
+/* Untrusted clock the enclaves read instead of the (illegal) rdtsc */
+typedef struct {
+	volatile uint64_t nsec;		/* monotonic time in nanoseconds */
+	volatile bool run;		/* false to stop the ticker */
+	volatile uint32_t paused;	/* threads sleeping in an OCALL */
+	pthread_mutex_t lock;		/* protects paused and run for cond */
+	pthread_cond_t cond;		/* wakes a paused ticker */
+	pthread_t thread;		/* ticker thread */
+} sgx_clock_t;
 
 int initialize_enclave(sgx_enclave_id_t* eid, char* enclave_file, char* enclave_token);
 void print_error_message(sgx_status_t ret);
+int sgx_clock_start(sgx_clock_t *clk);
+void sgx_clock_stop(sgx_clock_t *clk);
+void sgx_clock_pause(void);
+void sgx_clock_resume(void);
+sgx_log_t *sgx_log_start(const bool debug);
+void sgx_log_stop(sgx_log_t *log);
 
 #endif
@@ -182,7 +182,7 @@ int stress_aiol(const args_t *args)
 		struct io_event events[aio_linux_requests];
 		uint8_t *buffers[aio_linux_requests];
 		uint8_t *bufptr = buffer;
-		uint64_t i;
+		uint64_t i, t;
 		long n;
 
 		for (i = 0; i < aio_linux_requests; i++, bufptr += BUFFER_SZ) {
@@ -199,6 +199,7 @@ int stress_aiol(const args_t *args)
 			cb[i].u.c.nbytes = BUFFER_SZ;
 			cbs[i] = &cb[i];
 		}
+		t = stress_lat_start(args);
 		ret = io_submit(ctx, (long)aio_linux_requests, cbs);
 		if (ret < 0) {
 			errno = -ret;
@@ -238,6 +239,7 @@ int stress_aiol(const args_t *args)
 				n -= ret;
 			}
 		} while ((n > 0) && g_keep_stressing_flag);
+		stress_lat_record(args, stress_lat_now(args) - t);
 		inc_counter(args);
 	} while (keep_stressing());
 
@@ -103,8 +103,15 @@ typedef struct {
 
 static const stress_cpu_method_info_t cpu_methods[];
 
-/* Don't make this static to ensure dithering does not get optimised out */
-uint8_t pixels[STRESS_CPU_DITHER_X][STRESS_CPU_DITHER_Y];
+/*
+ *  Scratch buffers of the sieve and dither methods, per thread
+ *  so --threads instances don't share them, allocated by
+ *  stress_cpu(). Don't make pixels static to ensure dithering
+ *  does not get optimised out
+ */
+#define SIEVE_WORDS	((SIEVE_SIZE + 31) / 32)
+static __thread uint32_t *sieve;
+__thread uint8_t (*pixels)[STRESS_CPU_DITHER_Y];
 
 void stress_set_cpu_load(const char *opt) {
 	int32_t cpu_load;
@@ -1476,10 +1483,9 @@ static void HOT OPTIMIZE3 stress_cpu_correlate(const char *name)
 static void HOT OPTIMIZE3 stress_cpu_sieve(const char *name)
 {
 	const uint32_t nsqrt = sqrt(SIEVE_SIZE);
-	static uint32_t sieve[(SIEVE_SIZE + 31) / 32];
 	uint32_t i, j;
 
-	memset(sieve, 0xff, sizeof(sieve));
+	memset(sieve, 0xff, SIEVE_WORDS * sizeof(*sieve));
 	for (i = 2; i < nsqrt; i++)
 		if (STRESS_GETBIT(sieve, i))
 			for (j = i * i; j < SIEVE_SIZE; j += i)
@@ -2053,7 +2059,7 @@ static void stress_cpu_union(const char *name)
 		uint32_t	u32:30;
 	} u_t;
 
-	static u_t u;
+	static __thread u_t u;
 	size_t i;
 
 	(void)name;
@@ -2232,7 +2238,7 @@ static void stress_cpu_stats(const char *name)
  */
 static HOT OPTIMIZE3 void stress_cpu_all(const char *name)
 {
-	static int i = 1;	/* Skip over stress_cpu_all */
+	static __thread int i = 1;	/* Skip over stress_cpu_all */
 
 	cpu_methods[i++].func(name);
 	if (!cpu_methods[i].func)
@@ -2353,10 +2359,10 @@ int stress_set_cpu_method(const char *name)
 }
 
 /*
- *  stress_cpu()
+ *  stress_cpu_run()
  *	stress CPU by doing floating point math ops
  */
-int HOT OPTIMIZE3 stress_cpu(const args_t *args)
+static int HOT OPTIMIZE3 stress_cpu_run(const args_t *args)
 {
 	double bias;
 	const stress_cpu_method_info_t *cpu_method = &cpu_methods[0];
@@ -2453,3 +2459,30 @@ int HOT OPTIMIZE3 stress_cpu(const args_t *args)
 
 	return EXIT_SUCCESS;
 }
+
+/*
+ *  stress_cpu()
+ *	stress CPU with the scratch buffers of this instance
+ */
+int stress_cpu(const args_t *args)
+{
+	int rc;
+
+	sieve = calloc(SIEVE_WORDS, sizeof(*sieve));
+	pixels = calloc(STRESS_CPU_DITHER_X, sizeof(*pixels));
+	if (!sieve || !pixels) {
+		pr_fail_dbg("calloc");
+		free(sieve);
+		free(pixels);
+		sieve = NULL;
+		pixels = NULL;
+		return EXIT_NO_RESOURCE;
+	}
+	rc = stress_cpu_run(args);
+	free(sieve);
+	free(pixels);
+	sieve = NULL;
+	pixels = NULL;
+
+	return rc;
+}
@@ -63,6 +63,7 @@ static int stress_fork_fn(
 	const uint64_t fork_max)
 {
 	pid_t pids[MAX_FORKS];
+	uint64_t t_fork[MAX_FORKS];	/* fork to reap latency start */
 
 	do {
 		unsigned int i;
@@ -70,7 +71,10 @@ static int stress_fork_fn(
 		(void)memset(pids, 0, sizeof(pids));
 
 		for (i = 0; i < fork_max; i++) {
-			pid_t pid = fork_fn();
+			pid_t pid;
+
+			t_fork[i] = stress_lat_now(args);
+			pid = fork_fn();
 
 			if (pid == 0) {
 				/* Child, immediately exit */
@@ -87,6 +91,7 @@ static int stress_fork_fn(
 				int status;
 				/* Parent, wait for child */
 				(void)waitpid(pids[i], &status, 0);
+				stress_lat_record(args, stress_lat_now(args) - t_fork[i]);
 				inc_counter(args);
 			}
 		}
@@ -79,6 +79,8 @@ again:
 			args->name, *timeout);
 	} else {
 		uint64_t threshold = THRESHOLD;
+		uint64_t t_wait = 0;
+		bool waiting = false;
 
 		(void)setpgid(0, g_pgrp);
 		stress_parent_died_alarm();
@@ -92,6 +94,15 @@ again:
 			if (!g_keep_stressing_flag)
 				break;
 
+			/*
+			 *  A bogo op is a wait that gets woken, so with --rate
+			 *  only take the next slot once the last one was woken,
+			 *  timed out polls in between are part of its latency
+			 */
+			if (!waiting) {
+				t_wait = stress_lat_start(args);
+				waiting = true;
+			}
 			ret = shim_futex_wait(futex, 0, &t);
 
 			/* timeout, re-do, stress on stupid fast polling */
@@ -109,7 +120,9 @@ again:
 				if ((ret < 0) && (g_opt_flags & OPT_FLAGS_VERIFY)) {
 					pr_fail_err("futex wait");
 				}
+				stress_lat_record(args, stress_lat_now(args) - t_wait);
 				inc_counter(args);
+				waiting = false;
 			}
 		} while (keep_stressing());
 	}
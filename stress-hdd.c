@@ -434,7 +434,7 @@ int stress_hdd(const args_t *args)
 	do {
 		int fd;
 		struct stat statbuf;
-		uint64_t hdd_read_size;
+		uint64_t hdd_read_size, t;
 
 		/*
 		 * aggressive option with no other option enables
@@ -484,6 +484,7 @@ int stress_hdd(const args_t *args)
 					(void)close(fd);
 					goto finish;
 				}
+				t = stress_lat_start(args);
 rnd_wr_retry:
 				if (!keep_stressing())
 					break;
@@ -505,6 +506,7 @@ rnd_wr_retry:
 					}
 					continue;
 				}
+				stress_lat_record(args, stress_lat_now(args) - t);
 				inc_counter(args);
 			}
 		}
@@ -512,6 +514,7 @@ rnd_wr_retry:
 		if (hdd_flags & HDD_OPT_WR_SEQ) {
 			for (i = 0; i < hdd_bytes; i += hdd_write_size) {
 				size_t j;
+				t = stress_lat_start(args);
 seq_wr_retry:
 				if (!keep_stressing())
 					break;
@@ -532,6 +535,7 @@ seq_wr_retry:
 					}
 					continue;
 				}
+				stress_lat_record(args, stress_lat_now(args) - t);
 				inc_counter(args);
 			}
 		}
@@ -556,6 +560,7 @@ seq_wr_retry:
 				goto finish;
 			}
 			for (i = 0; i < hdd_read_size; i += hdd_write_size) {
+				t = stress_lat_start(args);
 seq_rd_retry:
 				if (!keep_stressing())
 					break;
@@ -591,6 +596,7 @@ seq_rd_retry:
 						}
 					}
 				}
+				stress_lat_record(args, stress_lat_now(args) - t);
 				inc_counter(args);
 			}
 			if (misreads)
@@ -615,6 +621,7 @@ seq_rd_retry:
 					(void)close(fd);
 					goto finish;
 				}
+				t = stress_lat_start(args);
 rnd_rd_retry:
 				if (!keep_stressing())
 					break;
@@ -649,6 +656,7 @@ rnd_rd_retry:
 						}
 					}
 				}
+				stress_lat_record(args, stress_lat_now(args) - t);
 				inc_counter(args);
 			}
 			if (misreads)
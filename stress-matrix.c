@@ -709,7 +709,7 @@ static void OPTIMIZE3 stress_matrix_xy_all(
 	matrix_type_t b[RESTRICT n][n],
 	matrix_type_t r[RESTRICT n][n])
 {
-	static int i = 1;	/* Skip over stress_matrix_all */
+	static __thread int i = 1;	/* Skip over stress_matrix_all */
 
 	matrix_methods[i++].func[0](n, a, b, r);
 	if (!matrix_methods[i].name)
@@ -726,7 +726,7 @@ static void OPTIMIZE3 stress_matrix_yx_all(
 	matrix_type_t b[RESTRICT n][n],
 	matrix_type_t r[RESTRICT n][n])
 {
-	static int i = 1;	/* Skip over stress_matrix_all */
+	static __thread int i = 1;	/* Skip over stress_matrix_all */
 
 	matrix_methods[i++].func[1](n, a, b, r);
 	if (!matrix_methods[i].name)
@@ -115,6 +115,7 @@ static void stress_mmap_child(
 		size_t n;
 		const int rnd = mwc32() % SIZEOF_ARRAY(mmap_flags);
 		const int rnd_flag = mmap_flags[rnd];
+		const uint64_t t = stress_lat_now(args);
 		uint8_t *buf = NULL;
 
 		if (no_mem_retries >= NO_MEM_RETRIES_MAX) {
@@ -232,6 +233,7 @@ cleanup:
 				(void)munmap((void *)mappings[n], page_size);
 			}
 		}
+		stress_lat_record(args, stress_lat_now(args) - t);
 		inc_counter(args);
 	} while (keep_stressing());
 }
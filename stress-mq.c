@@ -194,6 +194,7 @@ again:
 		do {
 			int ret;
 			const uint64_t timed = (i & 1);
+			uint64_t t;
 
 			(void)memset(&msg, 0, sizeof(msg));
 			msg.value = (*args->counter);
@@ -206,6 +207,7 @@ again:
 			/*
 			 * toggle between timedsend and send
 			 */
+			t = stress_lat_now(args);
 			if (do_timed && (timed))
 				ret = mq_timedsend(mq, (char *)&msg, sizeof(msg), 1, &abs_timeout);
 			else
@@ -216,6 +218,7 @@ again:
 					pr_fail_dbg(timed ? "mq_timedsend" : "mq_send");
 				break;
 			}
+			stress_lat_record(args, stress_lat_now(args) - t);
 			i++;
 			inc_counter(args);
 		} while (keep_stressing());
@@ -68,6 +68,8 @@ proc_info_t *proc_current;
 
 /* Various option settings and flags */
 static volatile bool wait_flag = true;		/* false = exit run wait loop */
+static double startup_secs;			/* time until all instances ran */
+static uint32_t startup_procs;			/* stressor processes forked */
 
 /* Globals */
 int32_t g_opt_sequential = DEFAULT_SEQUENTIAL;	/* # of sequential stressors */
@@ -100,6 +102,9 @@ static const unsupported_t unsupported[] = {
 	{ STRESS_RAWDEV,	stress_rawdev_supported },
 	{ STRESS_RDRAND,	stress_rdrand_supported },
 	{ STRESS_SGX,		stress_sgx_supported },
+	{ STRESS_SGX_EXCEPTION,	stress_sgx_supported },
+	{ STRESS_SGX_LOCK,	stress_sgx_supported },
+	{ STRESS_SGX_SYSCALL,	stress_sgx_supported },
 	{ STRESS_SGX_VM,		stress_sgx_supported },
 	{ STRESS_SOFTLOCKUP,	stress_softlockup_supported },
 	{ STRESS_SWAP,		stress_swap_supported },
@@ -349,6 +354,9 @@ static const stress_t stressors[] = {
 	STRESSOR(sem_sysv, SEMAPHORE_SYSV, CLASS_OS | CLASS_SCHEDULER),
 	STRESSOR(sendfile, SENDFILE, CLASS_PIPE_IO | CLASS_OS),
 	STRESSOR(sgx, SGX, CLASS_CPU | CLASS_MEMORY),
+	STRESSOR(sgx_exception, SGX_EXCEPTION, CLASS_INTERRUPT | CLASS_OS),
+	STRESSOR(sgx_lock, SGX_LOCK, CLASS_CPU | CLASS_SCHEDULER),
+	STRESSOR(sgx_syscall, SGX_SYSCALL, CLASS_IO | CLASS_OS),
 	STRESSOR(sgx_vm, SGX_VM, CLASS_MEMORY),
 	STRESSOR(shm, SHM_POSIX, CLASS_VM | CLASS_OS),
 	STRESSOR(shm_sysv, SHM_SYSV, CLASS_VM | CLASS_OS),
@@ -445,6 +453,7 @@ static const struct option long_options[] = {
 	{ "atomic",	1,	0,	OPT_ATOMIC },
 	{ "atomic-ops",	1,	0,	OPT_ATOMIC_OPS },
 	{ "backoff",	1,	0,	OPT_BACKOFF },
+	{ "baseline",	1,	0,	OPT_BASELINE },
 	{ "bigheap",	1,	0,	OPT_BIGHEAP },
 	{ "bigheap-ops",1,	0,	OPT_BIGHEAP_OPS },
 	{ "bigheap-growth",1,	0,	OPT_BIGHEAP_GROWTH },
@@ -483,6 +492,8 @@ static const struct option long_options[] = {
 	{ "clone",	1,	0,	OPT_CLONE },
 	{ "clone-ops",	1,	0,	OPT_CLONE_OPS },
 	{ "clone-max",	1,	0,	OPT_CLONE_MAX },
+	{ "compare",	1,	0,	OPT_COMPARE },
+	{ "compare-threshold",1,	0,	OPT_COMPARE_THRESHOLD },
 	{ "context",	1,	0,	OPT_CONTEXT },
 	{ "context-ops",1,	0,	OPT_CONTEXT_OPS },
 	{ "copy-file",	1,	0,	OPT_COPY_FILE },
@@ -530,6 +541,7 @@ static const struct option long_options[] = {
 	{ "dnotify-ops",1,	0,	OPT_DNOTIFY_OPS },
 	{ "dup",	1,	0,	OPT_DUP },
 	{ "dup-ops",	1,	0,	OPT_DUP_OPS },
+	{ "energy",	0,	0,	OPT_ENERGY },
 	{ "epoll",	1,	0,	OPT_EPOLL },
 	{ "epoll-ops",	1,	0,	OPT_EPOLL_OPS },
 	{ "epoll-port",	1,	0,	OPT_EPOLL_PORT },
@@ -565,6 +577,7 @@ static const struct option long_options[] = {
 	{ "fork-max",	1,	0,	OPT_FORK_MAX },
 	{ "fp-error",	1,	0,	OPT_FP_ERROR},
 	{ "fp-error-ops",1,	0,	OPT_FP_ERROR_OPS },
+	{ "freq",	0,	0,	OPT_FREQ },
 	{ "fstat",	1,	0,	OPT_FSTAT },
 	{ "fstat-ops",	1,	0,	OPT_FSTAT_OPS },
 	{ "fstat-dir",	1,	0,	OPT_FSTAT_DIR },
@@ -631,6 +644,7 @@ static const struct option long_options[] = {
 	{ "kill-ops",	1,	0,	OPT_KILL_OPS },
 	{ "klog",	1,	0,	OPT_KLOG },
 	{ "klog-ops",	1,	0,	OPT_KLOG_OPS },
+	{ "latency",	0,	0,	OPT_LATENCY },
 	{ "lease",	1,	0,	OPT_LEASE },
 	{ "lease-ops",	1,	0,	OPT_LEASE_OPS },
 	{ "lease-breakers",1,	0,	OPT_LEASE_BREAKERS },
@@ -742,6 +756,9 @@ static const struct option long_options[] = {
 	{ "parallel",	1,	0,	OPT_ALL },
 	{ "pathological",0,	0,	OPT_PATHOLOGICAL },
 	{ "perf",	0,	0,	OPT_PERF_STATS },
+	{ "perf-sample",1,	0,	OPT_PERF_SAMPLE },
+	{ "perf-sample-callchain",0,0,	OPT_PERF_SAMPLE_CALLCHAIN },
+	{ "perf-sample-top",1,	0,	OPT_PERF_SAMPLE_TOP },
 	{ "personality",1,	0,	OPT_PERSONALITY },
 	{ "personality-ops",1,	0,	OPT_PERSONALITY_OPS },
 	{ "physpage",	1,	0,	OPT_PHYSPAGE },
@@ -752,6 +769,7 @@ static const struct option long_options[] = {
 #if defined(F_SETPIPE_SZ)
 	{ "pipe-size",	1,	0,	OPT_PIPE_SIZE },
 #endif
+	{ "placement",	1,	0,	OPT_PLACEMENT },
 	{ "poll",	1,	0,	OPT_POLL },
 	{ "poll-ops",	1,	0,	OPT_POLL_OPS },
 	{ "procfs",	1,	0,	OPT_PROCFS },
@@ -777,6 +795,8 @@ static const struct option long_options[] = {
 	{ "rawdev-ops",1,	0,	OPT_RAWDEV_OPS },
 	{ "rawdev-method",1,	0,	OPT_RAWDEV_METHOD },
 	{ "random",	1,	0,	OPT_RANDOM },
+	{ "rate",	1,	0,	OPT_RATE },
+	{ "rate-profile",1,	0,	OPT_RATE_PROFILE },
 	{ "rdrand",	1,	0,	OPT_RDRAND },
 	{ "rdrand-ops",	1,	0,	OPT_RDRAND_OPS },
 	{ "readahead",	1,	0,	OPT_READAHEAD },
@@ -786,6 +806,7 @@ static const struct option long_options[] = {
 	{ "remap-ops",	1,	0,	OPT_REMAP_FILE_PAGES_OPS },
 	{ "rename",	1,	0,	OPT_RENAME },
 	{ "rename-ops",	1,	0,	OPT_RENAME_OPS },
+	{ "repeat",	1,	0,	OPT_REPEAT },
 	{ "resources",	1,	0,	OPT_RESOURCES },
 	{ "resources-ops",1,	0,	OPT_RESOURCES_OPS },
 	{ "rlimit",	1,	0,	OPT_RLIMIT },
@@ -794,6 +815,10 @@ static const struct option long_options[] = {
 	{ "rmap-ops",	1,	0,	OPT_RMAP_OPS },
 	{ "rtc",	1,	0,	OPT_RTC },
 	{ "rtc-ops",	1,	0,	OPT_RTC_OPS },
+	{ "sample-interval",1,	0,	OPT_SAMPLE_INTERVAL },
+	{ "sample-file",1,	0,	OPT_SAMPLE_FILE },
+	{ "sample-instances",0,	0,	OPT_SAMPLE_INSTANCES },
+	{ "scale-sweep",1,	0,	OPT_SCALE_SWEEP },
 	{ "sched",	1,	0,	OPT_SCHED },
 	{ "sched-prio",	1,	0,	OPT_SCHED_PRIO },
 	{ "schedpolicy",1,	0,	OPT_SCHEDPOLICY },
@@ -823,12 +848,28 @@ static const struct option long_options[] = {
 	{ "sgx",	1,	0,	OPT_SGX },
 	{ "sgx-ops",	1,	0,	OPT_SGX_OPS },
 	{ "sgx-method",	1,	0,	OPT_SGX_METHOD },
+	{ "sgx-ops-per-ecall",1,	0,	OPT_SGX_OPS_PER_ECALL },
+	{ "sgx-load",	1,	0,	OPT_SGX_LOAD },
+	{ "sgx-load-slice",1,	0,	OPT_SGX_LOAD_SLICE },
+	{ "sgx-exception",	1,	0,	OPT_SGX_EXCEPTION },
+	{ "sgx-exception-ops",1,	0,	OPT_SGX_EXCEPTION_OPS },
+	{ "sgx-exception-method",1,	0,	OPT_SGX_EXCEPTION_METHOD },
+	{ "sgx-lock",		1,	0,	OPT_SGX_LOCK },
+	{ "sgx-lock-ops",	1,	0,	OPT_SGX_LOCK_OPS },
+	{ "sgx-lock-method",1,	0,	OPT_SGX_LOCK_METHOD },
+	{ "sgx-lock-threads",1,	0,	OPT_SGX_LOCK_THREADS },
+	{ "sgx-syscall",	1,	0,	OPT_SGX_SYSCALL },
+	{ "sgx-syscall-ops",1,	0,	OPT_SGX_SYSCALL_OPS },
+	{ "sgx-syscall-bytes",1,	0,	OPT_SGX_SYSCALL_BYTES },
+	{ "sgx-syscall-mix",1,	0,	OPT_SGX_SYSCALL_MIX },
 	{ "sgx-vm",		1,	0,	OPT_SGX_VM },
 	{ "sgx-vm-bytes",	1,	0,	OPT_SGX_VM_BYTES },
+	{ "sgx-vm-commit",	0,	0,	OPT_SGX_VM_COMMIT },
 	{ "sgx-vm-hang",	1,	0,	OPT_SGX_VM_HANG },
 	{ "sgx-vm-keep",	0,	0,	OPT_SGX_VM_KEEP },
 	{ "sgx-vm-ops",	1,	0,	OPT_SGX_VM_OPS },
 	{ "sgx-vm-method",	1,	0,	OPT_SGX_VM_METHOD },
+	{ "sgx-vm-threads",	1,	0,	OPT_SGX_VM_THREADS },
 	{ "shm",	1,	0,	OPT_SHM_POSIX },
 	{ "shm-ops",	1,	0,	OPT_SHM_POSIX_OPS },
 	{ "shm-bytes",	1,	0,	OPT_SHM_POSIX_BYTES },
@@ -895,6 +936,7 @@ static const struct option long_options[] = {
 	{ "sync-file",	1,	0,	OPT_SYNC_FILE },
 	{ "sync-file-ops", 1,	0,	OPT_SYNC_FILE_OPS },
 	{ "sync-file-bytes", 1,	0,	OPT_SYNC_FILE_BYTES },
+	{ "sync-start",	0,	0,	OPT_SYNC_START },
 	{ "sysfs",	1,	0,	OPT_SYSFS },
 	{ "sysfs-ops",1,	0,	OPT_SYSFS_OPS },
 	{ "sysinfo",	1,	0,	OPT_SYSINFO },
@@ -928,6 +970,7 @@ static const struct option long_options[] = {
 	{ "tsearch-ops",1,	0,	OPT_TSEARCH_OPS },
 	{ "tsearch-size",1,	0,	OPT_TSEARCH_SIZE },
 	{ "thrash",	0,	0,	OPT_THRASH },
+	{ "threads",	0,	0,	OPT_THREADS },
 	{ "times",	0,	0,	OPT_TIMES },
 	{ "tz",		0,	0,	OPT_THERMAL_ZONES },
 	{ "udp",	1,	0,	OPT_UDP },
@@ -946,6 +989,7 @@ static const struct option long_options[] = {
 	{ "utime-fsync",0,	0,	OPT_UTIME_FSYNC },
 	{ "unshare",	1,	0,	OPT_UNSHARE },
 	{ "unshare-ops",1,	0,	OPT_UNSHARE_OPS },
+	{ "until-ci",	1,	0,	OPT_UNTIL_CI },
 	{ "urandom",	1,	0,	OPT_URANDOM },
 	{ "urandom-ops",1,	0,	OPT_URANDOM_OPS },
 	{ "vecmath",	1,	0,	OPT_VECMATH },
@@ -979,6 +1023,7 @@ static const struct option long_options[] = {
 	{ "vm-splice-ops",1,	0,	OPT_VM_SPLICE_OPS },
 	{ "wait",	1,	0,	OPT_WAIT },
 	{ "wait-ops",	1,	0,	OPT_WAIT_OPS },
+	{ "warmup",	1,	0,	OPT_WARMUP },
 	{ "wcs",	1,	0,	OPT_WCS},
 	{ "wcs-ops",	1,	0,	OPT_WCS_OPS },
 	{ "wcs-method",	1,	0,	OPT_WCS_METHOD },
@@ -1006,14 +1051,20 @@ static const help_t help_generic[] = {
 	{ NULL,		"aggressive",		"enable all aggressive options" },
 	{ "a N",	"all N",		"start N workers of each stress test" },
 	{ "b N",	"backoff N",		"wait of N microseconds before work starts" },
+	{ NULL,		"baseline F",		"save the run metrics to F for later --compare" },
 	{ NULL,		"class name",		"specify a class of stressors, use with --sequential" },
+	{ NULL,		"compare F",		"compare the run metrics with baseline F" },
+	{ NULL,		"compare-threshold P",	"flag changes of more than P percent" },
 	{ "n",		"dry-run",		"do not run" },
+	{ NULL,		"energy",		"report RAPL energy and bogo ops per joule" },
+	{ NULL,		"freq",			"report CPU frequency, throttling and bogo ops per GHz-second" },
 	{ "h",		"help",			"show help" },
 	{ NULL,		"ignite-cpu",		"alter kernel controls to make CPU run hot" },
 	{ NULL,		"ionice-class C",	"specify ionice class (idle, besteffort, realtime)" },
 	{ NULL,		"ionice-level L",	"specify ionice level (0 max, 7 min)" },
 	{ "j",		"job jobfile",		"run the named jobfile" },
 	{ "k",		"keep-name",		"keep stress worker names to be 'stress-ng'" },
+	{ NULL,		"latency",		"record bogo op latencies, reported with --metrics" },
 	{ NULL,		"log-brief",		"less verbose log messages" },
 	{ NULL,		"log-file filename",	"log messages to a log file" },
 	{ NULL,		"maximize",		"enable maximum stress options" },
@@ -1027,26 +1078,41 @@ static const help_t help_generic[] = {
 	{ NULL,		"pathological",		"enable stressors that are known to hang a machine" },
 #if defined(STRESS_PERF_STATS)
 	{ NULL,		"perf",			"display perf statistics" },
+	{ NULL,		"perf-sample HZ",	"sample stressors HZ times a second and show hot spots" },
+	{ NULL,		"perf-sample-callchain","also sample call chains for total percentages" },
+	{ NULL,		"perf-sample-top N",	"show the N hottest functions of each stressor" },
 #endif
+	{ NULL,		"placement P",		"pin instances by CPU topology policy P" },
 	{ "q",		"quiet",		"quiet output" },
 	{ "r",		"random N",		"start N random workers" },
+	{ NULL,		"rate R",		"issue R bogo ops/s per stressor, open loop" },
+	{ NULL,		"rate-profile P",	"vary --rate by profile P, constant, poisson, step or sine" },
+	{ NULL,		"repeat N",		"run the stressors N times, report mean and 95% CI" },
+	{ NULL,		"sample-interval T",	"sample ops/s of each stressor every T seconds" },
+	{ NULL,		"sample-file F",	"write the ops/s samples to CSV file F" },
+	{ NULL,		"sample-instances",	"also sample ops/s of each instance" },
+	{ NULL,		"scale-sweep L",	"run each stressor with each instance count in list L" },
 	{ NULL,		"sched type",		"set scheduler type" },
 	{ NULL,		"sched-prio N",		"set scheduler priority level N" },
 	{ NULL,		"sequential N",		"run all stressors one by one, invoking N of them" },
 	{ NULL,		"stressors",		"show available stress tests" },
+	{ NULL,		"sync-start",		"start all stressor instances together" },
 	{ NULL,		"syslog",		"log messages to the syslog" },
 	{ NULL,		"taskset",		"use specific CPUs (set CPU affinity)" },
 	{ NULL,		"temp-path",		"specify path for temporary directories and files" },
 	{ NULL,		"thrash",		"force all pages in causing swap thrashing" },
+	{ NULL,		"threads",		"run thread safe stressors as threads of one process" },
 	{ "t N",	"timeout T",		"timeout after T seconds" },
 	{ NULL,		"timer-slack",		"enable timer slack mode" },
 	{ NULL,		"times",		"show run time summary at end of the run" },
 #if defined(STRESS_THERMAL_ZONES)
 	{ NULL,		"tz",			"collect temperatures from thermal zones (Linux only)" },
 #endif
+	{ NULL,		"until-ci P",		"repeat runs until the 95% CI is within P% of the mean" },
 	{ "v",		"verbose",		"verbose output" },
 	{ NULL,		"verify",		"verify results (not available on all tests)" },
 	{ "V",		"version",		"show version" },
+	{ NULL,		"warmup T",		"leave the first T seconds of each run out of the stats" },
 	{ "Y",		"yaml",			"output results to YAML formatted filed" },
 	{ "x",		"exclude",		"list of stressors to exclude (not run)" },
 	{ NULL,		NULL,			NULL }
@@ -1412,12 +1478,28 @@ static const help_t help_stressors[] = {
 	{ NULL,		"sgx N",			"start N SGX enclaves" },
 	{ NULL,		"sgx-ops N",		"stop after N sgx cpu bogo operations" },
 	{ NULL,		"sgx-method M",		"specify stress sgx method M, default is all" },
+	{ NULL,		"sgx-ops-per-ecall N",	"leave and re-enter the enclave every N bogo ops" },
+	{ NULL,		"sgx-load P",		"load CPU by P %% inside the enclave" },
+	{ NULL,		"sgx-load-slice S",	"specify time slice during busy enclave load" },
+	{ NULL,		"sgx-exception N",	"start N SGX enclaves raising handled exceptions" },
+	{ NULL,		"sgx-exception-ops N",	"stop after N sgx-exception bogo operations" },
+	{ NULL,		"sgx-exception-method M","specify exception M: all, div0 or ud2" },
+	{ NULL,		"sgx-lock N",		"start N SGX enclaves contending on trusted locks" },
+	{ NULL,		"sgx-lock-ops N",	"stop after N sgx-lock bogo operations" },
+	{ NULL,		"sgx-lock-method M",	"specify lock M: all, mutex, spin, atomic or condvar" },
+	{ NULL,		"sgx-lock-threads N",	"use N enclave threads per sgx-lock instance (default 4)" },
+	{ NULL,		"sgx-syscall N",		"start N SGX enclaves doing file I/O through OCALLs" },
+	{ NULL,		"sgx-syscall-ops N",	"stop after N sgx-syscall bogo operations" },
+	{ NULL,		"sgx-syscall-bytes N",	"read and write N bytes per system call (default 4K)" },
+	{ NULL,		"sgx-syscall-mix M",	"specify I/O mix M: rdwr, read, write or stat" },
 	{ NULL,		"sgx-vm N",			"start N SGX enclaves spinning on trusted memory" },
 	{ NULL,		"sgx-vm-bytes N",		"allocate N bytes per vm worker (default 32MB)" },
+	{ NULL,		"sgx-vm-commit",		"only time EPC page commits of a growing buffer" },
 	{ NULL,		"sgx-vm-hang N",		"sleep N seconds before freeing memory" },
 	{ NULL,		"sgx-vm-keep",		"redirty memory instead of reallocating" },
 	{ NULL,		"sgx-vm-ops N",		"stop after N vm bogo operations" },
 	{ NULL,		"sgx-vm-method M",		"specify stress vm method M, default is all" },
+	{ NULL,		"sgx-vm-threads N",	"partition one buffer across N enclave threads" },
 	{ NULL,		"shm N",		"start N workers that exercise POSIX shared memory" },
 	{ NULL,		"shm-ops N",		"stop after N POSIX shared memory bogo operations" },
 	{ NULL,		"shm-bytes N",		"allocate/free N bytes of POSIX shared memory" },
@@ -2170,6 +2252,245 @@ static uint32_t get_total_num_procs(proc_info_t *procs_list)
 	return total_num_procs;
 }
 
+/*
+ *  stress_thread_safe()
+ *	stressors that keep no process wide state, handle no
+ *	signals and don't exit, so --threads can run all their
+ *	instances as threads of a single process
+ */
+static inline bool stress_thread_safe(const stress_id_t id)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	return (id == STRESS_BSEARCH) ||
+	       (id == STRESS_CPU) ||
+	       (id == STRESS_FUNCCALL) ||
+	       (id == STRESS_GETRANDOM) ||
+	       (id == STRESS_LSEARCH) ||
+	       (id == STRESS_MATRIX) ||
+	       (id == STRESS_NOP) ||
+	       (id == STRESS_NULL) ||
+	       (id == STRESS_STR) ||
+	       (id == STRESS_TSEARCH) ||
+	       (id == STRESS_URANDOM) ||
+	       (id == STRESS_VECMATH) ||
+	       (id == STRESS_WCS) ||
+	       (id == STRESS_ZERO);
+#else
+	(void)id;
+
+	return false;
+#endif
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+typedef struct {
+	const proc_info_t *pi;		/* stressor being run */
+	const char *name;		/* process name */
+	int32_t instance;		/* instance run by this thread */
+	int rc;				/* stressor return */
+} stress_thread_t;
+
+/*
+ *  stress_run_thread()
+ *	run one instance of a stressor in a thread
+ */
+static void *stress_run_thread(void *arg)
+{
+	stress_thread_t *t = (stress_thread_t *)arg;
+	proc_stats_t *stats = t->pi->stats[t->instance];
+	const args_t args = {
+		.counter = &stats->counter,
+		.lat = (g_opt_flags & OPT_FLAGS_LATENCY) ? &stats->lat : NULL,
+		.rate = (g_opt_flags & OPT_FLAGS_RATE) ? &stats->rate : NULL,
+		.name = t->name,
+		.max_ops = t->pi->bogo_ops,
+		.instance = t->instance,
+		.num_instances = t->pi->num_procs,
+		.pid = getpid(),
+		.ppid = getppid(),
+		.page_size = stress_get_pagesize(),
+	};
+
+	placement_set((uint32_t)t->instance, stats->placement,
+		sizeof(stats->placement));
+	mwc_reseed();
+	stats->start = stats->finish = time_now();
+	t->rc = t->pi->stressor->stress_func(&args);
+	stats->finish = time_now();
+	stats->run_ok = (t->rc == EXIT_SUCCESS);
+
+	return NULL;
+}
+
+/*
+ *  stress_run_threads()
+ *	--threads, run all instances of a stressor as threads
+ *	of this process, returns the first failing exit status
+ */
+static int stress_run_threads(const proc_info_t *pi, const char *name)
+{
+	stress_thread_t *threads;
+	pthread_t *pthreads;
+	int32_t i, created;
+	int rc = EXIT_SUCCESS;
+
+	threads = calloc((size_t)pi->num_procs, sizeof(*threads));
+	pthreads = calloc((size_t)pi->num_procs, sizeof(*pthreads));
+	if (!threads || !pthreads) {
+		pr_err("%s: cannot allocate %" PRId32 " threads\n",
+			name, pi->num_procs);
+		free(pthreads);
+		free(threads);
+		return EXIT_NO_RESOURCE;
+	}
+
+	for (created = 0; created < pi->num_procs; created++) {
+		stress_thread_t *t = &threads[created];
+		int ret;
+
+		t->pi = pi;
+		t->name = name;
+		t->instance = created;
+		t->rc = EXIT_SUCCESS;
+		ret = pthread_create(&pthreads[created], NULL, stress_run_thread, t);
+		if (ret) {
+			pr_err("%s: pthread_create failed, errno=%d (%s)\n",
+				name, ret, strerror(ret));
+			rc = EXIT_NO_RESOURCE;
+			break;
+		}
+	}
+	for (i = 0; i < created; i++) {
+		(void)pthread_join(pthreads[i], NULL);
+		if ((rc == EXIT_SUCCESS) && (threads[i].rc != EXIT_SUCCESS))
+			rc = threads[i].rc;
+	}
+
+	free(pthreads);
+	free(threads);
+	return rc;
+}
+#endif
+
+/*
+ *  stress_start_ready()
+ *	mark an instance as being at the start barrier, an
+ *	instance is only ever counted once however often it
+ *	gets here
+ */
+static void stress_start_ready(proc_stats_t *stats)
+{
+	(void)__sync_bool_compare_and_swap(&stats->ready, 0, 1);
+}
+
+/*
+ *  stress_start_wait()
+ *	mark an instance as ready and block until the parent
+ *	releases all instances at once
+ */
+static void stress_start_wait(proc_stats_t *stats)
+{
+	stress_start_ready(stats);
+	while (!g_shared->sync_start.futex && g_keep_stressing_flag) {
+		if ((shim_futex_wait(&g_shared->sync_start.futex, 0, NULL) < 0) &&
+		    (errno != EAGAIN) && (errno != EINTR))
+			(void)shim_sched_yield();
+	}
+}
+
+/*
+ *  stress_sgx_ready()
+ *	called by an SGX stressor once its enclave is created, waits
+ *	at the start barrier until every SGX instance of the run
+ *	(every instance with --sync-start) is ready, then restarts
+ *	the instance's wall clock so enclave loading is not measured
+ */
+void stress_sgx_ready(const args_t *args)
+{
+	proc_stats_t *stats = proc_current->stats[args->instance];
+
+	/* Already released, an sgx-vm child restarted after an OOM kill */
+	if (stats->ready)
+		return;
+
+	stress_start_wait(stats);
+	if ((g_opt_flags & OPT_FLAGS_SYNC_START) && g_opt_timeout)
+		(void)alarm(g_opt_timeout);
+	stats->start = stats->finish = time_now();
+}
+
+/*
+ *  stress_start_barrier()
+ *	true if instances of stressor id wait at the start barrier
+ */
+static inline bool stress_start_barrier(const stress_id_t id)
+{
+	return (g_opt_flags & OPT_FLAGS_SYNC_START) || stress_sgx_stressor(id);
+}
+
+/*
+ *  stress_start_exited()
+ *	true if instance pid has already exited, the child is
+ *	left unreaped for wait_procs()
+ */
+static bool stress_start_exited(const pid_t pid)
+{
+	siginfo_t info;
+
+	(void)memset(&info, 0, sizeof(info));
+	return (waitid(P_PID, (id_t)pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0) &&
+		(info.si_pid == pid);
+}
+
+/*
+ *  stress_start_release()
+ *	wait until every started instance that uses the start
+ *	barrier is ready or has exited, then wake them all
+ *	together. Gives up waiting after START_BARRIER_TIMEOUT
+ *	seconds so one stuck instance cannot hang the run
+ */
+static void stress_start_release(const proc_info_t *procs_list)
+{
+	const double t_end = time_now() + START_BARRIER_TIMEOUT;
+	uint32_t expected, ready;
+
+	for (;;) {
+		const proc_info_t *pi;
+
+		expected = 0;
+		ready = 0;
+		for (pi = procs_list; pi; pi = pi->next) {
+			int32_t j;
+
+			if (!stress_start_barrier(pi->stressor->id))
+				continue;
+			/* One process per stressor in --threads mode */
+			for (j = 0; j < pi->started_procs; j++) {
+				if (!pi->pids[j])
+					continue;
+				expected++;
+				if (pi->stats[j]->ready || stress_start_exited(pi->pids[j]))
+					ready++;
+			}
+		}
+		if ((ready >= expected) || !g_keep_stressing_flag)
+			break;
+		if (time_now() > t_end) {
+			pr_inf("%" PRIu32 " of %" PRIu32 " instances not ready "
+				"after %.0f seconds, starting without them\n",
+				expected - ready, expected, START_BARRIER_TIMEOUT);
+			break;
+		}
+		(void)shim_usleep(1000);
+	}
+
+	g_shared->sync_start.futex = 1;
+	__sync_synchronize();
+	(void)shim_futex_wake(&g_shared->sync_start.futex, INT_MAX);
+	pr_dbg("%" PRIu32 " stressor%s released together\n",
+		ready, ready == 1 ? "" : "s");
+}
+
 /*
  *  stress_run ()
  *	kick off and run stressors
@@ -2184,8 +2505,15 @@ static void MLOCKED stress_run(
 	double time_start, time_finish;
 	int32_t n_procs, j;
 	const int32_t total_procs = get_total_num_procs(procs_list);
+	bool start_barrier = false;
+
+	g_shared->sync_start.futex = 0;
+	for (proc_current = procs_list; proc_current; proc_current = proc_current->next)
+		if (stress_start_barrier(proc_current->stressor->id))
+			start_barrier = true;
 
 	wait_flag = true;
+	energy_start();
 	time_start = time_now();
 	pr_dbg("starting stressors\n");
 	for (n_procs = 0; n_procs < total_procs; n_procs++) {
@@ -2202,12 +2530,17 @@ static void MLOCKED stress_run(
 				int64_t backoff = DEFAULT_BACKOFF;
 				int32_t ionice_class = UNDEFINED;
 				int32_t ionice_level = UNDEFINED;
+				struct rusage usage;
+				const bool threaded = (g_opt_flags & OPT_FLAGS_THREADS) &&
+					stress_thread_safe(proc_current->stressor->id);
 
 				(void)get_setting("backoff", &backoff);
 				(void)get_setting("ionice-class", &ionice_class);
 				(void)get_setting("ionice-level", &ionice_level);
 
 				proc_stats_t *stats = proc_current->stats[j];
+
+				stats->ready = 0;
 again:
 				if (!g_keep_stressing_flag)
 					break;
@@ -2226,6 +2559,8 @@ again:
 					/* Child */
 					(void)setpgid(0, g_pgrp);
 					if (stress_set_handler(name, true) < 0) {
+						/* Don't hold back the start barrier */
+						stress_start_ready(stats);
 						rc = EXIT_FAILURE;
 						goto child_exit;
 					}
@@ -2242,24 +2577,55 @@ again:
 					set_oom_adjustment(name, false);
 					set_max_limits();
 					set_iopriority(ionice_class, ionice_level);
+					if (!threaded)
+						placement_set(j, stats->placement,
+							sizeof(stats->placement));
 					set_proc_name(name);
 
-					pr_dbg("%s: started [%d] (instance %" PRIu32 ")\n",
-						name, (int)getpid(), j);
+					if (threaded)
+						pr_dbg("%s: started [%d] (instances 0..%" PRId32 " as threads)\n",
+							name, (int)getpid(), proc_current->num_procs - 1);
+					else
+						pr_dbg("%s: started [%d] (instance %" PRIu32 ")\n",
+							name, (int)getpid(), j);
 
 					stats->start = stats->finish = time_now();
 #if defined(STRESS_PERF_STATS)
 					if (g_opt_flags & OPT_FLAGS_PERF_STATS)
 						(void)perf_open(&stats->sp);
 #endif
-					(void)shim_usleep(backoff * n_procs);
+					if (!(g_opt_flags & OPT_FLAGS_SYNC_START)) {
+						(void)shim_usleep(backoff * n_procs);
+					} else if (!stress_sgx_stressor(proc_current->stressor->id)) {
+						/*
+						 *  Everyone starts together and the alarm
+						 *  is re-armed so all instances also share
+						 *  a common stop, SGX instances wait in
+						 *  stress_sgx_ready() once their enclave
+						 *  is loaded
+						 */
+						stress_start_wait(stats);
+						if (g_opt_timeout)
+							(void)alarm(g_opt_timeout);
+						stats->start = stats->finish = time_now();
+					}
 #if defined(STRESS_PERF_STATS)
 					if (g_opt_flags & OPT_FLAGS_PERF_STATS)
 						(void)perf_enable(&stats->sp);
+#endif
+#if defined(HAVE_LIB_PTHREAD)
+					if (threaded) {
+						if (g_keep_stressing_flag && !(g_opt_flags & OPT_FLAGS_DRY_RUN))
+							rc = stress_run_threads(proc_current, name);
+					} else
 #endif
 					if (g_keep_stressing_flag && !(g_opt_flags & OPT_FLAGS_DRY_RUN)) {
 						const args_t args = {
 							.counter = &stats->counter,
+							.lat = (g_opt_flags & OPT_FLAGS_LATENCY) ?
+								&stats->lat : NULL,
+							.rate = (g_opt_flags & OPT_FLAGS_RATE) ?
+								&stats->rate : NULL,
 							.name = name,
 							.max_ops = proc_current->bogo_ops,
 							.instance = j,
@@ -2272,6 +2638,8 @@ again:
 						rc = proc_current->stressor->stress_func(&args);
 						stats->run_ok = (rc == EXIT_SUCCESS);
 					}
+					/* SGX instances that bailed out before loading their enclave */
+					stress_start_ready(stats);
 #if defined(STRESS_PERF_STATS)
 					if (g_opt_flags & OPT_FLAGS_PERF_STATS) {
 						(void)perf_disable(&stats->sp);
@@ -2283,13 +2651,21 @@ again:
 						(void)tz_get_temperatures(&g_shared->tz_info, &stats->tz);
 #endif
 
-					stats->finish = time_now();
+					if (getrusage(RUSAGE_SELF, &usage) == 0)
+						stats->maxrss = usage.ru_maxrss;
+					stats->pss = stress_get_pss();
+					if (!threaded)
+						stats->finish = time_now();
 					if (times(&stats->tms) == (clock_t)-1) {
 						pr_dbg("times failed: errno=%d (%s)\n",
 							errno, strerror(errno));
 					}
-					pr_dbg("%s: exited [%d] (instance %" PRIu32 ")\n",
-						name, (int)getpid(), j);
+					if (threaded)
+						pr_dbg("%s: exited [%d] (instances 0..%" PRId32 " as threads)\n",
+							name, (int)getpid(), proc_current->num_procs - 1);
+					else
+						pr_dbg("%s: exited [%d] (instance %" PRIu32 ")\n",
+							name, (int)getpid(), j);
 #if defined(STRESS_THERMAL_ZONES)
 					tz_free(&g_shared->tz_info);
 #endif
@@ -2309,7 +2685,13 @@ child_exit:
 					if (pid > -1) {
 						(void)setpgid(pid, g_pgrp);
 						proc_current->pids[j] = pid;
-						proc_current->started_procs++;
+						sample_instance_start(proc_current, j);
+						startup_procs++;
+						/* All instances live in this one process */
+						if (threaded)
+							proc_current->started_procs = proc_current->num_procs;
+						else
+							proc_current->started_procs++;
 					}
 
 					/* Forced early abort during startup? */
@@ -2323,6 +2705,8 @@ child_exit:
 			}
 		}
 	}
+	if (start_barrier)
+		stress_start_release(procs_list);
 	(void)stress_set_handler("stress-ng", false);
 	if (g_opt_timeout)
 		(void)alarm(g_opt_timeout);
@@ -2332,9 +2716,33 @@ abort:
 		n_procs == 1 ? "" : "s");
 
 wait_for_procs:
+	sample_start(procs_list);
+#if defined(STRESS_PERF_STATS)
+	perf_sample_start(procs_list);
+#endif
+	repeat_warmup_start(procs_list);
+	freq_start(procs_list);
 	wait_procs(procs_list, success, resource_success);
+	repeat_warmup_stop();
+#if defined(STRESS_PERF_STATS)
+	perf_sample_stop();
+#endif
+	sample_stop();
+	energy_stop(procs_list);
+	freq_stop(procs_list);
 	time_finish = time_now();
 
+	/* Time until the last instance started stressing */
+	for (proc_current = procs_list; proc_current; proc_current = proc_current->next) {
+		double started = time_start;
+
+		for (j = 0; j < proc_current->started_procs; j++)
+			if (proc_current->stats[j]->start > started)
+				started = proc_current->stats[j]->start;
+		if (started - time_start > startup_secs)
+			startup_secs = started - time_start;
+	}
+
 	*duration += time_finish - time_start;
 }
 
@@ -2381,6 +2789,361 @@ static int show_stressors(void)
 	return 0;
 }
 
+/*
+ *  sgx_method_metrics_dump()
+ *	output the per method breakdown of an sgx stressor
+ */
+static void sgx_method_metrics_dump(
+	FILE *yaml,
+	const sgx_method_stats_t *stats)
+{
+	uint64_t nsec_total = 0;
+	int i;
+
+	for (i = 0; (i < STRESS_SGX_METHODS_MAX) && *stats[i].name; i++)
+		nsec_total += stats[i].nsec;
+	if (!i)
+		return;
+
+	pr_inf("  %-15s %9.9s %9.9s %12.12s %8.8s\n",
+		"method", "bogo ops", "time", "nsec per", "time");
+	pr_inf("  %-15s %9.9s %9.9s %12.12s %8.8s\n",
+		"", "", "(secs) ", "bogo op", "(%)");
+	pr_yaml(yaml, "      methods:\n");
+
+	for (i = 0; (i < STRESS_SGX_METHODS_MAX) && *stats[i].name; i++) {
+		const double secs = (double)stats[i].nsec / 1000000000.0;
+		const double nsec_per_op = stats[i].ops ?
+			(double)stats[i].nsec / (double)stats[i].ops : 0.0;
+		const double percent = nsec_total ?
+			100.0 * (double)stats[i].nsec / (double)nsec_total : 0.0;
+
+		pr_inf("  %-15s %9" PRIu64 " %9.2f %12.2f %8.2f\n",
+			stats[i].name, stats[i].ops, secs, nsec_per_op, percent);
+
+		pr_yaml(yaml, "        - method: %s\n", stats[i].name);
+		pr_yaml(yaml, "          bogo-ops: %" PRIu64 "\n", stats[i].ops);
+		pr_yaml(yaml, "          time: %f\n", secs);
+		pr_yaml(yaml, "          nsec-per-bogo-op: %f\n", nsec_per_op);
+		pr_yaml(yaml, "          time-percent: %f\n", percent);
+	}
+}
+
+/*
+ *  sgx_verify_metrics_dump()
+ *	output how much of the sgx-vm method time went on verify phases
+ */
+static void sgx_verify_metrics_dump(
+	FILE *yaml,
+	const sgx_verify_stats_t *verify,
+	const sgx_method_stats_t *stats)
+{
+	uint64_t nsec_total = 0;
+	double rate, percent;
+	int i;
+
+	if (!verify->nsec)
+		return;
+
+	for (i = 0; (i < STRESS_SGX_METHODS_MAX) && *stats[i].name; i++)
+		nsec_total += stats[i].nsec;
+	/* bytes per nsec is GB/s */
+	rate = (double)verify->bytes / (double)verify->nsec;
+	percent = nsec_total ? 100.0 * (double)verify->nsec / (double)nsec_total : 0.0;
+
+	pr_inf("  %-15s %9.2f GB/s, %.2f%% of method time\n",
+		"verify", rate, percent);
+	pr_yaml(yaml, "      verify-gb-per-second: %f\n", rate);
+	pr_yaml(yaml, "      verify-time-percent: %f\n", percent);
+}
+
+/*
+ *  sgx_commit_metrics_dump()
+ *	output the EPC first touch rates of sgx-vm by buffer size
+ */
+static void sgx_commit_metrics_dump(
+	FILE *yaml,
+	const sgx_commit_stats_t *stats)
+{
+	const size_t page_size = stress_get_pagesize();
+	int i;
+
+	for (i = 0; (i < SGX_VM_COMMIT_SIZES) && !stats[i].touches; i++)
+		;
+	if (i == SGX_VM_COMMIT_SIZES)
+		return;
+
+	pr_inf("  %-15s %9.9s %12.12s %12.12s %9.9s\n",
+		"first touch", "touches", "pages", "pages/s", "nsec per");
+	pr_inf("  %-15s %9.9s %12.12s %12.12s %9.9s\n",
+		"(KB)", "", "", "", "page");
+	pr_yaml(yaml, "      first-touch:\n");
+
+	for (; i < SGX_VM_COMMIT_SIZES; i++) {
+		const double secs = (double)stats[i].nsec / 1000000000.0;
+		const double rate = (secs > 0.0) ? (double)stats[i].pages / secs : 0.0;
+		const double nsec_per = stats[i].pages ?
+			(double)stats[i].nsec / (double)stats[i].pages : 0.0;
+		const uint64_t kbytes = stats[i].touches ?
+			(stats[i].pages / stats[i].touches) * page_size / KB : 0;
+
+		if (!stats[i].touches)
+			continue;
+
+		pr_inf("  %-15" PRIu64 " %9" PRIu64 " %12" PRIu64 " %12.2f %9.2f\n",
+			kbytes, stats[i].touches, stats[i].pages, rate, nsec_per);
+
+		pr_yaml(yaml, "        - buffer-kb: %" PRIu64 "\n", kbytes);
+		pr_yaml(yaml, "          touches: %" PRIu64 "\n", stats[i].touches);
+		pr_yaml(yaml, "          pages: %" PRIu64 "\n", stats[i].pages);
+		pr_yaml(yaml, "          pages-per-second: %f\n", rate);
+		pr_yaml(yaml, "          nsec-per-page: %f\n", nsec_per);
+	}
+}
+
+/*
+ *  sgx_vm_thread_metrics_dump()
+ *	output the per thread and aggregate bandwidth of --sgx-vm-threads
+ */
+static void sgx_vm_thread_metrics_dump(
+	FILE *yaml,
+	const sgx_vm_thread_stats_t *stats)
+{
+	double total_rate = 0.0;
+	uint64_t total_errors = 0;
+	int i;
+
+	if (!stats[0].nsec)
+		return;
+
+	pr_inf("  %-15s %12.12s %9.9s %12.12s\n",
+		"thread", "passes", "GB/s", "bit errors");
+	pr_yaml(yaml, "      threads:\n");
+
+	for (i = 0; (i < MAX_SGX_VM_THREADS) && stats[i].nsec; i++) {
+		/* bytes per nsec is GB/s */
+		const double rate = (double)stats[i].bytes / (double)stats[i].nsec;
+
+		total_rate += rate;
+		total_errors += stats[i].bit_errors;
+
+		pr_inf("  %-15d %12" PRIu64 " %9.3f %12" PRIu64 "\n",
+			i, stats[i].passes, rate, stats[i].bit_errors);
+
+		pr_yaml(yaml, "        - thread: %d\n", i);
+		pr_yaml(yaml, "          passes: %" PRIu64 "\n", stats[i].passes);
+		pr_yaml(yaml, "          gb-per-second: %f\n", rate);
+		pr_yaml(yaml, "          bit-errors: %" PRIu64 "\n", stats[i].bit_errors);
+	}
+	pr_inf("  %-15s %12.12s %9.3f %12" PRIu64 "\n",
+		"all", "", total_rate, total_errors);
+	pr_yaml(yaml, "      threads-gb-per-second: %f\n", total_rate);
+}
+
+/*
+ *  sgx_syscall_metrics_dump()
+ *	output the OCALL proxied vs native I/O rates of sgx-syscall
+ */
+static void sgx_syscall_metrics_dump(
+	FILE *yaml,
+	const sgx_syscall_stats_t *stats)
+{
+	static const char * const modes[] = { "enclave", "native" };
+	double rate[2];
+	int i;
+
+	pr_inf("  %-15s %12.12s %12.12s %9.9s %8.8s\n",
+		"mode", "syscalls", "syscalls/s", "MB/s", "slowdown");
+	pr_yaml(yaml, "      syscall-proxy:\n");
+
+	for (i = 0; i < 2; i++) {
+		const double secs = (double)stats[i].nsec / 1000000000.0;
+
+		rate[i] = (secs > 0.0) ? (double)stats[i].syscalls / secs : 0.0;
+	}
+	for (i = 0; i < 2; i++) {
+		const double secs = (double)stats[i].nsec / 1000000000.0;
+		const double mb_rate = (secs > 0.0) ?
+			(double)stats[i].bytes / (secs * (double)MB) : 0.0;
+		const double slowdown = (rate[i] > 0.0) ?
+			rate[SGX_RUN_NATIVE] / rate[i] : 0.0;
+
+		pr_inf("  %-15s %12" PRIu64 " %12.2f %9.2f %8.2f\n",
+			modes[i], stats[i].syscalls, rate[i], mb_rate, slowdown);
+
+		pr_yaml(yaml, "        - mode: %s\n", modes[i]);
+		pr_yaml(yaml, "          syscalls: %" PRIu64 "\n", stats[i].syscalls);
+		pr_yaml(yaml, "          syscalls-per-second: %f\n", rate[i]);
+		pr_yaml(yaml, "          mb-per-second: %f\n", mb_rate);
+		pr_yaml(yaml, "          slowdown: %f\n", slowdown);
+	}
+}
+
+/*
+ *  sgx_exception_metrics_dump()
+ *	output the in-enclave vs native exception handling rates
+ */
+static void sgx_exception_metrics_dump(
+	FILE *yaml,
+	const sgx_exception_stats_t *stats)
+{
+	static const char * const modes[] = { "enclave", "native" };
+	double rate[2];
+	int i;
+
+	pr_inf("  %-15s %12.12s %12.12s %12.12s %8.8s\n",
+		"mode", "exceptions", "exceptions/s", "nsec per", "slowdown");
+	pr_yaml(yaml, "      exceptions:\n");
+
+	for (i = 0; i < 2; i++) {
+		const double secs = (double)stats[i].nsec / 1000000000.0;
+
+		rate[i] = (secs > 0.0) ? (double)stats[i].exceptions / secs : 0.0;
+	}
+	for (i = 0; i < 2; i++) {
+		const double nsec_per = stats[i].exceptions ?
+			(double)stats[i].nsec / (double)stats[i].exceptions : 0.0;
+		const double slowdown = (rate[i] > 0.0) ?
+			rate[SGX_RUN_NATIVE] / rate[i] : 0.0;
+
+		pr_inf("  %-15s %12" PRIu64 " %12.2f %12.2f %8.2f\n",
+			modes[i], stats[i].exceptions, rate[i], nsec_per, slowdown);
+
+		pr_yaml(yaml, "        - mode: %s\n", modes[i]);
+		pr_yaml(yaml, "          exceptions: %" PRIu64 "\n", stats[i].exceptions);
+		pr_yaml(yaml, "          exceptions-per-second: %f\n", rate[i]);
+		pr_yaml(yaml, "          nsec-per-exception: %f\n", nsec_per);
+		pr_yaml(yaml, "          slowdown: %f\n", slowdown);
+	}
+}
+
+/*
+ *  sgx_lock_metrics_dump()
+ *	output the per primitive rates and OCALLs of sgx-lock
+ */
+static void sgx_lock_metrics_dump(
+	FILE *yaml,
+	const sgx_lock_stats_t *stats)
+{
+	static const char * const primitives[] = {
+		"mutex", "spin", "atomic", "condvar"
+	};
+	int i;
+
+	pr_inf("  %-15s %12.12s %12.12s %9.9s %9.9s\n",
+		"primitive", "ops", "ops/s", "sleeps", "wakes");
+	pr_inf("  %-15s %12.12s %12.12s %9.9s %9.9s\n",
+		"", "", "", "per op", "per op");
+	pr_yaml(yaml, "      primitives:\n");
+
+	for (i = 0; i < SGX_LOCK_MAX; i++) {
+		const double secs = (double)stats[i].nsec / 1000000000.0;
+		const double rate = (secs > 0.0) ? (double)stats[i].ops / secs : 0.0;
+		const double sleeps = stats[i].ops ?
+			(double)stats[i].sleeps / (double)stats[i].ops : 0.0;
+		const double wakes = stats[i].ops ?
+			(double)stats[i].wakes / (double)stats[i].ops : 0.0;
+
+		if (!stats[i].nsec)
+			continue;
+
+		pr_inf("  %-15s %12" PRIu64 " %12.2f %9.4f %9.4f\n",
+			primitives[i], stats[i].ops, rate, sleeps, wakes);
+
+		pr_yaml(yaml, "        - primitive: %s\n", primitives[i]);
+		pr_yaml(yaml, "          ops: %" PRIu64 "\n", stats[i].ops);
+		pr_yaml(yaml, "          ops-per-second: %f\n", rate);
+		pr_yaml(yaml, "          sleep-ocalls-per-op: %f\n", sleeps);
+		pr_yaml(yaml, "          wake-ocalls-per-op: %f\n", wakes);
+	}
+}
+
+/*
+ *  lat_value()
+ *	middle of a latency histogram bucket in ns
+ */
+static double lat_value(const uint32_t idx)
+{
+	uint32_t shift;
+	uint64_t lo;
+
+	if (idx < STRESS_LAT_SUB)
+		return (double)idx;
+	shift = (idx >> STRESS_LAT_SUB_BITS) - 1;
+	lo = (uint64_t)(STRESS_LAT_SUB + (idx & (STRESS_LAT_SUB - 1))) << shift;
+	return (double)lo + (double)(1ULL << shift) / 2.0;
+}
+
+/*
+ *  lat_percentile()
+ *	latency in ns below which a fraction p of the bogo ops fall
+ */
+static double lat_percentile(const stress_lat_t *lat, const double p)
+{
+	const double rank = p * (double)lat->count;
+	uint64_t target = (uint64_t)rank, sum = 0;
+	uint32_t i;
+
+	if ((double)target < rank)
+		target++;
+
+	for (i = 0; i < STRESS_LAT_BUCKETS; i++) {
+		sum += lat->bucket[i];
+		if (sum && (sum >= target))
+			break;
+	}
+	/* The top bucket is wide, don't report more than was seen */
+	return STRESS_MINIMUM(lat_value(i), (double)lat->max);
+}
+
+/*
+ *  lat_metrics_dump()
+ *	output the bogo op latency percentiles of all
+ *	instances of a stressor that records latency
+ */
+static void lat_metrics_dump(FILE *yaml, const proc_info_t *pi)
+{
+	static stress_lat_t lat;
+	double p50, p99, p999;
+	int32_t j;
+	uint32_t i;
+
+	(void)memset(&lat, 0, sizeof(lat));
+	for (j = 0; j < pi->started_procs; j++) {
+		const stress_lat_t *const l = &pi->stats[j]->lat;
+
+		for (i = 0; i < STRESS_LAT_BUCKETS; i++)
+			lat.bucket[i] += l->bucket[i];
+		lat.count += l->count;
+		if (l->max > lat.max)
+			lat.max = l->max;
+	}
+	if (!lat.count)
+		return;
+
+	p50 = lat_percentile(&lat, 0.50);
+	p99 = lat_percentile(&lat, 0.99);
+	p999 = lat_percentile(&lat, 0.999);
+
+	pr_inf("  %-15s %12.12s %12.12s %12.12s %12.12s %12.12s\n",
+		"latency", "ops timed", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+	pr_inf("  %-15s %12" PRIu64 " %12.0f %12.0f %12.0f %12" PRIu64 "\n",
+		"", lat.count, p50, p99, p999, lat.max);
+
+	pr_yaml(yaml, "      latency-ops-timed: %" PRIu64 "\n", lat.count);
+	pr_yaml(yaml, "      latency-p50-ns: %f\n", p50);
+	pr_yaml(yaml, "      latency-p99-ns: %f\n", p99);
+	pr_yaml(yaml, "      latency-p99.9-ns: %f\n", p999);
+	pr_yaml(yaml, "      latency-max-ns: %" PRIu64 "\n", lat.max);
+
+	compare_add(munge_underscore(pi->stressor->name), "latency-p50-ns",
+		COMPARE_LOWER, p50);
+	compare_add(munge_underscore(pi->stressor->name), "latency-p99-ns",
+		COMPARE_LOWER, p99);
+	compare_add(munge_underscore(pi->stressor->name), "latency-p99.9-ns",
+		COMPARE_LOWER, p999);
+}
+
 /*
  *  metrics_dump()
  *	output metrics
@@ -2405,6 +3168,7 @@ static void metrics_dump(
 		int32_t  j;
 		char *munged = munge_underscore(pi->stressor->name);
 		double u_time, s_time, bogo_rate_r_time, bogo_rate;
+		double mean, ci, cv;
 		bool run_ok = false;
 
 		for (j = 0; j < pi->started_procs; j++) {
@@ -2449,10 +3213,108 @@ static void metrics_dump(
 		pr_yaml(yaml, "      wall-clock-time: %f\n", r_total);
 		pr_yaml(yaml, "      user-time: %f\n", u_time);
 		pr_yaml(yaml, "      system-time: %f\n", s_time);
+
+		if (repeat_stats(pi, &mean, &ci, &cv)) {
+			size_t i;
+
+			pr_inf("  %-15s %zu run%s, %.2f +/- %.2f bogo ops/s "
+				"(95%% CI), CV %.2f%%\n", "repeat", pi->repeat_n,
+				pi->repeat_n == 1 ? "" : "s", mean, ci, cv * 100.0);
+			pr_yaml(yaml, "      repeat-runs: %zu\n", pi->repeat_n);
+			pr_yaml(yaml, "      repeat-bogo-ops-per-second-mean: %f\n", mean);
+			pr_yaml(yaml, "      repeat-bogo-ops-per-second-ci95: %f\n", ci);
+			pr_yaml(yaml, "      repeat-bogo-ops-per-second-cv: %f\n", cv);
+
+			/* Each run is a sample for --compare */
+			for (i = 0; i < pi->repeat_n; i++)
+				compare_add(munged, "bogo-ops-per-second-real-time",
+					COMPARE_HIGHER, pi->repeat_rates[i]);
+		} else {
+			compare_add(munged, "bogo-ops-per-second-real-time",
+				COMPARE_HIGHER, bogo_rate_r_time);
+		}
+		compare_add(munged, "bogo-ops-per-second-usr-sys-time",
+			COMPARE_HIGHER, bogo_rate);
+
+		if (g_opt_flags & OPT_FLAGS_LATENCY)
+			lat_metrics_dump(yaml, pi);
+		if (g_opt_flags & OPT_FLAGS_RATE)
+			rate_metrics_dump(yaml, pi);
+		if (g_opt_flags & OPT_FLAGS_ENERGY)
+			energy_metrics_dump(yaml, pi);
+		freq_metrics_dump(yaml, pi);
+		if (pi->stressor->id == STRESS_SGX)
+			sgx_method_metrics_dump(yaml, g_shared->sgx.cpu);
+		else if (pi->stressor->id == STRESS_SGX_VM) {
+			sgx_method_metrics_dump(yaml, g_shared->sgx.vm);
+			sgx_verify_metrics_dump(yaml, &g_shared->sgx.vm_verify,
+				g_shared->sgx.vm);
+			sgx_commit_metrics_dump(yaml, g_shared->sgx.commit);
+			sgx_vm_thread_metrics_dump(yaml, g_shared->sgx.vm_thread);
+		}
+		else if (pi->stressor->id == STRESS_SGX_EXCEPTION)
+			sgx_exception_metrics_dump(yaml, g_shared->sgx.exception);
+		else if (pi->stressor->id == STRESS_SGX_LOCK)
+			sgx_lock_metrics_dump(yaml, g_shared->sgx.primitive);
+		else if (pi->stressor->id == STRESS_SGX_SYSCALL)
+			sgx_syscall_metrics_dump(yaml, g_shared->sgx.syscall);
 		pr_yaml(yaml, "\n");
 	}
 }
 
+/*
+ *  startup_dump()
+ *	output how long instances took to start and how much
+ *	memory their processes used, to compare --threads runs
+ *	with the default one process per instance. Summed peak
+ *	RSS counts pages shared between processes once for each
+ *	of them, so it is only an upper bound, the summed PSS
+ *	splits shared pages and is the fairer comparison
+ */
+static void startup_dump(FILE *yaml)
+{
+	const proc_info_t *pi;
+	const uint32_t procs = startup_procs;
+	uint32_t instances = 0;
+	uint64_t maxrss = 0, pss = 0;
+
+	for (pi = procs_head; pi; pi = pi->next) {
+		int32_t j;
+
+		for (j = 0; j < pi->started_procs; j++) {
+			instances++;
+			maxrss += (uint64_t)pi->stats[j]->maxrss;
+			pss += pi->stats[j]->pss;
+		}
+	}
+	if (!instances)
+		return;
+
+	if (pss) {
+		pr_inf("%" PRIu32 " instance%s in %" PRIu32 " process%s, all running "
+			"after %.3f secs, PSS %.2f MB total (peak RSS upper "
+			"bound %.2f MB)\n",
+			instances, instances == 1 ? "" : "s",
+			procs, procs == 1 ? "" : "es",
+			startup_secs, (double)pss / 1024.0,
+			(double)maxrss / 1024.0);
+	} else {
+		pr_inf("%" PRIu32 " instance%s in %" PRIu32 " process%s, all running "
+			"after %.3f secs, peak RSS upper bound %.2f MB total\n",
+			instances, instances == 1 ? "" : "s",
+			procs, procs == 1 ? "" : "es",
+			startup_secs, (double)maxrss / 1024.0);
+	}
+	pr_yaml(yaml, "startup:\n");
+	pr_yaml(yaml, "      instances: %" PRIu32 "\n", instances);
+	pr_yaml(yaml, "      processes: %" PRIu32 "\n", procs);
+	pr_yaml(yaml, "      startup-time: %f\n", startup_secs);
+	if (pss)
+		pr_yaml(yaml, "      pss-mb-total: %f\n", (double)pss / 1024.0);
+	pr_yaml(yaml, "      peak-rss-mb-upper-bound: %f\n", (double)maxrss / 1024.0);
+	pr_yaml(yaml, "\n");
+}
+
 /*
  *  times_dump()
  *	output the run times
@@ -2946,6 +3808,9 @@ next_opt:
 			i64 = (int64_t)get_uint64(optarg);
 			set_setting("backoff", TYPE_ID_INT64, &i64);
 			break;
+		case OPT_BASELINE:
+			set_setting("baseline", TYPE_ID_STR, (void *)optarg);
+			break;
 		case OPT_BIGHEAP_GROWTH:
 			stress_set_bigheap_growth(optarg);
 			break;
@@ -2998,6 +3863,12 @@ next_opt:
 		case OPT_CLONE_MAX:
 			stress_set_clone_max(optarg);
 			break;
+		case OPT_COMPARE:
+			set_setting("compare", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_COMPARE_THRESHOLD:
+			stress_set_compare_threshold(optarg);
+			break;
 		case OPT_COPY_FILE_BYTES:
 			stress_set_copy_file_bytes(optarg);
 			break;
@@ -3068,9 +3939,15 @@ next_opt:
 		case OPT_EPOLL_PORT:
 			stress_set_epoll_port(optarg);
 			break;
+		case OPT_ENERGY:
+			g_opt_flags |= OPT_FLAGS_ENERGY;
+			break;
 		case OPT_EXCLUDE:
 			set_setting("exclude", TYPE_ID_STR, (void *)optarg);
 			break;
+		case OPT_FREQ:
+			stress_set_freq();
+			break;
 		case OPT_EXEC_MAX:
 			stress_set_exec_max(optarg);
 			break;
@@ -3149,6 +4026,9 @@ next_opt:
 		case OPT_LOCKF_NONBLOCK:
 			g_opt_flags |= OPT_FLAGS_LOCKF_NONBLK;
 			break;
+		case OPT_LATENCY:
+			g_opt_flags |= OPT_FLAGS_LATENCY;
+			break;
 		case OPT_LOG_BRIEF:
 			g_opt_flags |= OPT_FLAGS_LOG_BRIEF;
 			break;
@@ -3254,7 +4134,20 @@ next_opt:
 		case OPT_PERF_STATS:
 			g_opt_flags |= OPT_FLAGS_PERF_STATS;
 			break;
+		case OPT_PERF_SAMPLE:
+			stress_set_perf_sample(optarg);
+			break;
+		case OPT_PERF_SAMPLE_CALLCHAIN:
+			stress_set_perf_sample_callchain();
+			break;
+		case OPT_PERF_SAMPLE_TOP:
+			stress_set_perf_sample_top(optarg);
+			break;
 #endif
+		case OPT_PLACEMENT:
+			if (stress_set_placement(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
 		case OPT_PIPE_DATA_SIZE:
 			stress_set_pipe_data_size(optarg);
 			break;
@@ -3292,6 +4185,14 @@ next_opt:
 			stress_get_processors(&i32);
 			set_setting("random", TYPE_ID_INT32, &i32);
 			break;
+		case OPT_RATE:
+			stress_set_rate(optarg);
+			g_opt_flags |= (OPT_FLAGS_RATE | OPT_FLAGS_LATENCY);
+			break;
+		case OPT_RATE_PROFILE:
+			if (stress_set_rate_profile(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
 		case OPT_RAWDEV_METHOD:
 			if (stress_set_rawdev_method(optarg) < 0)
 				return EXIT_FAILURE;
@@ -3299,6 +4200,21 @@ next_opt:
 		case OPT_READAHEAD_BYTES:
 			stress_set_readahead_bytes(optarg);
 			break;
+		case OPT_REPEAT:
+			stress_set_repeat(optarg);
+			break;
+		case OPT_SAMPLE_INTERVAL:
+			stress_set_sample_interval(optarg);
+			break;
+		case OPT_SCALE_SWEEP:
+			stress_set_scale_sweep(optarg);
+			break;
+		case OPT_SAMPLE_FILE:
+			set_setting("sample-file", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_SAMPLE_INSTANCES:
+			g_opt_flags |= OPT_FLAGS_SAMPLE_INSTANCES;
+			break;
 		case OPT_SCHED:
 			i32 = get_opt_sched(optarg);
 			set_setting("sched", TYPE_ID_INT32, &i32);
@@ -3340,12 +4256,42 @@ next_opt:
 			if (stress_set_sgx_method(optarg) < 0)
 				return EXIT_FAILURE;
 			break;
+		case OPT_SGX_LOAD:
+			stress_set_sgx_load(optarg);
+			break;
+		case OPT_SGX_LOAD_SLICE:
+			stress_set_sgx_load_slice(optarg);
+			break;
+		case OPT_SGX_OPS_PER_ECALL:
+			stress_set_sgx_ops_per_ecall(optarg);
+			break;
+		case OPT_SGX_EXCEPTION_METHOD:
+			if (stress_set_sgx_exception_method(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_SGX_LOCK_METHOD:
+			if (stress_set_sgx_lock_method(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
+		case OPT_SGX_LOCK_THREADS:
+			stress_set_sgx_lock_threads(optarg);
+			break;
+		case OPT_SGX_SYSCALL_BYTES:
+			stress_set_sgx_syscall_bytes(optarg);
+			break;
+		case OPT_SGX_SYSCALL_MIX:
+			if (stress_set_sgx_syscall_mix(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
 		case OPT_SGX_VM_BYTES:
 			stress_set_sgx_vm_bytes(optarg);
 			break;
 		case OPT_SGX_VM_HANG:
 			stress_set_sgx_vm_hang(optarg);
 			break;
+		case OPT_SGX_VM_COMMIT:
+			g_opt_flags |= OPT_FLAGS_SGX_VM_COMMIT;
+			break;
 		case OPT_SGX_VM_KEEP:
 			g_opt_flags |= OPT_FLAGS_SGX_VM_KEEP;
 			break;
@@ -3353,6 +4299,9 @@ next_opt:
 			if (stress_set_sgx_vm_method(optarg) < 0)
 				return EXIT_FAILURE;
 			break;
+		case OPT_SGX_VM_THREADS:
+			stress_set_sgx_vm_threads(optarg);
+			break;
 		case OPT_SHM_POSIX_BYTES:
 			stress_set_shm_posix_bytes(optarg);
 			break;
@@ -3412,6 +4361,9 @@ next_opt:
 		case OPT_SYNC_FILE_BYTES:
 			stress_set_sync_file_bytes(optarg);
 			break;
+		case OPT_SYNC_START:
+			g_opt_flags |= OPT_FLAGS_SYNC_START;
+			break;
 		case OPT_SYSLOG:
 			g_opt_flags |= OPT_FLAGS_SYSLOG;
 			break;
@@ -3422,6 +4374,9 @@ next_opt:
 		case OPT_THRASH:
 			g_opt_flags |= OPT_FLAGS_THRASH;
 			break;
+		case OPT_THREADS:
+			g_opt_flags |= OPT_FLAGS_THREADS;
+			break;
 		case OPT_TEMP_PATH:
 			if (stress_set_temp_path(optarg) < 0)
 				return EXIT_FAILURE;
@@ -3490,6 +4445,9 @@ next_opt:
 		case OPT_VERIFY:
 			g_opt_flags |= (OPT_FLAGS_VERIFY | PR_FAIL);
 			break;
+		case OPT_UNTIL_CI:
+			stress_set_until_ci(optarg);
+			break;
 		case OPT_VERSION:
 			version();
 			exit(EXIT_SUCCESS);
@@ -3526,6 +4484,9 @@ next_opt:
 		case OPT_VM_SPLICE_BYTES:
 			stress_set_vm_splice_bytes(optarg);
 			break;
+		case OPT_WARMUP:
+			stress_set_warmup(optarg);
+			break;
 		case OPT_WCS_METHOD:
 			if (stress_set_wcs_method(optarg) < 0)
 				return EXIT_FAILURE;
@@ -3605,6 +4566,25 @@ static void stress_setup_sequential(const uint32_t class)
 	}
 }
 
+/*
+ *  stress_setup_scale_sweep()
+ *	--scale-sweep, size each stressor for the
+ *	largest instance count of the sweep
+ */
+static void stress_setup_scale_sweep(const uint32_t max_procs)
+{
+	proc_info_t *pi;
+
+	for (pi = procs_head; pi; pi = pi->next) {
+		if (!pi->num_procs)
+			continue;
+		free(pi->pids);
+		free(pi->stats);
+		pi->num_procs = (int32_t)max_procs;
+		alloc_proc_resources(&pi->pids, &pi->stats, pi->num_procs);
+	}
+}
+
 /*
  *  stress_setup_parallel()
  *	setup for parallel mode stressors
@@ -3653,6 +4633,100 @@ static inline void stress_run_sequential(
 	}
 }
 
+/*
+ *  stress_reset_procs()
+ *	clear the stats of the first n instances
+ *	of a stressor before running it again
+ */
+static void stress_reset_procs(proc_info_t *pi, const int32_t n)
+{
+	int32_t j;
+
+	for (j = 0; j < n; j++) {
+		(void)memset(pi->stats[j], 0, sizeof(*pi->stats[j]));
+		pi->pids[j] = 0;
+	}
+	pi->started_procs = 0;
+	/* --metrics reports the last run */
+	startup_procs = 0;
+	startup_secs = 0.0;
+}
+
+/*
+ *  stress_reset_sgx_stats()
+ *	clear the shared SGX tables of a stressor before
+ *	running it again, so --metrics reports the last run
+ *	of --repeat or the last instance count of a sweep
+ */
+static void stress_reset_sgx_stats(const proc_info_t *pi)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_lock(&g_shared->sgx.lock);
+#endif
+	switch (pi->stressor->id) {
+	case STRESS_SGX:
+		(void)memset(g_shared->sgx.cpu, 0, sizeof(g_shared->sgx.cpu));
+		break;
+	case STRESS_SGX_VM:
+		(void)memset(g_shared->sgx.vm, 0, sizeof(g_shared->sgx.vm));
+		(void)memset(g_shared->sgx.commit, 0, sizeof(g_shared->sgx.commit));
+		(void)memset(&g_shared->sgx.vm_verify, 0, sizeof(g_shared->sgx.vm_verify));
+		(void)memset(g_shared->sgx.vm_thread, 0, sizeof(g_shared->sgx.vm_thread));
+		break;
+	case STRESS_SGX_SYSCALL:
+		(void)memset(g_shared->sgx.syscall, 0, sizeof(g_shared->sgx.syscall));
+		break;
+	case STRESS_SGX_EXCEPTION:
+		(void)memset(g_shared->sgx.exception, 0, sizeof(g_shared->sgx.exception));
+		break;
+	case STRESS_SGX_LOCK:
+		(void)memset(g_shared->sgx.primitive, 0, sizeof(g_shared->sgx.primitive));
+		break;
+	default:
+		break;
+	}
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_unlock(&g_shared->sgx.lock);
+#endif
+}
+
+/*
+ *  stress_run_scale_sweep()
+ *	--scale-sweep, run stressors one at a time with
+ *	each instance count of the sweep in turn
+ */
+static void stress_run_scale_sweep(
+	double *duration,
+	bool *success,
+	bool *resource_success)
+{
+	const uint32_t *counts;
+	const size_t n = scale_sweep_counts(&counts);
+	proc_info_t *pi;
+
+	for (pi = procs_head; pi && g_keep_stressing_flag; pi = pi->next) {
+		proc_info_t *next = pi->next;
+		const int32_t max_procs = pi->num_procs;
+		size_t i;
+
+		if (!max_procs)
+			continue;
+
+		pi->next = NULL;
+		for (i = 0; (i < n) && g_keep_stressing_flag; i++) {
+			stress_reset_procs(pi, max_procs);
+			stress_reset_sgx_stats(pi);
+			pi->num_procs = (int32_t)counts[i];
+			pr_inf("scale-sweep: %s with %" PRIu32 " instance%s\n",
+				munge_underscore(pi->stressor->name), counts[i],
+				counts[i] == 1 ? "" : "s");
+			stress_run(pi, duration, success, resource_success);
+			scale_sweep_add(pi, i);
+		}
+		pi->next = next;
+	}
+}
+
 /*
  *  stress_run_parallel()
  *	run stressors in parallel
@@ -3668,6 +4742,41 @@ static inline void stress_run_parallel(
 	stress_run(procs_head, duration, success, resource_success);
 }
 
+/*
+ *  stress_run_repeat()
+ *	--repeat, --until-ci or --warmup, run all stressors
+ *	up to runs times, stopping early once their ops/s
+ *	are stable enough
+ */
+static void stress_run_repeat(
+	const uint32_t runs,
+	double *duration,
+	bool *success,
+	bool *resource_success)
+{
+	uint32_t i;
+
+	for (i = 0; (i < runs) && g_keep_stressing_flag; i++) {
+		proc_info_t *pi;
+
+		if (i) {
+			for (pi = procs_head; pi; pi = pi->next) {
+				stress_reset_procs(pi, pi->num_procs);
+				stress_reset_sgx_stats(pi);
+			}
+			pr_inf("repeat: run %" PRIu32 "\n", i + 1);
+		}
+		if (g_opt_flags & OPT_FLAGS_SEQUENTIAL)
+			stress_run_sequential(duration, success, resource_success);
+		else
+			stress_run_parallel(duration, success, resource_success);
+		if (repeat_add(procs_head, runs)) {
+			pr_inf("repeat: stable after %" PRIu32 " runs\n", i + 1);
+			break;
+		}
+	}
+}
+
 int main(int argc, char **argv)
 {
 	double duration = 0.0;			/* stressor run time in secs */
@@ -3677,6 +4786,10 @@ int main(int argc, char **argv)
 	char *yaml_filename;			/* YAML file name */
 	char *log_filename;			/* log filename */
 	char *job_filename = NULL;		/* job filename */
+	const uint32_t *scale_counts;		/* --scale-sweep instance counts */
+	size_t scale_n;				/* number of instance counts */
+	int regressions;			/* --compare regressions */
+	uint32_t repeat_runs;			/* --repeat runs, 0 for one run */
 	int32_t ticks_per_sec;			/* clock ticks per second (jiffies) */
 	int32_t sched = UNDEFINED;		/* scheduler type */
 	int32_t sched_prio = UNDEFINED;		/* scheduler priority */
@@ -3844,6 +4957,9 @@ int main(int argc, char **argv)
 	} else {
 		stress_setup_parallel(class);
 	}
+	scale_n = scale_sweep_counts(&scale_counts);
+	if (scale_n)
+		stress_setup_scale_sweep(scale_counts[scale_n - 1]);
 
 	set_proc_limits();
 
@@ -3876,6 +4992,7 @@ int main(int argc, char **argv)
 #endif
 #if defined(HAVE_LIB_PTHREAD)
 	shim_pthread_spin_init(&g_shared->warn_once.lock, 0);
+	shim_pthread_spin_init(&g_shared->sgx.lock, 0);
 #endif
 
 	/*
@@ -3906,11 +5023,32 @@ int main(int argc, char **argv)
 
 	proc_helper(proc_init, SIZEOF_ARRAY(proc_init));
 
+	placement_init();
+
+	if ((g_opt_flags & OPT_FLAGS_ENERGY) && (energy_init() < 0))
+		g_opt_flags &= ~OPT_FLAGS_ENERGY;
+	freq_init();
+
+	/* Baselines are made of the metrics */
+	if (compare_init())
+		g_opt_flags |= OPT_FLAGS_METRICS;
+	if (repeat_init(&repeat_runs) < 0) {
+		stress_unmap_shared();
+		free_procs();
+		exit(EXIT_FAILURE);
+	}
+
 	/* Start thrasher process if required */
 	if (g_opt_flags & OPT_FLAGS_THRASH)
 		thrash_start();
 
-	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
+	if (scale_n) {
+		stress_run_scale_sweep(&duration,
+			&success, &resource_success);
+	} else if (repeat_runs) {
+		stress_run_repeat(repeat_runs, &duration,
+			&success, &resource_success);
+	} else if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
 		stress_run_sequential(&duration,
 			&success, &resource_success);
 	} else {
@@ -3941,8 +5079,15 @@ int main(int argc, char **argv)
 	/*
 	 *  Dump metrics
 	 */
-	if (g_opt_flags & OPT_FLAGS_METRICS)
+	if (g_opt_flags & OPT_FLAGS_METRICS) {
 		metrics_dump(yaml, ticks_per_sec);
+		startup_dump(yaml);
+	}
+
+	/*
+	 *  Dump scalability sweep
+	 */
+	scale_sweep_dump(yaml, procs_head);
 
 #if defined(STRESS_PERF_STATS)
 	/*
@@ -3950,6 +5095,7 @@ int main(int argc, char **argv)
 	 */
 	if (g_opt_flags & OPT_FLAGS_PERF_STATS)
 		perf_stat_dump(yaml, procs_head, duration);
+	perf_sample_dump(yaml, procs_head);
 #endif
 
 #if defined(STRESS_THERMAL_ZONES)
@@ -3961,6 +5107,22 @@ int main(int argc, char **argv)
 		tz_free(&g_shared->tz_info);
 	}
 #endif
+	/*
+	 *  Dump throughput time series
+	 */
+	sample_dump(yaml, procs_head);
+
+	/*
+	 *  Dump instance placement
+	 */
+	placement_dump(yaml, procs_head);
+
+	/*
+	 *  Save and compare against baselines
+	 */
+	compare_save();
+	regressions = compare_report(yaml);
+
 	/*
 	 *  Dump run times
 	 */
@@ -3970,6 +5132,16 @@ int main(int argc, char **argv)
 	/*
 	 *  Tidy up
 	 */
+	sample_free(procs_head);
+	scale_sweep_free(procs_head);
+	repeat_free(procs_head);
+	compare_free();
+	placement_free();
+	energy_free();
+	freq_free();
+#if defined(STRESS_PERF_STATS)
+	perf_sample_free(procs_head);
+#endif
 	free_procs();
 	proc_helper(proc_destroy, SIZEOF_ARRAY(proc_destroy));
 	stress_cache_free();
@@ -3991,6 +5163,10 @@ int main(int argc, char **argv)
 	 */
 	if (!success)
 		exit(EXIT_NOT_SUCCESS);
+	if (regressions < 0)
+		exit(EXIT_FAILURE);
+	if (regressions)
+		exit(EXIT_REGRESSION);
 	if (!resource_success)
 		exit(EXIT_NO_RESOURCE);
 	exit(EXIT_SUCCESS);
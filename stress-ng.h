@@ -151,6 +151,7 @@ typedef unsigned long int __kernel_ulong_t;
 #define EXIT_NO_RESOURCE	(3)
 #define EXIT_NOT_IMPLEMENTED	(4)
 #define EXIT_SIGNALED		(5)
+#define EXIT_REGRESSION		(6)
 
 /*
  * STRESS_ASSERT(test)
@@ -263,6 +264,13 @@ typedef unsigned long int __kernel_ulong_t;
 #define OPT_FLAGS_ABORT		 0x10000000000000ULL	/* --abort */
 #define OPT_FLAGS_CPU_ONLINE_ALL 0x20000000000000ULL	/* --cpu-online-all */
 #define OPT_FLAGS_SGX_VM_KEEP	 0x40000000000000ULL	/* Don't keep re-allocating */
+#define OPT_FLAGS_SGX_VM_COMMIT	 0x80000000000000ULL	/* --sgx-vm-commit */
+#define OPT_FLAGS_SYNC_START	 0x100000000000000ULL	/* --sync-start */
+#define OPT_FLAGS_SAMPLE_INSTANCES 0x200000000000000ULL	/* --sample-instances */
+#define OPT_FLAGS_LATENCY	 0x400000000000000ULL	/* --latency */
+#define OPT_FLAGS_THREADS	 0x800000000000000ULL	/* --threads */
+#define OPT_FLAGS_RATE		 0x1000000000000000ULL	/* --rate */
+#define OPT_FLAGS_ENERGY	 0x2000000000000000ULL	/* --energy */
 
 #define OPT_FLAGS_CACHE_MASK		\
 	(OPT_FLAGS_CACHE_FLUSH |	\
@@ -393,9 +401,34 @@ typedef union {
 /* Large prime to stride around large VM regions */
 #define PRIME_64		(0x8f0000000017116dULL)
 
+/*
+ *  Log-linear bogo op latency histogram, values below
+ *  STRESS_LAT_SUB ns are exact, above that each power of
+ *  two is split into STRESS_LAT_SUB buckets (~6% wide)
+ */
+#define STRESS_LAT_SUB_BITS	(4)
+#define STRESS_LAT_SUB		(1 << STRESS_LAT_SUB_BITS)
+#define STRESS_LAT_BUCKETS	((64 - STRESS_LAT_SUB_BITS + 1) * STRESS_LAT_SUB)
+
+typedef struct {
+	uint64_t count;			/* bogo ops timed */
+	uint64_t max;			/* slowest bogo op in ns */
+	uint64_t bucket[STRESS_LAT_BUCKETS];	/* bogo ops per bucket */
+} stress_lat_t;
+
+/* --rate schedule of an instance */
+typedef struct {
+	uint64_t start;			/* time the first bogo op was due in ns */
+	uint64_t next;			/* time the next bogo op is due in ns */
+	uint64_t issued;		/* bogo ops issued */
+	uint64_t missed;		/* bogo ops issued after the next was due */
+} stress_rate_t;
+
 /* stressor args */
 typedef struct {
 	uint64_t *const counter;	/* stressor counter */
+	stress_lat_t *const lat;	/* latency histogram, NULL if not --latency */
+	stress_rate_t *const rate;	/* --rate schedule, NULL if closed loop */
 	const char *name;		/* stressor name */
 	const uint64_t max_ops;		/* max number of bogo ops */
 	const uint32_t instance;	/* stressor instance # */
@@ -501,6 +534,14 @@ typedef struct {
 #define ALIGN_CACHELINE ALIGN64
 #endif
 
+/* Function multiversioning, AVX2 clone picked at load time if supported */
+#if defined(__GNUC__) && !defined(__clang__) && NEED_GNUC(6,0,0) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define TARGET_CLONES_AVX2	__attribute__((target_clones("avx2","default")))
+#else
+#define TARGET_CLONES_AVX2
+#endif
+
 /* GCC hot attribute */
 #if defined(__GNUC__) && NEED_GNUC(4,6,0)
 #define HOT		__attribute__ ((hot))
@@ -624,6 +665,10 @@ extern void pr_fail_dbg__(const args_t *args, const char *msg);
 #define MAX_CLONES		(1000000)
 #define DEFAULT_CLONES		(8192)
 
+#define MIN_COMPARE_THRESHOLD	(1)
+#define MAX_COMPARE_THRESHOLD	(100)
+#define DEFAULT_COMPARE_THRESHOLD (5)
+
 #define MIN_COPY_FILE_BYTES	(128 * MB)
 #define MAX_COPY_FILE_BYTES	(256ULL * GB)
 #define DEFAULT_COPY_FILE_BYTES	(256 * MB)
@@ -822,11 +867,48 @@ extern void pr_fail_dbg__(const args_t *args, const char *msg);
 #endif
 #define DEFAULT_SEEK_SIZE	(16 * MB)
 
+#define MIN_SAMPLE_INTERVAL	(1)
+#define MAX_SAMPLE_INTERVAL	(3600)
+
+#define MAX_SCALE_SWEEP		(32)
+
+#define MIN_PERF_SAMPLE		(1)
+#define MAX_PERF_SAMPLE		(100000)
+#define MIN_PERF_SAMPLE_TOP	(1)
+#define MAX_PERF_SAMPLE_TOP	(1000)
+#define DEFAULT_PERF_SAMPLE_TOP	(10)
+
+#define MIN_RATE		(1)
+#define MAX_RATE		(100000000)
+
+#define MIN_REPEAT		(1)
+#define MAX_REPEAT		(1000)
+#define DEFAULT_UNTIL_CI_REPEAT	(30)
+
+#define MIN_WARMUP		(1)
+#define MAX_WARMUP		(3600)
+
 #define MIN_SEQUENTIAL		(0)
 #define MAX_SEQUENTIAL		(1000000)
 #define DEFAULT_SEQUENTIAL	(0)	/* Disabled */
 #define DEFAULT_PARALLEL	(0)	/* Disabled */
 
+#define MIN_SGX_OPS_PER_ECALL	(0)	/* 0 = one ECALL for the whole run */
+#define MAX_SGX_OPS_PER_ECALL	(100000000)
+#define DEFAULT_SGX_OPS_PER_ECALL (0)
+
+#define MIN_SGX_LOCK_THREADS	(2)
+#define MAX_SGX_LOCK_THREADS	(16)	/* TCSNum - 1 in lock.config.xml */
+#define DEFAULT_SGX_LOCK_THREADS (4)
+
+#define MIN_SGX_VM_THREADS	(1)
+#define MAX_SGX_VM_THREADS	(16)	/* TCSNum - 1 in vm_threads.config.xml */
+#define DEFAULT_SGX_VM_THREADS	(1)
+
+#define MIN_SGX_SYSCALL_BYTES	(1)
+#define MAX_SGX_SYSCALL_BYTES	(4 * MB)
+#define DEFAULT_SGX_SYSCALL_BYTES (4 * KB)
+
 #define MIN_SHM_SYSV_BYTES	(1 * MB)
 #define MAX_SHM_SYSV_BYTES	(256 * MB)
 #define DEFAULT_SHM_SYSV_BYTES	(8 * MB)
@@ -935,6 +1017,7 @@ extern void pr_fail_dbg__(const args_t *args, const char *msg);
 
 #define TIMEOUT_NOT_SET		(~0ULL)
 #define DEFAULT_TIMEOUT		(60 * 60 * 24)
+#define START_BARRIER_TIMEOUT	(60.0)	/* seconds to wait for instances at the start barrier */
 #define DEFAULT_BACKOFF		(0)
 #define DEFAULT_LINKS		(8192)
 #define DEFAULT_DIRS		(8192)
@@ -1044,6 +1127,64 @@ static inline void ALWAYS_INLINE inc_counter(const args_t *args)
 	(*(args->counter))++;
 }
 
+/*
+ *  stress_lat_now()
+ *	monotonic time in ns to start timing a bogo op,
+ *	0 when --latency is not enabled
+ */
+static inline uint64_t ALWAYS_INLINE stress_lat_now(const args_t *args)
+{
+	struct timespec ts;
+
+	if (!args->lat || (clock_gettime(CLOCK_MONOTONIC, &ts) < 0))
+		return 0;
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+extern uint64_t stress_rate_wait(const args_t *args);
+
+/*
+ *  stress_lat_start()
+ *	time to start timing a bogo op from, with --rate this
+ *	waits for the bogo op to be due and is when it was due
+ *	so that time spent behind schedule counts as latency
+ */
+static inline uint64_t ALWAYS_INLINE stress_lat_start(const args_t *args)
+{
+	return args->rate ? stress_rate_wait(args) : stress_lat_now(args);
+}
+
+/*
+ *  stress_lat_index()
+ *	histogram bucket of a latency in ns
+ */
+static inline uint32_t ALWAYS_INLINE stress_lat_index(const uint64_t ns)
+{
+	uint32_t shift;
+
+	if (ns < STRESS_LAT_SUB)
+		return (uint32_t)ns;
+	shift = 63 - __builtin_clzll(ns) - STRESS_LAT_SUB_BITS;
+	return ((shift + 1) << STRESS_LAT_SUB_BITS) +
+		(uint32_t)((ns >> shift) & (STRESS_LAT_SUB - 1));
+}
+
+/*
+ *  stress_lat_record()
+ *	add the latency of one bogo op in ns to the histogram
+ */
+static inline void ALWAYS_INLINE stress_lat_record(const args_t *args, const uint64_t ns)
+{
+	stress_lat_t *const lat = args->lat;
+
+	if (!lat)
+		return;
+	lat->bucket[stress_lat_index(ns)]++;
+	lat->count++;
+	if (ns > lat->max)
+		lat->max = ns;
+}
+
 /* pthread porting shims, spinlock or fallback to mutex */
 #if defined(HAVE_LIB_PTHREAD)
 #if defined(HAVE_LIB_PTHREAD_SPINLOCK)
@@ -1073,6 +1214,9 @@ typedef struct {
 } mwc_t;
 
 
+/* perf counters sampled every --sample-interval */
+#define PERF_SERIES_MAX		(6)
+
 /* perf related constants */
 #if defined(HAVE_LIB_PTHREAD) && \
     defined(__linux__) &&	 \
@@ -1083,8 +1227,11 @@ typedef struct {
 
 /* per perf counter info */
 typedef struct {
-	uint64_t counter;		/* perf counter */
+	uint64_t counter;		/* perf counter, scaled if multiplexed */
+	uint64_t time_enabled;		/* ns the group was enabled */
+	uint64_t time_running;		/* ns the group was on the PMU */
 	int	 fd;			/* perf per counter fd */
+	int	 leader;		/* index of the group leader, -1 if not open */
 } perf_stat_t;
 
 /* per stressor perf info */
@@ -1092,6 +1239,11 @@ typedef struct {
 	perf_stat_t	perf_stat[STRESS_PERF_MAX]; /* perf counters */
 	int		perf_opened;	/* count of opened counters */
 } stress_perf_t;
+
+/* per instance --sample-interval perf counters */
+typedef struct {
+	perf_stat_t	perf_stat[PERF_SERIES_MAX]; /* counters at the last read */
+} perf_series_t;
 #endif
 
 /* linux thermal zones */
@@ -1118,9 +1270,80 @@ typedef struct {
 } stress_tz_t;
 #endif
 
+/* Per method accounting of the sgx and sgx-vm enclaves */
+#define STRESS_SGX_METHODS_MAX		(96)
+#define STRESS_SGX_METHOD_NAME_LEN	(32)
+
+typedef struct {
+	char name[STRESS_SGX_METHOD_NAME_LEN];	/* method name, "" = unused */
+	uint64_t ops;			/* bogo ops run by method */
+	uint64_t nsec;			/* time spent in method */
+} sgx_method_stats_t;
+
+/* sgx-syscall operation mix, keep in sync with the enclave's companion.h */
+#define SGX_SYSCALL_WRITE	(0x01)	/* pwrite the buffer */
+#define SGX_SYSCALL_READ	(0x02)	/* pread the buffer */
+#define SGX_SYSCALL_FSTAT	(0x04)	/* fstat the file */
+
+/* sgx-exception triggers, keep in sync with the enclave's companion.h */
+#define SGX_TRIGGER_DIV0	(0x01)	/* integer divide by zero, #DE */
+#define SGX_TRIGGER_UD2		(0x02)	/* undefined instruction, #UD */
+
+/* sgx-lock primitives, keep in sync with the enclave's companion.h */
+#define SGX_LOCK_MUTEX		(0)	/* sgx_thread_mutex_t */
+#define SGX_LOCK_SPIN		(1)	/* sgx_spinlock_t */
+#define SGX_LOCK_ATOMIC		(2)	/* lock-free atomic add */
+#define SGX_LOCK_CONDVAR	(3)	/* producer/consumer on sgx_thread_cond_t */
+#define SGX_LOCK_MAX		(4)
+
+/* sgx-syscall and sgx-exception loops run in the enclave and natively */
+#define SGX_RUN_ENCLAVE		(0)
+#define SGX_RUN_NATIVE		(1)
+
+typedef struct {
+	uint64_t syscalls;		/* system calls issued */
+	uint64_t bytes;			/* bytes read and written */
+	uint64_t nsec;			/* time spent issuing them */
+} sgx_syscall_stats_t;
+
+typedef struct {
+	uint64_t exceptions;		/* exceptions raised and handled */
+	uint64_t nsec;			/* time spent raising them */
+} sgx_exception_stats_t;
+
+typedef struct {
+	uint64_t ops;			/* lock protected increments */
+	uint64_t nsec;			/* time spent contending */
+	uint64_t sleeps;		/* wait untrusted event OCALLs */
+	uint64_t wakes;			/* set untrusted event OCALLs */
+} sgx_lock_stats_t;
+
+/* sgx-vm first touch size buckets, keep in sync with the enclave's companion.h */
+#define SGX_VM_COMMIT_SIZES	(32)
+
+typedef struct {
+	uint64_t touches;		/* first touch passes */
+	uint64_t pages;			/* pages touched */
+	uint64_t nsec;			/* time spent touching them */
+} sgx_commit_stats_t;
+
+typedef struct {
+	uint64_t bytes;			/* bytes compared by verify phases */
+	uint64_t nsec;			/* time spent verifying them */
+} sgx_verify_stats_t;
+
+typedef struct {
+	uint64_t passes;		/* method passes over the slice */
+	uint64_t bytes;			/* slice bytes times passes */
+	uint64_t bit_errors;		/* bit errors found in the slice */
+	uint64_t nsec;			/* time spent in the enclave */
+} sgx_vm_thread_stats_t;
+
 /* Per process statistics and accounting info */
 typedef struct {
 	uint64_t counter;		/* number of bogo ops */
+	stress_lat_t lat;		/* --latency histogram */
+	stress_rate_t rate;		/* --rate schedule */
 	struct tms tms;			/* run time stats of process */
 	double start;			/* wall clock start time */
 	double finish;			/* wall clock stop time */
@@ -1130,7 +1353,13 @@ typedef struct {
 #if defined(STRESS_THERMAL_ZONES)
 	stress_tz_t tz;			/* thermal zones */
 #endif
+	long maxrss;			/* peak RSS of the process in KB */
+	uint64_t pss;			/* PSS of the process at exit in KB */
+	char placement[64];		/* --placement CPUs of the instance */
+	uint64_t warmup_counter;	/* counter at the end of --warmup */
+	double warmup_time;		/* wall clock end of --warmup */
 	bool run_ok;			/* true if stressor exited OK */
+	volatile uint32_t ready;	/* at the start barrier, set once */
 } proc_stats_t;
 
 /* The stress-ng global shared memory segment */
@@ -1158,6 +1387,9 @@ typedef struct {
 		uint32_t futex[STRESS_PROCS_MAX];	/* Shared futexes */
 		uint64_t timeout[STRESS_PROCS_MAX];	/* Shared futex timeouts */
 	} futex;
+	struct {
+		uint32_t futex;				/* Start barrier release futex */
+	} sync_start;
 #if defined(HAVE_LIB_PTHREAD) && (HAVE_SEM_POSIX)
 	struct {
 		sem_t sem;				/* Shared posix semaphores */
@@ -1181,6 +1413,19 @@ typedef struct {
 #if defined(HAVE_ATOMIC)
 	uint32_t softlockup_count;			/* Atomic counter of softlock children */
 #endif
+	struct {
+		sgx_method_stats_t cpu[STRESS_SGX_METHODS_MAX];	/* sgx per method stats */
+		sgx_method_stats_t vm[STRESS_SGX_METHODS_MAX];	/* sgx-vm per method stats */
+		sgx_commit_stats_t commit[SGX_VM_COMMIT_SIZES];	/* sgx-vm first touch by size */
+		sgx_verify_stats_t vm_verify;		/* sgx-vm verify phases */
+		sgx_vm_thread_stats_t vm_thread[MAX_SGX_VM_THREADS];/* sgx-vm per enclave thread */
+		sgx_syscall_stats_t syscall[2];		/* sgx-syscall enclave vs native */
+		sgx_exception_stats_t exception[2];	/* sgx-exception enclave vs native */
+		sgx_lock_stats_t primitive[SGX_LOCK_MAX];/* sgx-lock per primitive */
+#if defined(HAVE_LIB_PTHREAD)
+		shim_pthread_spinlock_t lock;		/* protects sgx stats */
+#endif
+	} sgx;
 	proc_stats_t stats[0];				/* Shared statistics */
 } shared_t;
 
@@ -1330,6 +1575,9 @@ typedef enum {
 	STRESS_SEMAPHORE_SYSV,
 	STRESS_SENDFILE,
 	STRESS_SGX,
+	STRESS_SGX_EXCEPTION,
+	STRESS_SGX_LOCK,
+	STRESS_SGX_SYSCALL,
 	STRESS_SGX_VM,
 	STRESS_SHM_POSIX,
 	STRESS_SHM_SYSV,
@@ -1388,6 +1636,19 @@ typedef enum {
 	STRESS_MAX
 } stress_id_t;
 
+/*
+ *  stress_sgx_stressor()
+ *	true if the stressor runs in an SGX enclave
+ */
+static inline bool stress_sgx_stressor(const stress_id_t id)
+{
+	return (id == STRESS_SGX) ||
+	       (id == STRESS_SGX_EXCEPTION) ||
+	       (id == STRESS_SGX_LOCK) ||
+	       (id == STRESS_SGX_SYSCALL) ||
+	       (id == STRESS_SGX_VM);
+}
+
 /* Command line long options */
 typedef enum {
 	/* Short options */
@@ -1455,6 +1716,8 @@ typedef enum {
 	OPT_ATOMIC,
 	OPT_ATOMIC_OPS,
 
+	OPT_BASELINE,
+
 	OPT_BRANCH,
 	OPT_BRANCH_OPS,
 
@@ -1504,6 +1767,9 @@ typedef enum {
 	OPT_CLONE_OPS,
 	OPT_CLONE_MAX,
 
+	OPT_COMPARE,
+	OPT_COMPARE_THRESHOLD,
+
 	OPT_CONTEXT,
 	OPT_CONTEXT_OPS,
 
@@ -1561,6 +1827,8 @@ typedef enum {
 	OPT_DUP,
 	OPT_DUP_OPS,
 
+	OPT_ENERGY,
+
 	OPT_EPOLL,
 	OPT_EPOLL_OPS,
 	OPT_EPOLL_PORT,
@@ -1606,6 +1874,8 @@ typedef enum {
 	OPT_FP_ERROR,
 	OPT_FP_ERROR_OPS,
 
+	OPT_FREQ,
+
 	OPT_FSTAT,
 	OPT_FSTAT_OPS,
 	OPT_FSTAT_DIR,
@@ -1694,6 +1964,8 @@ typedef enum {
 	OPT_KLOG,
 	OPT_KLOG_OPS,
 
+	OPT_LATENCY,
+
 	OPT_LEASE,
 	OPT_LEASE_OPS,
 	OPT_LEASE_BREAKERS,
@@ -1849,6 +2121,11 @@ typedef enum {
 	OPT_PATHOLOGICAL,
 
 	OPT_PERF_STATS,
+	OPT_PERF_SAMPLE,
+	OPT_PERF_SAMPLE_CALLCHAIN,
+	OPT_PERF_SAMPLE_TOP,
+
+	OPT_PLACEMENT,
 
 	OPT_PERSONALITY,
 	OPT_PERSONALITY_OPS,
@@ -1888,6 +2165,9 @@ typedef enum {
 	OPT_RAWDEV_METHOD,
 	OPT_RAWDEV_OPS,
 
+	OPT_RATE,
+	OPT_RATE_PROFILE,
+
 	OPT_RDRAND,
 	OPT_RDRAND_OPS,
 
@@ -1900,6 +2180,8 @@ typedef enum {
 
 	OPT_RENAME_OPS,
 
+	OPT_REPEAT,
+
 	OPT_RESOURCES,
 	OPT_RESOURCES_OPS,
 
@@ -1912,6 +2194,12 @@ typedef enum {
 	OPT_RTC,
 	OPT_RTC_OPS,
 
+	OPT_SAMPLE_INTERVAL,
+	OPT_SAMPLE_FILE,
+	OPT_SAMPLE_INSTANCES,
+
+	OPT_SCALE_SWEEP,
+
 	OPT_SCHED,
 	OPT_SCHED_PRIO,
 
@@ -1949,12 +2237,31 @@ typedef enum {
 	OPT_SGX,
 	OPT_SGX_OPS,
 	OPT_SGX_METHOD,
+	OPT_SGX_OPS_PER_ECALL,
+	OPT_SGX_LOAD,
+	OPT_SGX_LOAD_SLICE,
+
+	OPT_SGX_EXCEPTION,
+	OPT_SGX_EXCEPTION_OPS,
+	OPT_SGX_EXCEPTION_METHOD,
+
+	OPT_SGX_LOCK,
+	OPT_SGX_LOCK_OPS,
+	OPT_SGX_LOCK_METHOD,
+	OPT_SGX_LOCK_THREADS,
+
+	OPT_SGX_SYSCALL,
+	OPT_SGX_SYSCALL_OPS,
+	OPT_SGX_SYSCALL_BYTES,
+	OPT_SGX_SYSCALL_MIX,
 
 	OPT_SGX_VM,
 	OPT_SGX_VM_BYTES,
+	OPT_SGX_VM_COMMIT,
 	OPT_SGX_VM_HANG,
 	OPT_SGX_VM_KEEP,
 	OPT_SGX_VM_OPS,
+	OPT_SGX_VM_THREADS,
 	OPT_SGX_VM_METHOD,
 
 	OPT_SHM_POSIX,
@@ -2048,6 +2355,8 @@ typedef enum {
 	OPT_SYNC_FILE_OPS,
 	OPT_SYNC_FILE_BYTES,
 
+	OPT_SYNC_START,
+
 	OPT_SYSINFO,
 	OPT_SYSINFO_OPS,
 
@@ -2067,6 +2376,8 @@ typedef enum {
 
 	OPT_THRASH,
 
+	OPT_THREADS,
+
 	OPT_TIMER_SLACK,
 
 	OPT_TIMER_OPS,
@@ -2111,6 +2422,8 @@ typedef enum {
 	OPT_UNSHARE,
 	OPT_UNSHARE_OPS,
 
+	OPT_UNTIL_CI,
+
 	OPT_URANDOM_OPS,
 
 	OPT_USERFAULTFD,
@@ -2153,6 +2466,8 @@ typedef enum {
 	OPT_WAIT,
 	OPT_WAIT_OPS,
 
+	OPT_WARMUP,
+
 	OPT_WCS,
 	OPT_WCS_OPS,
 	OPT_WCS_METHOD,
@@ -2184,6 +2499,24 @@ typedef struct {
 	const uint32_t class;		/* class of stress test */
 } stress_t;
 
+/* One --sample-interval throughput sample */
+typedef struct {
+	double time;			/* seconds since the run started */
+	double rate;			/* bogo ops per second */
+	double watts;			/* --energy average power, or < 0 */
+	double perf[PERF_SERIES_MAX];	/* --perf counts per second, or < 0 */
+} sample_t;
+
+/* Size of a stressor's --perf-sample hot spot table, a power of 2 */
+#define PERF_SAMPLE_HOT_MAX	(1024)
+
+/* --perf-sample samples of a function */
+typedef struct {
+	uint32_t key;			/* symbol id + 1, 0 if free */
+	uint64_t self;			/* samples in the function */
+	uint64_t total;			/* samples with it in the call chain */
+} perf_hot_t;
+
 /* Per process information */
 typedef struct proc_info {
 	struct proc_info *next;		/* next proc info struct in list */
@@ -2194,6 +2527,27 @@ typedef struct proc_info {
 	int32_t started_procs;		/* count of started processes */
 	int32_t num_procs;		/* number of process per stressor */
 	uint64_t bogo_ops;		/* number of bogo ops */
+	uint64_t *sample_counters;	/* counters at the last sample */
+	sample_t *samples;		/* ops/s time series */
+	size_t samples_n;		/* samples taken */
+	size_t samples_max;		/* samples allocated */
+#if defined(STRESS_PERF_STATS)
+	perf_series_t *perf_series;	/* --perf counters of each instance */
+#endif
+	double *scale_rates;		/* --scale-sweep ops/s per instance count */
+	double *repeat_rates;		/* --repeat ops/s of each run */
+	size_t repeat_n;		/* runs done */
+	double energy;			/* --energy joules used during the run */
+	double energy_secs;		/* --energy wall clock time of the run */
+#if defined(__linux__) && defined(HAVE_AFFINITY)
+	cpu_set_t freq_cpus;		/* --freq CPUs the instances can run on */
+#endif
+	double freq_ghz;		/* --freq effective GHz, 0 if unknown */
+	int64_t freq_throttle;		/* --freq throttle events, -1 if unknown */
+	perf_hot_t *perf_hot;		/* --perf-sample hot spot table */
+	uint64_t perf_samples;		/* --perf-sample samples taken */
+	uint64_t perf_lost;		/* --perf-sample samples lost */
+	uint64_t perf_other;		/* samples beyond the hot spot or process table */
 } proc_info_t;
 
 /* Pointer to current running stressor proc info */
@@ -2418,6 +2772,20 @@ extern int perf_close(stress_perf_t *sp);
 extern bool perf_stat_succeeded(const stress_perf_t *sp);
 extern void perf_stat_dump(FILE *yaml, proc_info_t *procs_head, const double duration);
 extern void perf_init(void);
+extern int perf_energy_open(void);
+extern bool perf_energy_read(double *joules);
+extern void perf_energy_close(void);
+extern const char *perf_series_label(const size_t i);
+extern void perf_series_open(perf_series_t *ps, const pid_t pid);
+extern void perf_series_read(perf_series_t *ps, double *counts);
+extern void perf_series_close(perf_series_t *ps);
+extern void stress_set_perf_sample(const char *opt);
+extern void stress_set_perf_sample_top(const char *opt);
+extern void stress_set_perf_sample_callchain(void);
+extern void perf_sample_start(proc_info_t *procs_list);
+extern void perf_sample_stop(void);
+extern void perf_sample_dump(FILE *yaml, proc_info_t *procs_head);
+extern void perf_sample_free(proc_info_t *procs_head);
 #endif
 
 /* Misc settings helpers */
@@ -2494,6 +2862,7 @@ extern WARN_UNUSED void *align_address(const void *addr, const size_t alignment)
 extern void mmap_set(uint8_t *buf, const size_t sz, const size_t page_size);
 extern WARN_UNUSED int mmap_check(uint8_t *buf, const size_t sz, const size_t page_size);
 extern WARN_UNUSED uint64_t stress_get_phys_mem_size(void);
+extern uint64_t stress_get_pss(void);
 extern WARN_UNUSED uint64_t stress_get_filesystem_size(void);
 extern WARN_UNUSED uint64_t stress_get_filesystem_available_inodes(void);
 extern char *stress_uint64_to_str(char *str, size_t len, const uint64_t val);
@@ -2538,6 +2907,22 @@ static inline WARN_UNUSED uint32_t warn_once(const uint32_t flag)
 	return tmp;
 }
 
+/* Baseline comparison */
+enum {
+	COMPARE_NEUTRAL = 0,		/* neither direction is better */
+	COMPARE_HIGHER,			/* higher is better */
+	COMPARE_LOWER,			/* lower is better */
+};
+
+extern void stress_set_compare_threshold(const char *opt);
+extern bool compare_init(void);
+extern void compare_add(const char *stressor, const char *metric,
+	const int better, const double value);
+extern void compare_save(void);
+extern int compare_report(FILE *yaml);
+extern void compare_free(void);
+extern double compare_t_crit(const double alpha, const double df);
+
 /* Jobfile parsing */
 extern WARN_UNUSED int parse_jobfile(int argc, char **argv, const char *jobfile);
 extern WARN_UNUSED int parse_opts(int argc, char **argv, const bool jobmode);
@@ -2550,6 +2935,61 @@ extern int mincore_touch_pages(void *buf, const size_t buf_len);
 extern void mount_free(char *mnts[], const int n);
 extern WARN_UNUSED int mount_get(char *mnts[], const int max);
 
+/* Topology aware instance placement */
+extern int stress_set_placement(const char *name);
+extern void placement_init(void);
+extern void placement_set(const uint32_t instance, char *cpus, const size_t len);
+extern void placement_dump(FILE *yaml, proc_info_t *procs_head);
+extern void placement_free(void);
+
+/* RAPL energy accounting */
+extern int energy_init(void);
+extern bool energy_read(double *joules);
+extern void energy_start(void);
+extern void energy_stop(proc_info_t *procs_list);
+extern void energy_metrics_dump(FILE *yaml, const proc_info_t *pi);
+extern void energy_free(void);
+
+/* CPU frequency */
+extern void stress_set_freq(void);
+extern void freq_init(void);
+extern void freq_start(proc_info_t *procs_list);
+extern void freq_stop(proc_info_t *procs_list);
+extern void freq_metrics_dump(FILE *yaml, const proc_info_t *pi);
+extern void freq_free(void);
+
+/* Open loop target rate */
+extern void stress_set_rate(const char *opt);
+extern int stress_set_rate_profile(const char *name);
+extern void rate_metrics_dump(FILE *yaml, const proc_info_t *pi);
+
+/* Repeated runs */
+extern void stress_set_repeat(const char *opt);
+extern void stress_set_until_ci(const char *opt);
+extern void stress_set_warmup(const char *opt);
+extern int repeat_init(uint32_t *runs);
+extern void repeat_warmup_start(proc_info_t *procs_list);
+extern void repeat_warmup_stop(void);
+extern bool repeat_add(proc_info_t *procs_list, const uint32_t max_runs);
+extern size_t repeat_stats(const proc_info_t *pi, double *mean,
+	double *ci, double *cv);
+extern void repeat_free(proc_info_t *procs_head);
+
+/* Scalability sweep */
+extern void stress_set_scale_sweep(const char *opt);
+extern size_t scale_sweep_counts(const uint32_t **counts);
+extern void scale_sweep_add(proc_info_t *pi, const size_t i);
+extern void scale_sweep_dump(FILE *yaml, proc_info_t *procs_head);
+extern void scale_sweep_free(proc_info_t *procs_head);
+
+/* Throughput time series */
+extern void stress_set_sample_interval(const char *opt);
+extern void sample_start(proc_info_t *procs_list);
+extern void sample_stop(void);
+extern void sample_instance_start(proc_info_t *pi, const int32_t j);
+extern void sample_dump(FILE *yaml, proc_info_t *procs_head);
+extern void sample_free(proc_info_t *procs_head);
+
 /* Thermal Zones */
 #if defined(STRESS_THERMAL_ZONES)
 extern int tz_init(tz_info_t **tz_info_list);
@@ -2683,11 +3123,24 @@ extern void stress_set_seek_size(const char *opt);
 extern void stress_set_semaphore_posix_procs(const char *opt);
 extern void stress_set_semaphore_sysv_procs(const char *opt);
 extern void stress_set_sendfile_size(const char *opt);
+extern void stress_sgx_ready(const args_t *args);
+extern void stress_sgx_method_stats_add(sgx_method_stats_t *stats,
+	const uint64_t *ops, const uint64_t *nsec, const char *names,
+	const int n, const int shift);
 extern int  stress_set_sgx_method(const char *name);
+extern void stress_set_sgx_ops_per_ecall(const char *opt);
+extern int  stress_set_sgx_exception_method(const char *name);
+extern int  stress_set_sgx_lock_method(const char *name);
+extern void stress_set_sgx_load(const char *opt);
+extern void stress_set_sgx_load_slice(const char *opt);
+extern void stress_set_sgx_lock_threads(const char *opt);
+extern void stress_set_sgx_syscall_bytes(const char *opt);
+extern int  stress_set_sgx_syscall_mix(const char *name);
 extern void stress_set_sgx_vm_bytes(const char *opt);
 extern void stress_set_sgx_vm_flags(const int flag);
 extern void stress_set_sgx_vm_hang(const char *opt);
 extern int  stress_set_sgx_vm_method(const char *name);
+extern void stress_set_sgx_vm_threads(const char *opt);
 extern void stress_set_shm_posix_bytes(const char *opt);
 extern void stress_set_shm_posix_objects(const char *opt);
 extern void stress_set_shm_sysv_bytes(const char *opt);
@@ -3011,6 +3464,9 @@ STRESS(stress_sem);
 STRESS(stress_sem_sysv);
 STRESS(stress_sendfile);
 STRESS(stress_sgx);
+STRESS(stress_sgx_exception);
+STRESS(stress_sgx_lock);
+STRESS(stress_sgx_syscall);
 STRESS(stress_sgx_vm);
 STRESS(stress_shm);
 STRESS(stress_shm_sysv);
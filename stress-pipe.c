@@ -208,8 +208,10 @@ again:
 
 		do {
 			ssize_t ret;
+			uint64_t t;
 
 			pipe_memset(buf, val++, pipe_data_size);
+			t = stress_lat_start(args);
 			ret = write(pipefds[1], buf, pipe_data_size);
 			if (ret <= 0) {
 				if ((errno == EAGAIN) || (errno == EINTR))
@@ -220,6 +222,7 @@ again:
 				}
 				continue;
 			}
+			stress_lat_record(args, stress_lat_now(args) - t);
 			inc_counter(args);
 		} while (keep_stressing());
 
@@ -93,6 +93,8 @@ static void semaphore_posix_thrash(const args_t *args)
 		timeout.tv_sec++;
 
 		for (i = 0; i < 1000; i++) {
+			const uint64_t t = stress_lat_now(args);
+
 			if (sem_timedwait(&g_shared->sem_posix.sem, &timeout) < 0) {
 				if (errno == ETIMEDOUT)
 					goto timed_out;
@@ -100,6 +102,7 @@ static void semaphore_posix_thrash(const args_t *args)
 					pr_fail_dbg("sem_wait");
 				break;
 			}
+			stress_lat_record(args, stress_lat_now(args) - t);
 			inc_counter(args);
 			if (sem_post(&g_shared->sem_posix.sem) < 0) {
 				pr_fail_dbg("sem_post");
@@ -0,0 +1,203 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+#include "sgx/utils.h"
+#include "sgx/enclave_cpu/untrusted/enclave_u.h"
+
+/* Exceptions per ECALL, each batch is followed by as many native ones */
+#define SGX_EXCEPTION_BATCH	(1024)
+
+typedef struct {
+	const char *name;		/* method name */
+	const uint32_t triggers;	/* SGX_TRIGGER_* exceptions raised */
+} sgx_exception_method_t;
+
+static const sgx_exception_method_t sgx_exception_methods[] = {
+	{ "all",	SGX_TRIGGER_DIV0 | SGX_TRIGGER_UD2 },
+	{ "div0",	SGX_TRIGGER_DIV0 },
+	{ "ud2",	SGX_TRIGGER_UD2 },
+	{ NULL,		0 }
+};
+
+static sigjmp_buf jmp_env;
+
+/*
+ *  stress_set_sgx_exception_method()
+ *	set the exceptions to raise
+ */
+int stress_set_sgx_exception_method(const char *name)
+{
+	const sgx_exception_method_t *info;
+
+	for (info = sgx_exception_methods; info->name; info++) {
+		if (!strcmp(info->name, name)) {
+			set_setting("sgx-exception-method", TYPE_ID_UINT32,
+				&info->triggers);
+			return 0;
+		}
+	}
+
+	(void)fprintf(stderr, "sgx-exception-method must be one of:");
+	for (info = sgx_exception_methods; info->name; info++)
+		(void)fprintf(stderr, " %s", info->name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_sgx_exception_handler()
+ *	SIGFPE and SIGILL handler
+ */
+static void MLOCKED stress_sgx_exception_handler(int dummy)
+{
+	(void)dummy;
+
+	siglongjmp(jmp_env, 1);		/* Ugly, bounce back */
+}
+
+/*
+ *  stress_sgx_exception_trigger()
+ *	raise a #DE or #UD, the same instructions as in the enclave,
+ *	alternating between them by sequence number if both are set
+ */
+static inline void stress_sgx_exception_trigger(
+	const uint32_t triggers,
+	const uint64_t seq)
+{
+	uint32_t trigger = triggers;
+
+	if (triggers == (SGX_TRIGGER_DIV0 | SGX_TRIGGER_UD2))
+		trigger = (seq & 1) ? SGX_TRIGGER_UD2 : SGX_TRIGGER_DIV0;
+
+	if (trigger == SGX_TRIGGER_DIV0) {
+		uint32_t a = 1, d = 0;
+
+		__asm__ __volatile__("divl %2"
+			: "+a" (a), "+d" (d)
+			: "c" (0)
+			: "cc");
+	} else {
+		__asm__ __volatile__("ud2");
+	}
+}
+
+/*
+ *  stress_sgx_exception_native()
+ *	raise n exceptions natively, returns the number handled
+ */
+static uint64_t stress_sgx_exception_native(
+	const uint32_t triggers,
+	const uint64_t counter,
+	const uint64_t n)
+{
+	static volatile uint64_t handled;
+	volatile uint64_t i;
+
+	handled = 0;
+	for (i = counter; (i < counter + n) && g_keep_stressing_flag; i++) {
+		if (sigsetjmp(jmp_env, 1))
+			handled++;	/* SIGFPE or SIGILL occurred */
+		else
+			stress_sgx_exception_trigger(triggers, i);
+	}
+	return handled;
+}
+
+/*
+ *  stress_sgx_exception
+ *	stress exception handling inside an enclave, where every
+ *	exception costs an AEX and a trip through the trts dispatcher,
+ *	and compare it with signal based handling natively
+ */
+int stress_sgx_exception(const args_t *args)
+{
+	uint32_t triggers = SGX_TRIGGER_DIV0 | SGX_TRIGGER_UD2;
+	sgx_exception_stats_t stats[2];
+	sgx_enclave_id_t eid = 0;
+	sgx_status_t status;
+	sgx_log_t *log;
+	int i, ret = 0;
+
+	(void)get_setting("sgx-exception-method", &triggers);
+	(void)memset(stats, 0, sizeof(stats));
+
+	if (stress_sighandler(args->name, SIGFPE, stress_sgx_exception_handler, NULL) < 0)
+		return EXIT_FAILURE;
+	if (stress_sighandler(args->name, SIGILL, stress_sgx_exception_handler, NULL) < 0)
+		return EXIT_FAILURE;
+
+	status = initialize_enclave(&eid, ENCLAVE_CPU_FILENAME, TOKEN_CPU_FILENAME);
+	stress_sgx_ready(args);
+	if (status != SGX_SUCCESS) {
+		printf("Error %d\n", status);
+		return EXIT_FAILURE;
+	}
+
+	log = sgx_log_start(!!(g_opt_flags & PR_DEBUG));
+	if (log)
+		(void)ecall_set_log_ring(eid, &ret, &log->ring);
+
+	do {
+		const uint64_t counter = *args->counter;
+		uint64_t rounds = counter + SGX_EXCEPTION_BATCH, n;
+		double t;
+
+		if (args->max_ops && (rounds > args->max_ops))
+			rounds = args->max_ops;
+
+		t = time_now();
+		status = ecall_stress_exception(eid, &ret, triggers, rounds,
+			args->counter, (bool *)&g_keep_stressing_flag, g_opt_flags);
+		stats[SGX_RUN_ENCLAVE].nsec +=
+			(uint64_t)((time_now() - t) * 1000000000.0);
+		if (status != SGX_SUCCESS) {
+			print_error_message(status);
+			break;
+		}
+		n = *args->counter - counter;
+		stats[SGX_RUN_ENCLAVE].exceptions += n;
+		if (ret < 0)
+			break;
+
+		/* Same exceptions again, handled by signals */
+		t = time_now();
+		stats[SGX_RUN_NATIVE].exceptions +=
+			stress_sgx_exception_native(triggers, counter, n);
+		stats[SGX_RUN_NATIVE].nsec +=
+			(uint64_t)((time_now() - t) * 1000000000.0);
+	} while (keep_stressing());
+
+	sgx_destroy_enclave(eid);
+	sgx_log_stop(log);
+
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_lock(&g_shared->sgx.lock);
+#endif
+	for (i = 0; i < 2; i++) {
+		g_shared->sgx.exception[i].exceptions += stats[i].exceptions;
+		g_shared->sgx.exception[i].nsec += stats[i].nsec;
+	}
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_unlock(&g_shared->sgx.lock);
+#endif
+
+	return ((status == SGX_SUCCESS) && (ret == 0)) ?
+		EXIT_SUCCESS : EXIT_FAILURE;
+}
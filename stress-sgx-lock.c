@@ -0,0 +1,224 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+#include "sgx/utils.h"
+#include "sgx/enclave_cpu/untrusted/enclave_u.h"
+
+/* Time each primitive is contended for before switching with "all" */
+#define SGX_LOCK_SLICE_USEC	(100000)
+
+typedef struct {
+	const char *name;	/* method name */
+	const int primitive;	/* SGX_LOCK_*, -1 for all in turn */
+} sgx_lock_method_t;
+
+static const sgx_lock_method_t sgx_lock_methods[] = {
+	{ "all",	-1 },
+	{ "mutex",	SGX_LOCK_MUTEX },
+	{ "spin",	SGX_LOCK_SPIN },
+	{ "atomic",	SGX_LOCK_ATOMIC },
+	{ "condvar",	SGX_LOCK_CONDVAR },
+	{ NULL,		0 }
+};
+
+/*
+ *  stress_set_sgx_lock_method()
+ *	set the lock primitive to contend on
+ */
+int stress_set_sgx_lock_method(const char *name)
+{
+	const sgx_lock_method_t *info;
+
+	for (info = sgx_lock_methods; info->name; info++) {
+		if (!strcmp(info->name, name)) {
+			set_setting("sgx-lock-method", TYPE_ID_INT,
+				&info->primitive);
+			return 0;
+		}
+	}
+
+	(void)fprintf(stderr, "sgx-lock-method must be one of:");
+	for (info = sgx_lock_methods; info->name; info++)
+		(void)fprintf(stderr, " %s", info->name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_set_sgx_lock_threads()
+ *	set the number of enclave threads per instance
+ */
+void stress_set_sgx_lock_threads(const char *opt)
+{
+	uint32_t lock_threads;
+
+	lock_threads = get_uint32(opt);
+	check_range("sgx-lock-threads", lock_threads,
+		MIN_SGX_LOCK_THREADS, MAX_SGX_LOCK_THREADS);
+	set_setting("sgx-lock-threads", TYPE_ID_UINT32, &lock_threads);
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+
+typedef struct {
+	sgx_enclave_id_t eid;		/* shared enclave */
+	int primitive;			/* SGX_LOCK_* being contended */
+	int thread;			/* thread index */
+	volatile bool *run;		/* false to leave the enclave */
+	uint64_t ops;			/* ops done by this thread */
+	sgx_status_t status;		/* ECALL status */
+	int ret;			/* ECALL return */
+} sgx_lock_thread_t;
+
+/*
+ *  stress_sgx_lock_thread()
+ *	enter the enclave on its own TCS and contend until told to stop
+ */
+static void *stress_sgx_lock_thread(void *arg)
+{
+	sgx_lock_thread_t *t = (sgx_lock_thread_t *)arg;
+
+	t->ops = 0;
+	t->status = ecall_stress_lock(t->eid, &t->ret, t->primitive,
+		t->thread, (bool *)t->run, &t->ops);
+	return NULL;
+}
+
+/*
+ *  stress_sgx_lock_slice()
+ *	contend on primitive with all threads for one time slice
+ */
+static int stress_sgx_lock_slice(
+	const args_t *args,
+	const sgx_enclave_id_t eid,
+	const int primitive,
+	const uint32_t lock_threads,
+	sgx_lock_stats_t *stats)
+{
+	sgx_lock_thread_t threads[MAX_SGX_LOCK_THREADS];
+	pthread_t pthreads[MAX_SGX_LOCK_THREADS];
+	volatile bool run = true;
+	uint32_t i, created;
+	uint64_t sleeps = 0, wakes = 0;
+	double t_start, t_end;
+	int rc = 0;
+
+	t_start = time_now();
+	for (created = 0; created < lock_threads; created++) {
+		sgx_lock_thread_t *t = &threads[created];
+
+		t->eid = eid;
+		t->primitive = primitive;
+		t->thread = (int)created;
+		t->run = &run;
+		t->status = SGX_SUCCESS;
+		t->ret = 0;
+		if (pthread_create(&pthreads[created], NULL,
+				   stress_sgx_lock_thread, t) != 0) {
+			pr_fail_err("pthread_create");
+			rc = -1;
+			break;
+		}
+	}
+
+	while ((rc == 0) && g_keep_stressing_flag &&
+	       (time_now() - t_start < (double)SGX_LOCK_SLICE_USEC / 1000000.0))
+		(void)shim_usleep(10000);
+
+	run = false;
+	(void)ecall_stop_lock(eid);
+	for (i = 0; i < created; i++) {
+		(void)pthread_join(pthreads[i], NULL);
+		if (threads[i].status != SGX_SUCCESS) {
+			print_error_message(threads[i].status);
+			rc = -1;
+		} else if (threads[i].ret < 0) {
+			rc = -1;
+		}
+		stats->ops += threads[i].ops;
+		*args->counter += threads[i].ops;
+	}
+	t_end = time_now();
+
+	(void)ecall_get_lock_ocalls(eid, &sleeps, &wakes);
+	stats->sleeps += sleeps;
+	stats->wakes += wakes;
+	stats->nsec += (uint64_t)((t_end - t_start) * 1000000000.0);
+
+	return rc;
+}
+
+/*
+ *  stress_sgx_lock
+ *	stress trusted locking primitives with several
+ *	threads inside one enclave
+ */
+int stress_sgx_lock(const args_t *args)
+{
+	int method = -1, primitive = SGX_LOCK_MUTEX, i;
+	uint32_t lock_threads = DEFAULT_SGX_LOCK_THREADS;
+	sgx_lock_stats_t stats[SGX_LOCK_MAX];
+	sgx_enclave_id_t eid = 0;
+	sgx_status_t status;
+	int rc = EXIT_SUCCESS;
+
+	(void)get_setting("sgx-lock-method", &method);
+	(void)get_setting("sgx-lock-threads", &lock_threads);
+	(void)memset(stats, 0, sizeof(stats));
+
+	status = initialize_enclave(&eid, ENCLAVE_LOCK_FILENAME, TOKEN_LOCK_FILENAME);
+	stress_sgx_ready(args);
+	if (status != SGX_SUCCESS) {
+		printf("Error %d\n", status);
+		return EXIT_FAILURE;
+	}
+
+	if (method >= 0)
+		primitive = method;
+
+	do {
+		if (stress_sgx_lock_slice(args, eid, primitive,
+					  lock_threads, &stats[primitive]) < 0) {
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if (method < 0)
+			primitive = (primitive + 1) % SGX_LOCK_MAX;
+	} while (keep_stressing());
+
+	sgx_destroy_enclave(eid);
+
+	shim_pthread_spin_lock(&g_shared->sgx.lock);
+	for (i = 0; i < SGX_LOCK_MAX; i++) {
+		g_shared->sgx.primitive[i].ops += stats[i].ops;
+		g_shared->sgx.primitive[i].nsec += stats[i].nsec;
+		g_shared->sgx.primitive[i].sleeps += stats[i].sleeps;
+		g_shared->sgx.primitive[i].wakes += stats[i].wakes;
+	}
+	shim_pthread_spin_unlock(&g_shared->sgx.lock);
+
+	return rc;
+}
+#else
+int stress_sgx_lock(const args_t *args)
+{
+	return stress_not_implemented(args);
+}
+#endif
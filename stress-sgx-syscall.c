@@ -0,0 +1,300 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+#include "sgx/utils.h"
+#include "sgx/enclave_cpu/untrusted/enclave_u.h"
+
+/* Loops per ECALL, each batch is followed by as many native loops */
+#define SGX_SYSCALL_BATCH	(64)
+
+typedef struct {
+	const char *name;	/* mix name */
+	const uint32_t mix;	/* SGX_SYSCALL_* operations */
+} sgx_syscall_mix_t;
+
+static const sgx_syscall_mix_t sgx_syscall_mixes[] = {
+	{ "rdwr",	SGX_SYSCALL_WRITE | SGX_SYSCALL_FSTAT | SGX_SYSCALL_READ },
+	{ "read",	SGX_SYSCALL_FSTAT | SGX_SYSCALL_READ },
+	{ "write",	SGX_SYSCALL_WRITE | SGX_SYSCALL_FSTAT },
+	{ "stat",	SGX_SYSCALL_FSTAT },
+	{ NULL,		0 }
+};
+
+/*
+ *  OCALL proxies, these return -errno on failure
+ *  as a library OS syscall shim would
+ */
+long ocall_open(const char *path, int flags, int mode)
+{
+	const int fd = open(path, flags, (mode_t)mode);
+
+	return (fd < 0) ? -errno : fd;
+}
+
+long ocall_pwrite(int fd, const void *buf, size_t count, long offset)
+{
+	const ssize_t ret = pwrite(fd, buf, count, (off_t)offset);
+
+	return (ret < 0) ? -errno : (long)ret;
+}
+
+long ocall_pread(int fd, void *buf, size_t count, long offset)
+{
+	const ssize_t ret = pread(fd, buf, count, (off_t)offset);
+
+	return (ret < 0) ? -errno : (long)ret;
+}
+
+long ocall_fstat(int fd, uint64_t *size)
+{
+	struct stat statbuf;
+
+	if (fstat(fd, &statbuf) < 0)
+		return -errno;
+	*size = (uint64_t)statbuf.st_size;
+	return 0;
+}
+
+long ocall_close(int fd)
+{
+	return (close(fd) < 0) ? -errno : 0;
+}
+
+/*
+ *  stress_set_sgx_syscall_bytes()
+ *	set the size of each read and write
+ */
+void stress_set_sgx_syscall_bytes(const char *opt)
+{
+	size_t syscall_bytes;
+
+	syscall_bytes = (size_t)get_uint64_byte(opt);
+	check_range_bytes("sgx-syscall-bytes", syscall_bytes,
+		MIN_SGX_SYSCALL_BYTES, MAX_SGX_SYSCALL_BYTES);
+	set_setting("sgx-syscall-bytes", TYPE_ID_SIZE_T, &syscall_bytes);
+}
+
+/*
+ *  stress_set_sgx_syscall_mix()
+ *	set the I/O operation mix
+ */
+int stress_set_sgx_syscall_mix(const char *name)
+{
+	const sgx_syscall_mix_t *info;
+
+	for (info = sgx_syscall_mixes; info->name; info++) {
+		if (!strcmp(info->name, name)) {
+			set_setting("sgx-syscall-mix", TYPE_ID_UINT32, &info->mix);
+			return 0;
+		}
+	}
+
+	(void)fprintf(stderr, "sgx-syscall-mix must be one of:");
+	for (info = sgx_syscall_mixes; info->name; info++)
+		(void)fprintf(stderr, " %s", info->name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_sgx_syscall_native()
+ *	the enclave's open, [pwrite], [fstat], [pread], close
+ *	loop issued directly, returns 0 on success
+ */
+static int stress_sgx_syscall_native(
+	const args_t *args,
+	const char *filename,
+	const int flags,
+	const uint32_t mix,
+	uint8_t *buf,
+	const size_t io_size)
+{
+	struct stat statbuf;
+	int fd, ret = 0;
+
+	fd = open(filename, flags, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		pr_fail_err("open");
+		return -1;
+	}
+	if ((mix & SGX_SYSCALL_WRITE) &&
+	    (pwrite(fd, buf, io_size, 0) != (ssize_t)io_size)) {
+		pr_fail_err("pwrite");
+		ret = -1;
+		goto close;
+	}
+	if ((mix & SGX_SYSCALL_FSTAT) && (fstat(fd, &statbuf) < 0)) {
+		pr_fail_err("fstat");
+		ret = -1;
+		goto close;
+	}
+	if ((mix & SGX_SYSCALL_READ) &&
+	    (pread(fd, buf, io_size, 0) != (ssize_t)io_size)) {
+		pr_fail_err("pread");
+		ret = -1;
+	}
+close:
+	(void)close(fd);
+	return ret;
+}
+
+/*
+ *  stress_sgx_syscall
+ *	stress file I/O proxied out of an enclave through OCALLs
+ *	and compare it with the same I/O done natively
+ */
+int stress_sgx_syscall(const args_t *args)
+{
+	size_t io_size = DEFAULT_SGX_SYSCALL_BYTES;
+	uint32_t mix = SGX_SYSCALL_WRITE | SGX_SYSCALL_FSTAT | SGX_SYSCALL_READ;
+	const int flags = O_CREAT | O_RDWR;
+	sgx_syscall_stats_t stats[2];
+	uint64_t loops[2] = { 0, 0 };
+	uint64_t syscalls_per_loop, bytes_per_loop;
+	char filename[PATH_MAX];
+	sgx_enclave_id_t eid = 0;
+	sgx_status_t status;
+	sgx_log_t *log;
+	uint8_t *buf;
+	int i, fd, ret, rc = EXIT_FAILURE;
+
+	if (!get_setting("sgx-syscall-bytes", &io_size)) {
+		if (g_opt_flags & OPT_FLAGS_MAXIMIZE)
+			io_size = MAX_SGX_SYSCALL_BYTES;
+		if (g_opt_flags & OPT_FLAGS_MINIMIZE)
+			io_size = MIN_SGX_SYSCALL_BYTES;
+	}
+	(void)get_setting("sgx-syscall-mix", &mix);
+
+	/* open and close plus one system call per operation in the mix */
+	syscalls_per_loop = 2 + !!(mix & SGX_SYSCALL_WRITE) +
+		!!(mix & SGX_SYSCALL_FSTAT) + !!(mix & SGX_SYSCALL_READ);
+	bytes_per_loop = io_size * (!!(mix & SGX_SYSCALL_WRITE) +
+		!!(mix & SGX_SYSCALL_READ));
+	(void)memset(stats, 0, sizeof(stats));
+
+	buf = malloc(io_size);
+	if (!buf) {
+		pr_inf("%s: cannot allocate %zu byte buffer, skipping stressor\n",
+			args->name, io_size);
+		return EXIT_NO_RESOURCE;
+	}
+	stress_strnrnd((char *)buf, io_size);
+
+	ret = stress_temp_dir_mk_args(args);
+	if (ret < 0) {
+		free(buf);
+		return exit_status(-ret);
+	}
+	(void)stress_temp_filename_args(args,
+		filename, sizeof(filename), mwc32());
+	(void)umask(0077);
+
+	/* Populate the file so read only mixes have data to read */
+	if ((fd = open(filename, flags, S_IRUSR | S_IWUSR)) < 0) {
+		rc = exit_status(errno);
+		pr_fail_err("open");
+		goto finish;
+	}
+	if (write(fd, buf, io_size) != (ssize_t)io_size) {
+		rc = exit_status(errno);
+		pr_fail_err("write");
+		(void)close(fd);
+		goto unlink;
+	}
+	(void)close(fd);
+
+	status = initialize_enclave(&eid, ENCLAVE_CPU_FILENAME, TOKEN_CPU_FILENAME);
+	stress_sgx_ready(args);
+	if (status != SGX_SUCCESS) {
+		printf("Error %d\n", status);
+		goto unlink;
+	}
+
+	log = sgx_log_start(!!(g_opt_flags & PR_DEBUG));
+	if (log)
+		(void)ecall_set_log_ring(eid, &ret, &log->ring);
+
+	do {
+		const uint64_t counter = *args->counter;
+		uint64_t rounds = counter + SGX_SYSCALL_BATCH, n;
+		double t;
+
+		if (args->max_ops && (rounds > args->max_ops))
+			rounds = args->max_ops;
+
+		t = time_now();
+		status = ecall_stress_syscall(eid, &ret, filename, flags, mix,
+			io_size, rounds, args->counter, (bool *)&g_keep_stressing_flag,
+			g_opt_flags);
+		stats[SGX_RUN_ENCLAVE].nsec +=
+			(uint64_t)((time_now() - t) * 1000000000.0);
+		if (status != SGX_SUCCESS) {
+			print_error_message(status);
+			break;
+		}
+		n = *args->counter - counter;
+		loops[SGX_RUN_ENCLAVE] += n;
+		if (ret < 0)
+			break;
+
+		/* Same number of loops again, without the enclave */
+		t = time_now();
+		for (; n && g_keep_stressing_flag; n--) {
+			ret = stress_sgx_syscall_native(args, filename, flags,
+				mix, buf, io_size);
+			if (ret < 0)
+				break;
+			loops[SGX_RUN_NATIVE]++;
+		}
+		stats[SGX_RUN_NATIVE].nsec +=
+			(uint64_t)((time_now() - t) * 1000000000.0);
+		if (ret < 0)
+			break;
+	} while (keep_stressing());
+
+	sgx_destroy_enclave(eid);
+	sgx_log_stop(log);
+	if ((status == SGX_SUCCESS) && (ret == 0))
+		rc = EXIT_SUCCESS;
+
+	for (i = 0; i < 2; i++) {
+		stats[i].syscalls = loops[i] * syscalls_per_loop;
+		stats[i].bytes = loops[i] * bytes_per_loop;
+	}
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_lock(&g_shared->sgx.lock);
+#endif
+	for (i = 0; i < 2; i++) {
+		g_shared->sgx.syscall[i].syscalls += stats[i].syscalls;
+		g_shared->sgx.syscall[i].bytes += stats[i].bytes;
+		g_shared->sgx.syscall[i].nsec += stats[i].nsec;
+	}
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_unlock(&g_shared->sgx.lock);
+#endif
+
+unlink:
+	(void)unlink(filename);
+finish:
+	(void)stress_temp_dir_rm_args(args);
+	free(buf);
+	return rc;
+}
@@ -29,9 +29,20 @@ void ocall_sleep(int seconds)
 	sleep(seconds);
 }
 
+/*
+ *  ocall_shim_usleep()
+ *	sleep for both enclaves, e.g. the idle part of the --sgx-load
+ *	duty cycle, the untrusted clock isn't read while asleep so
+ *	its ticker is parked until the enclave is re-entered
+ */
 int ocall_shim_usleep(uint64_t usec)
 {
-	return shim_usleep(usec);
+	int ret;
+
+	sgx_clock_pause();
+	ret = shim_usleep(usec);
+	sgx_clock_resume();
+	return ret;
 }
 
 void stress_set_sgx_vm_hang(const char *opt)
@@ -54,6 +65,221 @@ void stress_set_sgx_vm_bytes(const char *opt)
 	set_setting("sgx-vm-bytes", TYPE_ID_SIZE_T, &vm_bytes);
 }
 
+/*
+ *  stress_set_sgx_vm_threads()
+ *	set the number of enclave threads sharing one buffer
+ */
+void stress_set_sgx_vm_threads(const char *opt)
+{
+	uint32_t vm_threads;
+
+	vm_threads = get_uint32(opt);
+	check_range("sgx-vm-threads", vm_threads,
+		MIN_SGX_VM_THREADS, MAX_SGX_VM_THREADS);
+	set_setting("sgx-vm-threads", TYPE_ID_UINT32, &vm_threads);
+}
+
+/*
+ *  stress_sgx_vm_method_stats()
+ *	fetch the per method stats out of the enclave
+ */
+static void stress_sgx_vm_method_stats(const sgx_enclave_id_t eid)
+{
+	uint64_t ops[STRESS_SGX_METHODS_MAX], nsec[STRESS_SGX_METHODS_MAX];
+	char names[STRESS_SGX_METHODS_MAX * STRESS_SGX_METHOD_NAME_LEN];
+	uint64_t verify_bytes = 0, verify_nsec = 0;
+	sgx_status_t status;
+	int n = 0;
+
+	status = ecall_get_vm_method_stats(eid, &n, ops, nsec,
+		names, sizeof(names), STRESS_SGX_METHODS_MAX);
+	if (status != SGX_SUCCESS) {
+		print_error_message(status);
+		return;
+	}
+	stress_sgx_method_stats_add(g_shared->sgx.vm, ops, nsec, names, n,
+		VM_BOGO_SHIFT);
+
+	status = ecall_get_vm_verify_stats(eid, &verify_bytes, &verify_nsec);
+	if (status != SGX_SUCCESS) {
+		print_error_message(status);
+		return;
+	}
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_lock(&g_shared->sgx.lock);
+#endif
+	g_shared->sgx.vm_verify.bytes += verify_bytes;
+	g_shared->sgx.vm_verify.nsec += verify_nsec;
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_unlock(&g_shared->sgx.lock);
+#endif
+}
+
+/*
+ *  stress_sgx_vm_commit_stats()
+ *	fetch the first touch stats out of the enclave, in --sgx-vm-commit
+ *	mode without --metrics report them for this instance right away
+ */
+static void stress_sgx_vm_commit_stats(
+	const args_t *args,
+	const sgx_enclave_id_t eid)
+{
+	uint64_t touches[SGX_VM_COMMIT_SIZES], pages[SGX_VM_COMMIT_SIZES];
+	uint64_t nsec[SGX_VM_COMMIT_SIZES];
+	uint64_t total_pages = 0, total_nsec = 0;
+	sgx_status_t status;
+	int i, n = 0;
+
+	status = ecall_get_vm_commit_stats(eid, &n, touches, pages, nsec,
+		SGX_VM_COMMIT_SIZES);
+	if (status != SGX_SUCCESS) {
+		print_error_message(status);
+		return;
+	}
+
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_lock(&g_shared->sgx.lock);
+#endif
+	for (i = 0; i < n; i++) {
+		g_shared->sgx.commit[i].touches += touches[i];
+		g_shared->sgx.commit[i].pages += pages[i];
+		g_shared->sgx.commit[i].nsec += nsec[i];
+		total_pages += pages[i];
+		total_nsec += nsec[i];
+	}
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_unlock(&g_shared->sgx.lock);
+#endif
+
+	if (!(g_opt_flags & OPT_FLAGS_METRICS) && total_nsec) {
+		pr_inf("%s: %" PRIu64 " EPC pages committed, %.2f pages/s, "
+			"%.2f nsec per page (instance %" PRIu32 ")\n",
+			args->name, total_pages,
+			(double)total_pages * 1000000000.0 / (double)total_nsec,
+			(double)total_nsec / (double)total_pages, args->instance);
+	}
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+
+typedef struct {
+	sgx_enclave_id_t eid;		/* shared enclave */
+	const char *method;		/* vm method to run */
+	int thread;			/* thread index */
+	int threads;			/* threads sharing the buffer */
+	uint64_t rounds;		/* bogo ops for this thread */
+	size_t page_size;		/* page size */
+	uint64_t counter;		/* bogo counter of this thread */
+	uint64_t *shared_counter;	/* instance bogo counter */
+	uint64_t bit_errors;		/* bit errors in this thread's slice */
+	uint64_t passes;		/* method passes over the slice */
+	uint64_t nsec;			/* time spent in the enclave */
+	sgx_status_t status;		/* ECALL status */
+	int ret;			/* ECALL return */
+} sgx_vm_thread_t;
+
+/*
+ *  stress_sgx_vm_thread()
+ *	enter the enclave on its own TCS and run on its slice
+ */
+static void *stress_sgx_vm_thread(void *arg)
+{
+	sgx_vm_thread_t *t = (sgx_vm_thread_t *)arg;
+	const double t_start = time_now();
+
+	t->status = ecall_stress_vm_thread(t->eid, &t->ret, t->method,
+		t->thread, t->threads, t->rounds, &t->counter,
+		t->shared_counter, &t->bit_errors, &t->passes, t->page_size);
+	t->nsec = (uint64_t)((time_now() - t_start) * 1000000000.0);
+	return NULL;
+}
+
+/*
+ *  stress_sgx_vm_threads()
+ *	partition one enclave buffer across vm_threads enclave threads,
+ *	returns 0 on success
+ */
+static int stress_sgx_vm_threads(
+	const args_t *args,
+	const sgx_enclave_id_t eid,
+	const char *vm_method,
+	const size_t vm_bytes,
+	const uint32_t vm_threads,
+	uint64_t *bit_error_count,
+	uint64_t *clock)
+{
+	sgx_vm_thread_t threads[MAX_SGX_VM_THREADS];
+	pthread_t pthreads[MAX_SGX_VM_THREADS];
+	const size_t part = (vm_bytes / vm_threads) & ~(args->page_size - 1);
+	sgx_status_t status;
+	uint32_t i, created;
+	int ret = 0;
+
+	if (!part) {
+		pr_inf("%s: %zu bytes is too small to share between %" PRIu32
+			" threads\n", args->name, vm_bytes, vm_threads);
+		return -1;
+	}
+
+	status = ecall_vm_threads_alloc(eid, &ret, vm_bytes,
+		(bool *)&g_keep_stressing_flag, g_opt_flags, args->page_size, clock);
+	if (status != SGX_SUCCESS) {
+		print_error_message(status);
+		return -1;
+	}
+	if (ret < 0)
+		return -1;
+
+	for (created = 0; created < vm_threads; created++) {
+		sgx_vm_thread_t *t = &threads[created];
+
+		(void)memset(t, 0, sizeof(*t));
+		t->eid = eid;
+		t->method = vm_method;
+		t->thread = (int)created;
+		t->threads = (int)vm_threads;
+		t->rounds = args->max_ops ?
+			(args->max_ops + vm_threads - 1) / vm_threads : 0;
+		t->page_size = args->page_size;
+		t->shared_counter = args->counter;
+		if (pthread_create(&pthreads[created], NULL,
+				   stress_sgx_vm_thread, t) != 0) {
+			pr_fail_err("pthread_create");
+			g_keep_stressing_flag = false;
+			ret = -1;
+			break;
+		}
+	}
+
+	for (i = 0; i < created; i++) {
+		(void)pthread_join(pthreads[i], NULL);
+		if (threads[i].status != SGX_SUCCESS) {
+			print_error_message(threads[i].status);
+			ret = -1;
+		} else if (threads[i].ret < 0) {
+			ret = -1;
+		}
+		*bit_error_count += threads[i].bit_errors;
+		if (threads[i].bit_errors)
+			pr_fail("%s: thread %" PRIu32 " detected %" PRIu64
+				" bit errors in its slice\n",
+				args->name, i, threads[i].bit_errors);
+	}
+	(void)ecall_vm_threads_free(eid);
+
+	shim_pthread_spin_lock(&g_shared->sgx.lock);
+	for (i = 0; i < created; i++) {
+		g_shared->sgx.vm_thread[i].passes += threads[i].passes;
+		g_shared->sgx.vm_thread[i].bytes += threads[i].passes * part;
+		g_shared->sgx.vm_thread[i].bit_errors += threads[i].bit_errors;
+		g_shared->sgx.vm_thread[i].nsec += threads[i].nsec;
+	}
+	shim_pthread_spin_unlock(&g_shared->sgx.lock);
+
+	return ret;
+}
+#endif
+
 /*
  *  stress_set_vm_method()
  *      set default vm stress method
@@ -107,6 +333,7 @@ int stress_sgx_vm(const args_t *args)
 	uint64_t *bit_error_count = MAP_FAILED;
 	uint64_t vm_hang = DEFAULT_VM_HANG;
 	uint32_t restarts = 0, nomems = 0;
+	uint32_t vm_threads = DEFAULT_SGX_VM_THREADS;
 	size_t vm_bytes = DEFAULT_SGX_VM_BYTES;
 	char* vm_method;
 	pid_t pid;
@@ -118,6 +345,19 @@ int stress_sgx_vm(const args_t *args)
 	(void)get_setting("sgx-vm-hang", &vm_hang);
 	(void)get_setting("sgx-vm-method", &vm_method);
 	(void)get_setting("sgx-vm-madvise", &vm_madvise);
+	(void)get_setting("sgx-vm-threads", &vm_threads);
+#if !defined(HAVE_LIB_PTHREAD)
+	if (vm_threads > 1) {
+		pr_inf("%s: no pthread support, using 1 enclave thread\n",
+			args->name);
+		vm_threads = 1;
+	}
+#endif
+	if ((vm_threads > 1) && (g_opt_flags & OPT_FLAGS_SGX_VM_COMMIT)) {
+		pr_inf("%s: --sgx-vm-commit uses 1 enclave thread\n",
+			args->name);
+		vm_threads = 1;
+	}
 
 	pr_dbg("%s using method '%s'\n", args->name, vm_method);
 
@@ -198,26 +438,61 @@ again:
 
 		sgx_enclave_id_t eid = 0;
 		sgx_status_t status = 0;
+		sgx_clock_t enclave_clock = { 0 };
+		sgx_log_t *log;
+		const bool metrics = !!(g_opt_flags & OPT_FLAGS_METRICS);
+		const bool commit = !!(g_opt_flags & OPT_FLAGS_SGX_VM_COMMIT);
 
 		pr_dbg("Initializing enclave\n");
-		/* Initialize the enclave */
-		status = initialize_enclave(&eid, ENCLAVE_VM_FILENAME, TOKEN_VM_FILENAME);
+		/* Initialize the enclave, only the threaded one carries extra TCS */
+		if (vm_threads > 1)
+			status = initialize_enclave(&eid, ENCLAVE_VM_THREADS_FILENAME,
+				TOKEN_VM_THREADS_FILENAME);
+		else
+			status = initialize_enclave(&eid, ENCLAVE_VM_FILENAME, TOKEN_VM_FILENAME);
+		stress_sgx_ready(args);
 		if (status != SGX_SUCCESS){
 			printf("Error %d\n", status);
 			return -1;
 		}
 
-		pr_dbg("Will ECALL into enclave\n");
+		/* Per method and first touch timing is only reported with --metrics */
+		if ((metrics || commit) && (sgx_clock_start(&enclave_clock) < 0))
+			pr_dbg("%s: cannot start enclave clock, methods and "
+				"first touches will not be timed\n", args->name);
+
+		/* Bit error reports go through the log ring, not one OCALL each */
 		int ecall_ret;
+		log = sgx_log_start(!!(g_opt_flags & PR_DEBUG));
+		if (log)
+			(void)ecall_set_vm_log_ring(eid, &ecall_ret, &log->ring);
+
+		pr_dbg("Will ECALL into enclave\n");
+#if defined(HAVE_LIB_PTHREAD)
+		if (vm_threads > 1) {
+			if (stress_sgx_vm_threads(args, eid, vm_method, vm_bytes,
+					vm_threads, bit_error_count,
+					enclave_clock.run ? (uint64_t *)&enclave_clock.nsec : NULL) < 0)
+				pr_dbg("%s: enclave threads failed (instance %" PRIu32 ")\n",
+					args->name, args->instance);
+		} else
+#endif
 		status = ecall_stress_vm(eid, &ecall_ret, vm_bytes, vm_method, args->max_ops,
 				args->counter, &g_keep_stressing_flag, g_opt_flags,
-				bit_error_count, page_size, vm_hang);
+				bit_error_count, page_size, vm_hang,
+				enclave_clock.run ? (uint64_t *)&enclave_clock.nsec : NULL);
+		sgx_clock_stop(&enclave_clock);
 		if (status != SGX_SUCCESS) {
 			print_error_message(status);
 			abort();
 		}
+		if (metrics && !commit)
+			stress_sgx_vm_method_stats(eid);
+		if (metrics || commit)
+			stress_sgx_vm_commit_stats(args, eid);
 
 		sgx_destroy_enclave(eid);
+		sgx_log_stop(log);
 		pr_dbg("Enclave destroyed\n");
 
 		_exit(EXIT_SUCCESS);
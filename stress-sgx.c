@@ -34,17 +34,17 @@ int stress_sgx_supported(void)
 
 void ocall_pr_fail(const char* str)
 {
-	pr_fail(str);
+	pr_fail("%s", str);
 }
 
 void ocall_pr_err(const char* str)
 {
-	pr_err(str);
+	pr_err("%s", str);
 }
 
 void ocall_pr_dbg(const char* str)
 {
-	pr_dbg(str);
+	pr_dbg("%s", str);
 }
 
 uint64_t ocall_dummy(uint64_t param)
@@ -52,6 +52,115 @@ uint64_t ocall_dummy(uint64_t param)
 	return param + 1;
 }
 
+/*
+ *  stress_set_sgx_load()
+ *	set the enclave cpu utilisation in %
+ */
+void stress_set_sgx_load(const char *opt)
+{
+	int32_t sgx_load;
+
+	sgx_load = get_int32(opt);
+	check_range("sgx-load", sgx_load, 0, 100);
+	set_setting("sgx-load", TYPE_ID_INT32, &sgx_load);
+}
+
+/*
+ *  stress_set_sgx_load_slice()
+ *	< 0 - number of iterations per busy slice
+ *	= 0 - random duration between 0..0.5 seconds
+ *	> 0 - milliseconds per busy slice
+ */
+void stress_set_sgx_load_slice(const char *opt)
+{
+	int32_t sgx_load_slice;
+
+	sgx_load_slice = get_int32(opt);
+	if ((sgx_load_slice < -5000) || (sgx_load_slice > 5000)) {
+		(void)fprintf(stderr, "sgx-load-slice must in the range -5000 to 5000.\n");
+		exit(EXIT_FAILURE);
+	}
+	set_setting("sgx-load-slice", TYPE_ID_INT32, &sgx_load_slice);
+}
+
+/*
+ *  stress_sgx_method_stats_add()
+ *	merge the per method stats of one enclave into the
+ *	shared stats, matching the methods by name; ops are
+ *	scaled down by shift as the stressor's bogo ops are
+ */
+void stress_sgx_method_stats_add(
+	sgx_method_stats_t *stats,
+	const uint64_t *ops,
+	const uint64_t *nsec,
+	const char *names,
+	const int n,
+	const int shift)
+{
+	int i, j;
+
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_lock(&g_shared->sgx.lock);
+#endif
+	for (i = 0; i < n; i++) {
+		const char *name = names + (i * STRESS_SGX_METHOD_NAME_LEN);
+
+		for (j = 0; j < STRESS_SGX_METHODS_MAX; j++) {
+			if (!*stats[j].name) {
+				(void)snprintf(stats[j].name,
+					sizeof(stats[j].name), "%s", name);
+				break;
+			}
+			if (!strcmp(stats[j].name, name))
+				break;
+		}
+		if (j == STRESS_SGX_METHODS_MAX)
+			break;
+		stats[j].ops += ops[i] >> shift;
+		stats[j].nsec += nsec[i];
+	}
+#if defined(HAVE_LIB_PTHREAD)
+	shim_pthread_spin_unlock(&g_shared->sgx.lock);
+#endif
+}
+
+/*
+ *  stress_sgx_method_stats()
+ *	fetch the per method stats out of the enclave
+ */
+static void stress_sgx_method_stats(const sgx_enclave_id_t eid, const uint64_t run_nsec)
+{
+	uint64_t ops[STRESS_SGX_METHODS_MAX], nsec[STRESS_SGX_METHODS_MAX];
+	char names[STRESS_SGX_METHODS_MAX * STRESS_SGX_METHOD_NAME_LEN];
+	sgx_status_t status;
+	int n = 0;
+
+	status = ecall_get_cpu_method_stats(eid, &n, ops, nsec,
+		names, sizeof(names), STRESS_SGX_METHODS_MAX);
+	if (status != SGX_SUCCESS) {
+		print_error_message(status);
+		return;
+	}
+	/* A single method is not timed in the enclave, it ran for the whole run */
+	if ((n == 1) && !nsec[0])
+		nsec[0] = run_nsec;
+	stress_sgx_method_stats_add(g_shared->sgx.cpu, ops, nsec, names, n, 0);
+}
+
+/*
+ *  stress_set_sgx_ops_per_ecall()
+ *	set the number of bogo ops done per enclave entry
+ */
+void stress_set_sgx_ops_per_ecall(const char *opt)
+{
+	uint64_t ops_per_ecall;
+
+	ops_per_ecall = get_uint64(opt);
+	check_range("sgx-ops-per-ecall", ops_per_ecall,
+		MIN_SGX_OPS_PER_ECALL, MAX_SGX_OPS_PER_ECALL);
+	set_setting("sgx-ops-per-ecall", TYPE_ID_UINT64, &ops_per_ecall);
+}
+
 /*
  *  stress_set_sgx_method()
  *	set the default sgx stress method
@@ -103,29 +212,101 @@ int stress_set_sgx_method(const char *name)
 int stress_sgx(const args_t *args)
 {
 	char* method;
+	uint64_t ops_per_ecall = DEFAULT_SGX_OPS_PER_ECALL;
+	uint64_t ecalls = 0;
+	int32_t sgx_load = 100;
+	int32_t sgx_load_slice = -64;
 	get_setting("sgx-method", &method);
+	(void)get_setting("sgx-ops-per-ecall", &ops_per_ecall);
+	(void)get_setting("sgx-load", &sgx_load);
+	(void)get_setting("sgx-load-slice", &sgx_load_slice);
 	pr_dbg("Method will be %s\n", method);
 
 	sgx_enclave_id_t eid = 0;
 	sgx_status_t status = 0;
+	sgx_clock_t enclave_clock = { 0 };
+	sgx_log_t *log;
+	const bool metrics = !!(g_opt_flags & OPT_FLAGS_METRICS);
+	int log_ret;
 
 	/* Initialize the enclave */
 	status = initialize_enclave(&eid, ENCLAVE_CPU_FILENAME, TOKEN_CPU_FILENAME);
+	stress_sgx_ready(args);
 	if (status != SGX_SUCCESS){
 		printf("Error %d\n", status);
 		return -1;
 	}
 
+	/*
+	 * It is unlikely, but somebody may request to do a zero
+	 * load stress test(!)
+	 */
+	if (sgx_load == 0) {
+		sleep((int)g_opt_timeout);
+		sgx_destroy_enclave(eid);
+		return EXIT_SUCCESS;
+	}
+
+	/* Verify failures go through the log ring, not one OCALL each */
+	log = sgx_log_start(!!(g_opt_flags & PR_DEBUG));
+	if (log)
+		(void)ecall_set_log_ring(eid, &log_ret, &log->ring);
+
+	/*
+	 * Per method timing of the all method (--metrics) and the
+	 * duty cycle of --sgx-load both need the untrusted clock
+	 */
+	if (((metrics && !strcmp(method, "all")) || (sgx_load < 100)) &&
+	    (sgx_clock_start(&enclave_clock) < 0)) {
+		pr_dbg("%s: cannot start enclave clock, methods will not be timed\n",
+			args->name);
+		if (sgx_load < 100)
+			pr_inf("%s: cannot start enclave clock, running at "
+				"100%% load\n", args->name);
+	}
 
 	pr_dbg("Will ECALL into enclave\n");
 	int ret;
-	status = ecall_stress_cpu(eid, &ret, method, args->max_ops, (args->counter), &g_keep_stressing_flag, g_opt_flags);
+	const double t_run = time_now();
+	do {
+		uint64_t rounds = args->max_ops, t = 0;
+
+		/*
+		 *  With --sgx-ops-per-ecall the enclave returns once the
+		 *  counter reaches the next multiple of N, so the cost
+		 *  of each enclave entry is amortised over N bogo ops
+		 */
+		if (ops_per_ecall) {
+			rounds = *args->counter + ops_per_ecall;
+			if (args->max_ops && (rounds > args->max_ops))
+				rounds = args->max_ops;
+			/* With --rate each enclave transition is scheduled */
+			t = stress_lat_start(args);
+		}
+		status = ecall_stress_cpu(eid, &ret, method, rounds, (args->counter),
+			&g_keep_stressing_flag, g_opt_flags,
+			enclave_clock.run ? (uint64_t *)&enclave_clock.nsec : NULL,
+			sgx_load, sgx_load_slice);
+		if (status != SGX_SUCCESS)
+			break;
+		if (ops_per_ecall)
+			stress_lat_record(args, stress_lat_now(args) - t);
+		ecalls++;
+	} while (ops_per_ecall && (ret == 0) && keep_stressing());
+	sgx_clock_stop(&enclave_clock);
 	if (status != SGX_SUCCESS) {
 		print_error_message(status);
 		abort();
 	}
+	pr_dbg("%s: %" PRIu64 " ECALLs, %.2f bogo ops per ECALL\n",
+		args->name, ecalls,
+		ecalls ? (double)*args->counter / (double)ecalls : 0.0);
+	if (metrics)
+		stress_sgx_method_stats(eid,
+			(uint64_t)((time_now() - t_run) * 1000000000.0));
 
 	sgx_destroy_enclave(eid);
+	sgx_log_stop(log);
 	pr_dbg("Enclave destroyed\n");
 
 	switch(ret) {
@@ -285,6 +285,7 @@ static int stress_sctp_server(
 	}
 
 	do {
+		const uint64_t t = stress_lat_start(args);
 		int sfd = accept(fd, (struct sockaddr *)NULL, NULL);
 		if (sfd >= 0) {
 			size_t i, j;
@@ -379,6 +380,7 @@ static int stress_sctp_server(
 				pr_fail_dbg("getpeername");
 			}
 			(void)close(sfd);
+			stress_lat_record(args, stress_lat_now(args) - t);
 		}
 		inc_counter(args);
 	} while (keep_stressing());
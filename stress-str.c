@@ -568,7 +568,7 @@ static void stress_str_all(
 	const size_t len2,
 	bool *failed)
 {
-	static int i = 1;	/* Skip over stress_str_all */
+	static __thread int i = 1;	/* Skip over stress_str_all */
 
 	(void)libc_func;
 
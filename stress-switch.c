@@ -108,6 +108,7 @@ again:
 		(void)memset(buf, '_', buf_size);
 
 		do {
+			const uint64_t t = stress_lat_now(args);
 			ssize_t ret;
 
 			ret = write(pipefds[1], buf, sizeof(buf));
@@ -120,6 +121,7 @@ again:
 				}
 				continue;
 			}
+			stress_lat_record(args, stress_lat_now(args) - t);
 			inc_counter(args);
 		} while (keep_stressing());
 
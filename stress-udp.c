@@ -150,6 +150,10 @@ again:
 				size_t i;
 
 				for (i = 16; i < sizeof(buf); i += 16, j++) {
+					/* With --rate the client keeps the schedule */
+					const uint64_t t = args->rate ?
+						stress_rate_wait(args) : 0;
+
 					(void)memset(buf, 'A' + (j % 26), sizeof(buf));
 					ssize_t ret = sendto(fd, buf, i, 0, addr, len);
 					if (ret < 0) {
@@ -157,6 +161,8 @@ again:
 							pr_fail_dbg("sendto");
 						break;
 					}
+					if (args->rate)
+						stress_lat_record(args, stress_lat_now(args) - t);
 				}
 			} while (keep_stressing());
 			(void)close(fd);
@@ -224,6 +230,7 @@ again:
 
 		do {
 			socklen_t len = addr_len;
+			const uint64_t t = args->rate ? 0 : stress_lat_now(args);
 			ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, addr, &len);
 			if (n == 0)
 				break;
@@ -232,6 +239,8 @@ again:
 					pr_fail_dbg("recvfrom");
 				break;
 			}
+			if (!args->rate)
+				stress_lat_record(args, stress_lat_now(args) - t);
 			inc_counter(args);
 		} while (keep_stressing());
 
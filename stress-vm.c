@@ -146,12 +146,6 @@ int stress_set_vm_madvise(const char *opt)
 	return -1;
 }
 
-#define SET_AND_TEST(ptr, val, bit_errors)	\
-{						\
-	*ptr = val;				\
-	bit_errors += (*ptr != val);		\
-}
-
 /*
  *  This compiles down to a load, ror, store in x86
  */
@@ -262,6 +256,115 @@ static inline size_t stress_vm_count_bits(uint64_t v)
 	return n;
 }
 
+/* 32 byte vectors, one AVX2 register or a pair of SSE2 registers */
+typedef uint64_t stress_vm_vec_t
+	__attribute__ ((vector_size (32), aligned (8), __may_alias__));
+
+#define VM_VERIFY_VECS		(8)	/* vectors folded per block */
+#define VM_VERIFY_BLOCK		(VM_VERIFY_VECS * sizeof(stress_vm_vec_t))
+#define VM_WALK_CHUNK		(64 * 1024)
+
+/* Verify phase accounting of this stressor process */
+static uint64_t vm_verify_bytes;
+static double vm_verify_secs;
+
+/*
+ *  stress_vm_count_diff()
+ *	count the bits that differ between buf and ref
+ */
+static size_t stress_vm_count_diff(
+	const uint8_t *buf,
+	const uint8_t *ref,
+	const size_t n)
+{
+	size_t i, bit_errors = 0;
+
+	for (i = 0; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+		uint64_t a, b;
+
+		(void)memcpy(&a, buf + i, sizeof(a));
+		(void)memcpy(&b, ref + i, sizeof(b));
+		bit_errors += stress_vm_count_bits(a ^ b);
+	}
+	for (; i < n; i++)
+		bit_errors += stress_vm_count_bits(buf[i] ^ ref[i]);
+
+	return bit_errors;
+}
+
+/*
+ *  stress_vm_cmp_ref()
+ *	count the bits of buf that differ from ref repeated over it,
+ *	ref_len must be a multiple of VM_VERIFY_BLOCK. Each block is
+ *	XORed against ref and folded with OR without branching, and
+ *	only blocks that differ get popcounted
+ */
+static size_t NOINLINE TARGET_CLONES_AVX2 stress_vm_cmp_ref(
+	const uint8_t *buf,
+	const size_t sz,
+	const uint8_t *ref,
+	const size_t ref_len)
+{
+	size_t off, r = 0, bit_errors = 0;
+
+	for (off = 0; off + VM_VERIFY_BLOCK <= sz; off += VM_VERIFY_BLOCK) {
+		const stress_vm_vec_t *v = (const stress_vm_vec_t *)(buf + off);
+		const stress_vm_vec_t *p = (const stress_vm_vec_t *)(ref + r);
+		const stress_vm_vec_t diff =
+			(v[0] ^ p[0]) | (v[1] ^ p[1]) |
+			(v[2] ^ p[2]) | (v[3] ^ p[3]) |
+			(v[4] ^ p[4]) | (v[5] ^ p[5]) |
+			(v[6] ^ p[6]) | (v[7] ^ p[7]);
+
+		if (diff[0] | diff[1] | diff[2] | diff[3])
+			bit_errors += stress_vm_count_diff(buf + off,
+				ref + r, VM_VERIFY_BLOCK);
+		r += VM_VERIFY_BLOCK;
+		if (r >= ref_len)
+			r = 0;
+	}
+	return bit_errors + stress_vm_count_diff(buf + off, ref + r, sz - off);
+}
+
+/*
+ *  stress_vm_verify()
+ *	verify phase, count the bits of buf that differ from ref
+ *	repeated over it and account for the time taken
+ */
+static size_t stress_vm_verify(
+	const uint8_t *buf,
+	const size_t sz,
+	const uint8_t *ref,
+	const size_t ref_len)
+{
+	const double t = time_now();
+	size_t bit_errors;
+
+	bit_errors = stress_vm_cmp_ref(buf, sz, ref, ref_len);
+	vm_verify_bytes += sz;
+	vm_verify_secs += time_now() - t;
+
+	return bit_errors;
+}
+
+/*
+ *  stress_vm_verify_pattern()
+ *	verify phase, count the bits of buf that differ from pattern
+ */
+static size_t stress_vm_verify_pattern(
+	const uint8_t *buf,
+	const size_t sz,
+	const uint64_t pattern)
+{
+	uint64_t ref[VM_VERIFY_BLOCK / sizeof(uint64_t)];
+	size_t i;
+
+	for (i = 0; i < VM_VERIFY_BLOCK / sizeof(uint64_t); i++)
+		ref[i] = pattern;
+
+	return stress_vm_verify(buf, sz, (const uint8_t *)ref, sizeof(ref));
+}
+
 /*
  *  stress_vm_moving_inversion()
  *	work sequentially through memory setting 8 bytes at at a time
@@ -362,7 +465,8 @@ abort:
  *  stress_vm_modulo_x()
  *	set every 23rd byte to a random pattern and then set
  *	all the other bytes to the complement of this. Check
- *	that the random patterns are still set.
+ *	that the random patterns and their complements are
+ *	still set.
  */
 static size_t stress_vm_modulo_x(
 	uint8_t *buf,
@@ -372,6 +476,8 @@ static size_t stress_vm_modulo_x(
 {
 	uint32_t i, j;
 	const uint32_t stride = 23;	/* Small prime to hit cache */
+	/* stride whole verify blocks, the buffer repeats with this period */
+	uint8_t ref[23 * VM_VERIFY_BLOCK];
 	uint8_t pattern, compliment;
 	volatile uint8_t *ptr;
 	uint8_t *buf_end = buf + sz;
@@ -409,12 +515,11 @@ static size_t stress_vm_modulo_x(
 		}
 		inject_random_bit_errors(buf, sz);
 
-		for (ptr = buf + i; ptr < buf_end; ptr += stride) {
-			if (*ptr != pattern)
-				bit_errors++;
-			if (!g_keep_stressing_flag)
-				return bit_errors;
-		}
+		for (j = 0; j < sizeof(ref); j++)
+			ref[j] = ((j % stride) == i) ? pattern : compliment;
+		bit_errors += stress_vm_verify(buf, sz, ref, sizeof(ref));
+		if (!g_keep_stressing_flag)
+			break;
 	}
 
 abort:
@@ -427,7 +532,8 @@ abort:
 /*
  *  stress_vm_walking_one_data()
  *	for each byte, walk through each data line setting them to high
- *	setting each bit to see if none of the lines are stuck
+ *	setting each bit to see if none of the lines are stuck. Each
+ *	pattern is written over a chunk and then verified in one pass
  */
 static size_t stress_vm_walking_one_data(
 	uint8_t *buf,
@@ -435,21 +541,27 @@ static size_t stress_vm_walking_one_data(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	size_t bit_errors = 0;
-	volatile uint8_t *ptr;
-	uint8_t *buf_end = buf + sz;
+	size_t bit_errors = 0, off;
 	uint64_t c = *counter;
 
-	for (ptr = buf; ptr < buf_end; ptr++) {
-		SET_AND_TEST(ptr, 0x01, bit_errors);
-		SET_AND_TEST(ptr, 0x02, bit_errors);
-		SET_AND_TEST(ptr, 0x04, bit_errors);
-		SET_AND_TEST(ptr, 0x08, bit_errors);
-		SET_AND_TEST(ptr, 0x10, bit_errors);
-		SET_AND_TEST(ptr, 0x20, bit_errors);
-		SET_AND_TEST(ptr, 0x40, bit_errors);
-		SET_AND_TEST(ptr, 0x80, bit_errors);
-		c++;
+	for (off = 0; off < sz; ) {
+		size_t len = sz - off;
+		int bit;
+
+		if (len > VM_WALK_CHUNK)
+			len = VM_WALK_CHUNK;
+		if (max_ops && (len > max_ops - c))
+			len = max_ops - c;
+
+		for (bit = 0; bit < 8; bit++) {
+			const uint8_t val = (uint8_t)(1 << bit);
+
+			(void)memset(buf + off, val, len);
+			bit_errors += stress_vm_verify_pattern(buf + off, len,
+				val * 0x0101010101010101ULL);
+		}
+		off += len;
+		c += len;
 		if (max_ops && c >= max_ops)
 			break;
 		if (!g_keep_stressing_flag)
@@ -464,7 +576,8 @@ static size_t stress_vm_walking_one_data(
 /*
  *  stress_vm_walking_zero_data()
  *	for each byte, walk through each data line setting them to low
- *	setting each bit to see if none of the lines are stuck
+ *	setting each bit to see if none of the lines are stuck. Each
+ *	pattern is written over a chunk and then verified in one pass
  */
 static size_t stress_vm_walking_zero_data(
 	uint8_t *buf,
@@ -472,21 +585,27 @@ static size_t stress_vm_walking_zero_data(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	size_t bit_errors = 0;
-	volatile uint8_t *ptr;
-	uint8_t *buf_end = buf + sz;
+	size_t bit_errors = 0, off;
 	uint64_t c = *counter;
 
-	for (ptr = buf; ptr < buf_end; ptr++) {
-		SET_AND_TEST(ptr, 0xfe, bit_errors);
-		SET_AND_TEST(ptr, 0xfd, bit_errors);
-		SET_AND_TEST(ptr, 0xfb, bit_errors);
-		SET_AND_TEST(ptr, 0xf7, bit_errors);
-		SET_AND_TEST(ptr, 0xef, bit_errors);
-		SET_AND_TEST(ptr, 0xdf, bit_errors);
-		SET_AND_TEST(ptr, 0xbf, bit_errors);
-		SET_AND_TEST(ptr, 0x7f, bit_errors);
-		c++;
+	for (off = 0; off < sz; ) {
+		size_t len = sz - off;
+		int bit;
+
+		if (len > VM_WALK_CHUNK)
+			len = VM_WALK_CHUNK;
+		if (max_ops && (len > max_ops - c))
+			len = max_ops - c;
+
+		for (bit = 0; bit < 8; bit++) {
+			const uint8_t val = (uint8_t)~(1 << bit);
+
+			(void)memset(buf + off, val, len);
+			bit_errors += stress_vm_verify_pattern(buf + off, len,
+				val * 0x0101010101010101ULL);
+		}
+		off += len;
+		c += len;
 		if (max_ops && c >= max_ops)
 			break;
 		if (!g_keep_stressing_flag)
@@ -1113,8 +1232,6 @@ static size_t stress_vm_zero_one(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	volatile uint64_t *ptr;
-	uint64_t *buf_end = (uint64_t *)(buf + sz);
 	uint64_t c = *counter;
 	size_t bit_errors = 0;
 
@@ -1125,38 +1242,16 @@ static size_t stress_vm_zero_one(
 	inject_random_bit_errors(buf, sz);
 	c += sz / 8;
 
-	for (ptr = (uint64_t *)buf; ptr < buf_end; ptr += 8) {
-		bit_errors += stress_vm_count_bits(*(ptr + 0));
-		bit_errors += stress_vm_count_bits(*(ptr + 1));
-		bit_errors += stress_vm_count_bits(*(ptr + 2));
-		bit_errors += stress_vm_count_bits(*(ptr + 3));
-		bit_errors += stress_vm_count_bits(*(ptr + 4));
-		bit_errors += stress_vm_count_bits(*(ptr + 5));
-		bit_errors += stress_vm_count_bits(*(ptr + 6));
-		bit_errors += stress_vm_count_bits(*(ptr + 7));
-
-		if (!g_keep_stressing_flag)
-			goto abort;
-	}
+	bit_errors += stress_vm_verify_pattern(buf, sz, 0ULL);
+	if (!g_keep_stressing_flag)
+		goto abort;
 
 	(void)memset(buf, 0xff, sz);
 	(void)mincore_touch_pages(buf, sz);
 	inject_random_bit_errors(buf, sz);
 	c += sz / 8;
 
-	for (ptr = (uint64_t *)buf; ptr < buf_end; ptr += 8) {
-		bit_errors += stress_vm_count_bits(~*(ptr + 0));
-		bit_errors += stress_vm_count_bits(~*(ptr + 1));
-		bit_errors += stress_vm_count_bits(~*(ptr + 2));
-		bit_errors += stress_vm_count_bits(~*(ptr + 3));
-		bit_errors += stress_vm_count_bits(~*(ptr + 4));
-		bit_errors += stress_vm_count_bits(~*(ptr + 5));
-		bit_errors += stress_vm_count_bits(~*(ptr + 6));
-		bit_errors += stress_vm_count_bits(~*(ptr + 7));
-
-		if (!g_keep_stressing_flag)
-			break;
-	}
+	bit_errors += stress_vm_verify_pattern(buf, sz, ~0ULL);
 abort:
 	stress_vm_check("zero-one", bit_errors);
 	*counter = c;
@@ -1176,8 +1271,6 @@ static size_t stress_vm_galpat_zero(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	volatile uint64_t *ptr;
-	uint64_t *buf_end = (uint64_t *)(buf + sz);
 	size_t i, bit_errors = 0, bits_set = 0;
 	size_t bits_bad = sz / 4096;
 	uint64_t c = *counter;
@@ -1203,19 +1296,7 @@ static size_t stress_vm_galpat_zero(
 	(void)mincore_touch_pages(buf, sz);
 	inject_random_bit_errors(buf, sz);
 
-	for (ptr = (uint64_t *)buf; ptr < buf_end; ptr += 8) {
-		bits_set += stress_vm_count_bits(*(ptr + 0));
-		bits_set += stress_vm_count_bits(*(ptr + 1));
-		bits_set += stress_vm_count_bits(*(ptr + 2));
-		bits_set += stress_vm_count_bits(*(ptr + 3));
-		bits_set += stress_vm_count_bits(*(ptr + 4));
-		bits_set += stress_vm_count_bits(*(ptr + 5));
-		bits_set += stress_vm_count_bits(*(ptr + 6));
-		bits_set += stress_vm_count_bits(*(ptr + 7));
-
-		if (!g_keep_stressing_flag)
-			break;
-	}
+	bits_set = stress_vm_verify_pattern(buf, sz, 0ULL);
 
 	if (bits_set != bits_bad)
 		bit_errors += UNSIGNED_ABS(bits_set, bits_bad);
@@ -1238,8 +1319,6 @@ static size_t stress_vm_galpat_one(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	volatile uint64_t *ptr;
-	uint64_t *buf_end = (uint64_t *)(buf + sz);
 	size_t i, bit_errors = 0, bits_set = 0;
 	size_t bits_bad = sz / 4096;
 	uint64_t c = *counter;
@@ -1265,18 +1344,7 @@ static size_t stress_vm_galpat_one(
 	(void)mincore_touch_pages(buf, sz);
 	inject_random_bit_errors(buf, sz);
 
-	for (ptr = (uint64_t *)buf; ptr < buf_end; ptr += 8) {
-		bits_set += stress_vm_count_bits(~(*(ptr + 0)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 1)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 2)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 3)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 4)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 5)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 6)));
-		bits_set += stress_vm_count_bits(~(*(ptr + 7)));
-		if (!g_keep_stressing_flag)
-			break;
-	}
+	bits_set = stress_vm_verify_pattern(buf, sz, ~0ULL);
 
 	if (bits_set != bits_bad)
 		bit_errors += UNSIGNED_ABS(bits_set, bits_bad);
@@ -2040,6 +2108,7 @@ again:
 		}
 	} else if (pid == 0) {
 		int no_mem_retries = 0;
+		const double t_start = time_now();
 
 		(void)setpgid(0, g_pgrp);
 		stress_parent_died_alarm();
@@ -2094,6 +2163,15 @@ again:
 		if (keep && buf != NULL)
 			(void)munmap((void *)buf, buf_sz);
 
+		if (vm_verify_secs > 0.0) {
+			const double secs = time_now() - t_start;
+
+			pr_dbg("%s: verify phases took %.2f%% of %.2f secs, "
+				"%.2f GB/s (instance %" PRIu32 ")\n", args->name,
+				secs > 0.0 ? 100.0 * vm_verify_secs / secs : 0.0,
+				secs, (double)vm_verify_bytes / (vm_verify_secs * 1e9),
+				args->instance);
+		}
 		_exit(EXIT_SUCCESS);
 	}
 clean_up:
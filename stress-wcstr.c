@@ -528,7 +528,7 @@ static void stress_wcs_all(
 	const size_t len2,
 	bool *failed)
 {
-	static int i = 1;	/* Skip over stress_wcs_all */
+	static __thread int i = 1;	/* Skip over stress_wcs_all */
 
 	(void)libc_func;
 
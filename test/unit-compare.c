@@ -0,0 +1,251 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "../compare.c"
+#include "unit.h"
+
+static char *unit_compare_file;
+static uint32_t unit_threshold = DEFAULT_COMPARE_THRESHOLD;
+
+/*
+ *  get_setting()
+ *	the --compare and --compare-threshold settings of a test
+ */
+bool get_setting(const char *name, void *value)
+{
+	if (!strcmp(name, "compare") && unit_compare_file) {
+		*(char **)value = unit_compare_file;
+		return true;
+	}
+	if (!strcmp(name, "compare-threshold")) {
+		*(uint32_t *)value = unit_threshold;
+		return true;
+	}
+	return false;
+}
+
+/*
+ *  unit_baseline()
+ *	write a baseline file, returns its name
+ */
+static char *unit_baseline(const char *text)
+{
+	static char path[] = "/tmp/unit-compare-XXXXXX";
+	int fd;
+
+	(void)strcpy(path + sizeof(path) - 7, "XXXXXX");
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		exit(EXIT_FAILURE);
+	}
+	if (write(fd, text, strlen(text)) != (ssize_t)strlen(text)) {
+		perror("write");
+		exit(EXIT_FAILURE);
+	}
+	(void)close(fd);
+	return path;
+}
+
+/*
+ *  unit_reset()
+ *	drop the metrics of the last test
+ */
+static void unit_reset(void)
+{
+	compare_free();
+	compare_active = true;
+	unit_compare_file = NULL;
+	unit_threshold = DEFAULT_COMPARE_THRESHOLD;
+}
+
+/*
+ *  test_load()
+ *	a saved baseline is read back metric by metric
+ */
+static void test_load(void)
+{
+	const compare_metric_t *cm;
+	char *path;
+
+	unit_reset();
+	path = unit_baseline(
+		"---\n"
+		"system-info:\n"
+		"      hostname: host\n"
+		"      release: 4.15.0\n"
+		"      metric: orphan\n"
+		"      samples: [ 1.000000 ]\n"
+		"baseline:\n"
+		"    - stressor: cpu\n"
+		"      metric: bogo-ops-per-second-real-time\n"
+		"      better: higher\n"
+		"      samples: [ 10.500000, 11.000000, 12.000000 ]\n"
+		"    - stressor: cpu\n"
+		"      metric: latency-p99-usec\n"
+		"      better: lower\n"
+		"      samples: [ 3.000000 ]\n"
+		"    - stressor: sgx-vm\n"
+		"      metric: swaps\n"
+		"      better: neutral\n"
+		"      samples: [ ]\n"
+		"...\n");
+	CHECK(compare_load(path) == 0);
+	(void)unlink(path);
+
+	cm = compare_find(&compare_baseline, "cpu", "bogo-ops-per-second-real-time", false);
+	CHECK(cm != NULL);
+	if (cm) {
+		CHECK(cm->better == COMPARE_HIGHER);
+		CHECK(cm->n == 3);
+		CHECK(cm->n == 3 && cm->samples[0] == 10.5 && cm->samples[2] == 12.0);
+	}
+	cm = compare_find(&compare_baseline, "cpu", "latency-p99-usec", false);
+	CHECK(cm != NULL && cm->better == COMPARE_LOWER && cm->n == 1);
+	cm = compare_find(&compare_baseline, "sgx-vm", "swaps", false);
+	CHECK(cm != NULL && cm->better == COMPARE_NEUTRAL && cm->n == 0);
+	/* Metrics before the first stressor are not taken */
+	CHECK(compare_find(&compare_baseline, "", "orphan", false) == NULL);
+}
+
+/*
+ *  test_load_unusable()
+ *	missing and empty baselines are errors
+ */
+static void test_load_unusable(void)
+{
+	char *path;
+
+	unit_reset();
+	CHECK(compare_load("/nonexistent/baseline.yaml") < 0);
+
+	path = unit_baseline("---\nsystem-info:\n      hostname: host\n...\n");
+	CHECK(compare_load(path) < 0);
+	unit_compare_file = path;
+	CHECK(compare_report(NULL) < 0);
+	(void)unlink(path);
+}
+
+/*
+ *  unit_report()
+ *	compare one metric of this run with a baseline,
+ *	returns the regressions reported
+ */
+static int unit_report(
+	const char *better,
+	const double *base,
+	const size_t base_n,
+	const double *cur,
+	const size_t cur_n,
+	const uint32_t threshold)
+{
+	char text[1024], *ptr = text;
+	size_t i;
+	int ret;
+
+	unit_reset();
+	ptr += sprintf(ptr, "---\nbaseline:\n"
+		"    - stressor: cpu\n"
+		"      metric: m\n"
+		"      better: %s\n"
+		"      samples: [", better);
+	for (i = 0; i < base_n; i++)
+		ptr += sprintf(ptr, "%s %f", i ? "," : "", base[i]);
+	(void)sprintf(ptr, " ]\n...\n");
+
+	for (i = 0; i < cur_n; i++)
+		compare_add("cpu", "m", COMPARE_NEUTRAL, cur[i]);
+	/* The direction of a metric comes from this run */
+	for (i = 0; i < SIZEOF_ARRAY(compare_better); i++)
+		if (!strcmp(better, compare_better[i]))
+			compare_current->better = (int)i;
+
+	unit_compare_file = unit_baseline(text);
+	unit_threshold = threshold;
+	ret = compare_report(NULL);
+	(void)unlink(unit_compare_file);
+	return ret;
+}
+
+/*
+ *  test_threshold()
+ *	single samples are flagged when the change is
+ *	beyond the threshold in the worse direction
+ */
+static void test_threshold(void)
+{
+	const double base = 100.0;
+	const double up = 104.0, down = 94.0, far_up = 110.0;
+
+	CHECK(unit_report("higher", &base, 1, &up, 1, 5) == 0);
+	CHECK(unit_report("higher", &base, 1, &down, 1, 5) == 1);
+	CHECK(unit_report("higher", &base, 1, &down, 1, 10) == 0);
+	CHECK(unit_report("higher", &base, 1, &far_up, 1, 5) == 0);
+	CHECK(unit_report("lower", &base, 1, &far_up, 1, 5) == 1);
+	CHECK(unit_report("lower", &base, 1, &down, 1, 5) == 0);
+	CHECK(unit_report("neutral", &base, 1, &far_up, 1, 5) == 0);
+	/* Exactly at the threshold is not beyond it */
+	CHECK(unit_report("higher", &base, 1, &down, 1, 6) == 0);
+}
+
+/*
+ *  test_welch()
+ *	repeated samples are only flagged when the change
+ *	is significant as well as beyond the threshold
+ */
+static void test_welch(void)
+{
+	static const double base[] = { 100.0, 101.0, 99.0, 100.5, 99.5 };
+	static const double slower[] = { 80.0, 81.0, 79.0, 80.5, 79.5 };
+	static const double noisy_base[] = { 60.0, 140.0, 100.0, 70.0, 130.0 };
+	static const double noisy[] = { 50.0, 130.0, 90.0, 60.0, 120.0 };
+	static const double flat[] = { 90.0, 90.0, 90.0 };
+	static const double flat_base[] = { 100.0, 100.0, 100.0 };
+
+	CHECK(unit_report("higher", base, 5, slower, 5, 5) == 1);
+	CHECK(unit_report("lower", base, 5, slower, 5, 5) == 0);
+	/* 10% slower on average but lost in the noise */
+	CHECK(unit_report("higher", noisy_base, 5, noisy, 5, 5) == 0);
+	/* No variance on either side, any difference counts */
+	CHECK(unit_report("higher", flat_base, 3, flat, 3, 5) == 1);
+}
+
+/*
+ *  test_t_crit()
+ *	critical values of Student's t from the tables
+ */
+static void test_t_crit(void)
+{
+	CHECK_NEAR(compare_t_crit(0.05, 1.0), 12.706, 0.001);
+	CHECK_NEAR(compare_t_crit(0.05, 10.0), 2.228, 0.001);
+	CHECK_NEAR(compare_t_crit(0.01, 20.0), 2.845, 0.001);
+	CHECK_NEAR(compare_t_crit(0.05, 1E6), 1.960, 0.001);
+	CHECK_NEAR(compare_t_p(2.228, 10.0), 0.05, 0.0005);
+}
+
+int main(void)
+{
+	test_load();
+	test_load_unusable();
+	test_threshold();
+	test_welch();
+	test_t_crit();
+	compare_free();
+
+	return unit_done("compare");
+}
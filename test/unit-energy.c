@@ -0,0 +1,167 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "../energy.c"
+#include "unit.h"
+
+/*
+ *  unit_counter()
+ *	set a fake energy_uj counter
+ */
+static void unit_counter(const char *path, const uint64_t uj)
+{
+	FILE *fp = fopen(path, "w");
+
+	if (!fp) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	(void)fprintf(fp, "%" PRIu64 "\n", uj);
+	(void)fclose(fp);
+}
+
+/*
+ *  unit_zone()
+ *	add a domain read from a fake counter
+ */
+static void unit_zone(const char *path, const uint64_t range, const uint64_t uj)
+{
+	energy_zone_t *zone = &energy_zones[energy_n++];
+
+	unit_counter(path, uj);
+	zone->path = strdup(path);
+	zone->range = range;
+	zone->last = uj;
+}
+
+/*
+ *  test_delta()
+ *	differences of a counter across at most one wrap
+ */
+static void test_delta(void)
+{
+	const uint64_t range = 262143328850ULL;
+
+	CHECK(energy_delta_uj(100, 250, range) == 150);
+	CHECK(energy_delta_uj(100, 100, range) == 0);
+	CHECK(energy_delta_uj(range - 10, 5, range) == 16);
+	CHECK(energy_delta_uj(range, 0, range) == 1);
+	CHECK(energy_delta_uj(0, range, range) == range);
+	CHECK(energy_delta_uj(1, 0, range) == range);
+	/* 32 bit counters on older kernels */
+	CHECK(energy_delta_uj(0xfffffff0ULL, 0x10ULL, 0xffffffffULL) == 0x20);
+}
+
+/*
+ *  test_read()
+ *	joules add up over the domains and across wraps
+ */
+static void test_read(void)
+{
+	char pkg0[] = "/tmp/unit-energy-0-XXXXXX";
+	char pkg1[] = "/tmp/unit-energy-1-XXXXXX";
+	double joules = -1.0;
+	int fd;
+
+	fd = mkstemp(pkg0);
+	if (fd >= 0)
+		(void)close(fd);
+	fd = mkstemp(pkg1);
+	if (fd >= 0)
+		(void)close(fd);
+
+	g_opt_flags = 0;
+	CHECK(!energy_read(&joules) && joules == -1.0);
+
+	g_opt_flags = OPT_FLAGS_ENERGY;
+	energy_joules = 0.0;
+	unit_zone(pkg0, 1000000000, 5000000);
+	unit_zone(pkg1, 1000000000, 999000000);
+	CHECK(energy_read(&joules) && joules == 0.0);
+
+	/* 2 J on package 0, package 1 wraps after 3 J */
+	unit_counter(pkg0, 7000000);
+	unit_counter(pkg1, 1999999);
+	CHECK(energy_read(&joules));
+	CHECK_NEAR(joules, 5.0, 1E-9);
+	CHECK(energy_zones[1].last == 1999999);
+
+	/* An unreadable domain keeps its last value for the next read */
+	(void)unlink(pkg1);
+	unit_counter(pkg0, 8000000);
+	CHECK(energy_read(&joules));
+	CHECK_NEAR(joules, 6.0, 1E-9);
+	CHECK(energy_zones[1].last == 1999999);
+	unit_counter(pkg1, 2999999);
+	CHECK(energy_read(&joules));
+	CHECK_NEAR(joules, 7.0, 1E-9);
+
+	energy_free();
+	CHECK(energy_n == 0);
+	(void)unlink(pkg0);
+	(void)unlink(pkg1);
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  test_poll()
+ *	the poller reads a counter that would otherwise
+ *	wrap more than once between two reads
+ */
+static void test_poll(void)
+{
+	char pkg[] = "/tmp/unit-energy-XXXXXX";
+	double joules;
+	int fd, i;
+
+	fd = mkstemp(pkg);
+	if (fd >= 0)
+		(void)close(fd);
+
+	g_opt_flags = OPT_FLAGS_ENERGY;
+	energy_joules = 0.0;
+	energy_poll_usec = ENERGY_POLL_MIN_USEC;
+	unit_zone(pkg, 1000000, 0);
+	energy_run = true;
+	CHECK(pthread_create(&energy_thread, NULL, energy_poll_thread, NULL) == 0);
+	energy_running = true;
+
+	/* 0.6 J a step, five wraps of the counter that holds up to 1 J */
+	for (i = 1; i <= 10; i++) {
+		unit_counter(pkg, (uint64_t)(i * 600000) % 1000001);
+		(void)usleep(ENERGY_POLL_MIN_USEC * 3);
+	}
+	CHECK(energy_read(&joules));
+	CHECK_NEAR(joules, 6.0, 1E-9);
+
+	energy_free();
+	CHECK(!energy_running);
+	(void)unlink(pkg);
+}
+#endif
+
+int main(void)
+{
+	test_delta();
+	test_read();
+#if defined(HAVE_LIB_PTHREAD)
+	test_poll();
+#endif
+
+	return unit_done("energy");
+}
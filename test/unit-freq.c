@@ -0,0 +1,120 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "../freq.c"
+#include "unit.h"
+
+#if defined(__linux__) && defined(HAVE_AFFINITY)
+
+/*
+ *  Two packages of two cores with two SMT siblings each,
+ *  numbered the way Linux does, siblings n and n + 4
+ */
+#define UNIT_CPU(c, p, ct, pt)	\
+	{ .msr = -1, .core = c, .package = p, .core_throttle = ct, .package_throttle = pt }
+
+static freq_cpu_t unit_cpus[] = {
+	UNIT_CPU(0, 0, 1, 100),
+	UNIT_CPU(1, 0, 2, 100),
+	UNIT_CPU(0, 1, 10, 1000),
+	UNIT_CPU(1, 1, 20, 1000),
+	UNIT_CPU(0, 0, 1, 100),
+	UNIT_CPU(1, 0, 2, 100),
+	UNIT_CPU(0, 1, 10, 1000),
+	UNIT_CPU(1, 1, 20, 1000),
+};
+
+/*
+ *  unit_throttle()
+ *	throttle events on a list of CPUs, ending at -1
+ */
+static int64_t unit_throttle(const int32_t *cpus)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	for (; *cpus >= 0; cpus++)
+		CPU_SET(*cpus, &set);
+	return freq_throttle_count(&set);
+}
+
+/*
+ *  test_throttle()
+ *	each core and package counter is counted once
+ */
+static void test_throttle(void)
+{
+	static const int32_t none[] = { -1 };
+	static const int32_t one[] = { 0, -1 };
+	static const int32_t siblings[] = { 0, 4, -1 };
+	static const int32_t cores[] = { 0, 1, -1 };
+	static const int32_t package[] = { 0, 1, 4, 5, -1 };
+	static const int32_t all[] = { 0, 1, 2, 3, 4, 5, 6, 7, -1 };
+	static const int32_t sibling_last[] = { 5, 3, -1 };
+
+	freq_cpus = unit_cpus;
+	freq_n = (int32_t)SIZEOF_ARRAY(unit_cpus);
+
+	CHECK(unit_throttle(none) == -1);
+	CHECK(unit_throttle(one) == 1 + 100);
+	CHECK(unit_throttle(siblings) == 1 + 100);
+	CHECK(unit_throttle(cores) == 1 + 2 + 100);
+	CHECK(unit_throttle(package) == 1 + 2 + 100);
+	CHECK(unit_throttle(all) == 1 + 2 + 100 + 10 + 20 + 1000);
+	CHECK(unit_throttle(sibling_last) == 2 + 100 + 20 + 1000);
+
+	/* Unreadable counters are left out, -1 if all of them are */
+	unit_cpus[2].package_throttle = -1;
+	unit_cpus[6].package_throttle = -1;
+	CHECK(unit_throttle(all) == 1 + 2 + 100 + 10 + 20);
+	unit_cpus[0].core_throttle = -1;
+	unit_cpus[0].package_throttle = -1;
+	unit_cpus[4].core_throttle = -1;
+	unit_cpus[4].package_throttle = -1;
+	CHECK(unit_throttle(siblings) == -1);
+	CHECK(unit_throttle(package) == 2);
+
+	freq_cpus = NULL;
+	freq_n = 0;
+}
+
+/*
+ *  test_delta()
+ *	counted during the run, -1 if unreadable
+ */
+static void test_delta(void)
+{
+	CHECK(freq_delta(5, 12) == 7);
+	CHECK(freq_delta(5, 5) == 0);
+	CHECK(freq_delta(-1, 12) == -1);
+	CHECK(freq_delta(5, -1) == -1);
+}
+
+int main(void)
+{
+	test_throttle();
+	test_delta();
+
+	return unit_done("freq");
+}
+#else
+int main(void)
+{
+	return unit_done("freq");
+}
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "../rate.c"
+#include "unit.h"
+
+/*
+ *  test_profiles()
+ *	profile names are accepted and unknown ones refused
+ */
+static void test_profiles(void)
+{
+	CHECK(stress_set_rate_profile("poisson") == 0 && rate_profile == RATE_POISSON);
+	CHECK(stress_set_rate_profile("step") == 0 && rate_profile == RATE_STEP);
+	CHECK(stress_set_rate_profile("sine") == 0 && rate_profile == RATE_SINE);
+	CHECK(stress_set_rate_profile("constant") == 0 && rate_profile == RATE_CONSTANT);
+	CHECK(stress_set_rate_profile("burst") < 0 && rate_profile == RATE_CONSTANT);
+}
+
+/*
+ *  test_constant()
+ *	each instance takes its share of the rate
+ */
+static void test_constant(void)
+{
+	const args_t one = { .num_instances = 1 };
+	const args_t four = { .num_instances = 4 };
+
+	rate_target = 1000;
+	rate_profile = RATE_CONSTANT;
+	CHECK_NEAR(rate_interval(&one, 0.0), 1E6, 1E-3);
+	CHECK_NEAR(rate_interval(&one, 30.0), 1E6, 1E-3);
+	CHECK_NEAR(rate_interval(&four, 0.0), 4E6, 1E-3);
+}
+
+/*
+ *  test_step()
+ *	a quarter of the rate more in each quarter of the
+ *	run, then all of it past the end
+ */
+static void test_step(void)
+{
+	const args_t args = { .num_instances = 1 };
+
+	rate_target = 1000;
+	rate_profile = RATE_STEP;
+	g_opt_timeout = 100;
+	CHECK_NEAR(rate_interval(&args, 0.0), 4E6, 1E-3);
+	CHECK_NEAR(rate_interval(&args, 24.9), 4E6, 1E-3);
+	CHECK_NEAR(rate_interval(&args, 25.0), 2E6, 1E-3);
+	CHECK_NEAR(rate_interval(&args, 60.0), 4E6 / 3.0, 1E-3);
+	CHECK_NEAR(rate_interval(&args, 99.0), 1E6, 1E-3);
+	CHECK_NEAR(rate_interval(&args, 500.0), 1E6, 1E-3);
+
+	/* Without --timeout the steps are a minute long */
+	g_opt_timeout = 0;
+	CHECK_NEAR(rate_interval(&args, 14.0), 4E6, 1E-3);
+	CHECK_NEAR(rate_interval(&args, 16.0), 2E6, 1E-3);
+}
+
+/*
+ *  test_sine()
+ *	the rate swings between 1/2 and 3/2 once per run
+ */
+static void test_sine(void)
+{
+	const args_t args = { .num_instances = 2 };
+
+	rate_target = 2000;
+	rate_profile = RATE_SINE;
+	g_opt_timeout = 40;
+	CHECK_NEAR(rate_interval(&args, 0.0), 1E6, 1E-3);
+	CHECK_NEAR(rate_interval(&args, 10.0), 1E6 / 1.5, 1E-3);
+	CHECK_NEAR(rate_interval(&args, 20.0), 1E6, 1E-3);
+	CHECK_NEAR(rate_interval(&args, 30.0), 1E6 / 0.5, 1E-3);
+	g_opt_timeout = 0;
+}
+
+/*
+ *  test_poisson()
+ *	exponential intervals with the mean of the rate
+ */
+static void test_poisson(void)
+{
+	const args_t args = { .num_instances = 1 };
+	const int n = 200000;
+	double sum = 0.0, sum_sq = 0.0, mean, min = 1E30;
+	int i;
+
+	rate_target = 1000;
+	rate_profile = RATE_POISSON;
+	for (i = 0; i < n; i++) {
+		const double ns = rate_interval(&args, 0.0);
+
+		sum += ns;
+		sum_sq += ns * ns;
+		if (ns < min)
+			min = ns;
+	}
+	mean = sum / n;
+	/* The standard deviation of an exponential is its mean */
+	CHECK_NEAR(mean, 1E6, 1E6 * 0.02);
+	CHECK_NEAR(sqrt((sum_sq / n) - (mean * mean)), 1E6, 1E6 * 0.03);
+	CHECK(min >= 0.0);
+	rate_profile = RATE_CONSTANT;
+}
+
+/*
+ *  test_schedule()
+ *	bogo ops are due at the start of the schedule then
+ *	one interval apart, late ones are issued at once and
+ *	those issued after the next was due are missed
+ */
+static void test_schedule(void)
+{
+	stress_rate_t rate;
+	const args_t args = { .rate = &rate, .num_instances = 1 };
+	uint64_t now, due;
+
+	rate_target = 1000;
+	rate_profile = RATE_CONSTANT;
+
+	/* The first bogo op is due straight away */
+	(void)memset(&rate, 0, sizeof(rate));
+	now = rate_now();
+	due = stress_rate_wait(&args);
+	CHECK(due >= now);
+	CHECK(rate.start == due && rate.next == due + 1000000);
+	CHECK(rate.issued == 1 && rate.missed == 0);
+
+	/* On time, sleeps until it is due */
+	due = stress_rate_wait(&args);
+	CHECK(due == rate.start + 1000000);
+	CHECK(rate_now() >= due);
+	CHECK(rate.issued == 2 && rate.missed == 0);
+
+	/* Late but before the next is due, not missed */
+	now = rate_now();
+	rate.start = now - 10000000;
+	rate.next = now - 500000;
+	due = stress_rate_wait(&args);
+	CHECK(due == now - 500000);
+	CHECK(rate.next == due + 1000000);
+	CHECK(rate.missed == 0);
+
+	/* Behind by several intervals, issued at once and missed */
+	now = rate_now();
+	rate.next = now - 5000000;
+	due = stress_rate_wait(&args);
+	CHECK(due == now - 5000000);
+	CHECK(rate.missed == 1);
+	CHECK(rate.issued == 4);
+}
+
+int main(void)
+{
+	test_profiles();
+	test_constant();
+	test_step();
+	test_sine();
+	test_poisson();
+	test_schedule();
+
+	return unit_done("rate");
+}
@@ -0,0 +1,146 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "../scale.c"
+#include "unit.h"
+
+/*
+ *  unit_usl()
+ *	sweep the counts in list with rates that follow the
+ *	Universal Scalability Law exactly
+ */
+static void unit_usl(
+	const char *list,
+	const double lambda,
+	const double sigma,
+	const double kappa,
+	double *rates)
+{
+	size_t i;
+
+	stress_set_scale_sweep(list);
+	for (i = 0; i < scale_n; i++) {
+		const double n = (double)scale_counts[i];
+
+		rates[i] = lambda * n / (1.0 + (sigma * (n - 1.0)) +
+			(kappa * n * (n - 1.0)));
+	}
+}
+
+/*
+ *  test_counts()
+ *	the list is sorted and duplicates dropped
+ */
+static void test_counts(void)
+{
+	const uint32_t *counts;
+
+	stress_set_scale_sweep("8,2,4,2,1");
+	CHECK(scale_sweep_counts(&counts) == 4);
+	CHECK(counts[0] == 1 && counts[1] == 2 && counts[2] == 4 && counts[3] == 8);
+}
+
+/*
+ *  test_usl()
+ *	all three USL parameters are recovered, whether or
+ *	not the sweep starts at 1 instance
+ */
+static void test_usl(void)
+{
+	double rates[MAX_SCALE_SWEEP], lambda, serial, sigma, kappa;
+
+	unit_usl("1,2,4,8,16", 100.0, 0.05, 0.002, rates);
+	CHECK(scale_fit(rates, &lambda, &serial, &sigma, &kappa));
+	CHECK_NEAR(lambda, 100.0, 1E-6);
+	CHECK_NEAR(sigma, 0.05, 1E-9);
+	CHECK_NEAR(kappa, 0.002, 1E-9);
+
+	unit_usl("4,8,16,32", 100.0, 0.05, 0.002, rates);
+	CHECK(scale_fit(rates, &lambda, &serial, &sigma, &kappa));
+	CHECK_NEAR(lambda, 100.0, 1E-6);
+	CHECK_NEAR(sigma, 0.05, 1E-9);
+	CHECK_NEAR(kappa, 0.002, 1E-9);
+}
+
+/*
+ *  test_amdahl()
+ *	a serial fraction is not pulled towards 0 when
+ *	the smallest count is above 1
+ */
+static void test_amdahl(void)
+{
+	double rates[MAX_SCALE_SWEEP], lambda, serial, sigma, kappa;
+
+	unit_usl("4,8,16", 50.0, 0.1, 0.0, rates);
+	CHECK(scale_fit(rates, &lambda, &serial, &sigma, &kappa));
+	CHECK_NEAR(serial, 0.1, 1E-9);
+	CHECK_NEAR(sigma, 0.1, 1E-9);
+	CHECK_NEAR(kappa, 0.0, 1E-9);
+	CHECK_NEAR(lambda, 50.0, 1E-6);
+
+	/* Two counts, Amdahl only */
+	unit_usl("2,6", 50.0, 0.2, 0.0, rates);
+	CHECK(scale_fit(rates, &lambda, &serial, &sigma, &kappa));
+	CHECK_NEAR(serial, 0.2, 1E-9);
+	CHECK(kappa == 0.0);
+}
+
+/*
+ *  test_negative_kappa()
+ *	a fit that needs a negative coherency cost
+ *	falls back to Amdahl's law
+ */
+static void test_negative_kappa(void)
+{
+	double rates[MAX_SCALE_SWEEP], lambda, serial, sigma, kappa;
+
+	unit_usl("1,2,4,8", 100.0, 0.1, 0.0, rates);
+	/* Faster than Amdahl allows at the top end */
+	rates[3] *= 1.2;
+	CHECK(scale_fit(rates, &lambda, &serial, &sigma, &kappa));
+	CHECK(kappa == 0.0);
+	CHECK(sigma == serial);
+}
+
+/*
+ *  test_too_few()
+ *	one usable point can't be fitted
+ */
+static void test_too_few(void)
+{
+	double rates[MAX_SCALE_SWEEP], lambda, serial, sigma, kappa;
+
+	unit_usl("4", 50.0, 0.1, 0.0, rates);
+	CHECK(!scale_fit(rates, &lambda, &serial, &sigma, &kappa));
+
+	unit_usl("1,2,4", 50.0, 0.1, 0.0, rates);
+	rates[1] = 0.0;
+	rates[2] = 0.0;
+	CHECK(!scale_fit(rates, &lambda, &serial, &sigma, &kappa));
+}
+
+int main(void)
+{
+	test_counts();
+	test_usl();
+	test_amdahl();
+	test_negative_kappa();
+	test_too_few();
+
+	return unit_done("scale");
+}
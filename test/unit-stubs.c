@@ -0,0 +1,182 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include "stress-ng.h"
+
+/*
+ *  Stand-ins for the parts of stress-ng the unit tests do not
+ *  link with. They are weak so a test can provide its own.
+ */
+#define WEAK	__attribute__((weak))
+
+WEAK uint64_t g_opt_timeout;
+WEAK uint64_t g_opt_flags;
+WEAK jmp_buf g_error_env;
+WEAK volatile bool g_keep_stressing_flag = true;
+
+WEAK void pr_dbg(const char *fmt, ...)
+{
+	(void)fmt;
+}
+
+WEAK void pr_inf(const char *fmt, ...)
+{
+	(void)fmt;
+}
+
+WEAK void pr_err(const char *fmt, ...)
+{
+	(void)fmt;
+}
+
+WEAK void pr_fail(const char *fmt, ...)
+{
+	(void)fmt;
+}
+
+WEAK int pr_yaml(FILE *fp, const char *const fmt, ...)
+{
+	va_list ap;
+	int ret = 0;
+
+	if (fp) {
+		va_start(ap, fmt);
+		ret = vfprintf(fp, fmt, ap);
+		va_end(ap);
+	}
+	return ret;
+}
+
+WEAK void pr_yaml_runinfo(FILE *fp)
+{
+	(void)fp;
+}
+
+WEAK bool get_setting(const char *name, void *value)
+{
+	(void)name;
+	(void)value;
+
+	return false;
+}
+
+WEAK void set_setting(const char *name, const type_id_t type_id, const void *value)
+{
+	(void)name;
+	(void)type_id;
+	(void)value;
+}
+
+WEAK uint64_t get_uint64(const char *const str)
+{
+	return (uint64_t)strtoull(str, NULL, 10);
+}
+
+WEAK uint32_t get_uint32(const char *const str)
+{
+	return (uint32_t)strtoul(str, NULL, 10);
+}
+
+WEAK void check_range(
+	const char *const opt,
+	const uint64_t val,
+	const uint64_t lo,
+	const uint64_t hi)
+{
+	(void)opt;
+	(void)val;
+	(void)lo;
+	(void)hi;
+}
+
+WEAK uint32_t mwc32(void)
+{
+	static uint32_t w = 521288629, z = 362436069;
+
+	z = 36969 * (z & 65535) + (z >> 16);
+	w = 18000 * (w & 65535) + (w >> 16);
+	return (z << 16) + w;
+}
+
+WEAK int system_read(const char *path, char *buf, const size_t buf_len)
+{
+	int fd;
+	ssize_t ret;
+
+	(void)memset(buf, 0, buf_len);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	ret = read(fd, buf, buf_len);
+	if (ret < 0)
+		ret = -errno;
+	(void)close(fd);
+	return (int)ret;
+}
+
+WEAK int32_t stress_get_processors_configured(void)
+{
+	return 1;
+}
+
+WEAK int shim_usleep(uint64_t usec)
+{
+	return usleep((useconds_t)usec);
+}
+
+WEAK double time_now(void)
+{
+	struct timeval now;
+
+	if (gettimeofday(&now, NULL) < 0)
+		return -1.0;
+	return (double)now.tv_sec + ((double)now.tv_usec / 1E6);
+}
+
+WEAK char *munge_underscore(const char *str)
+{
+	return (char *)str;
+}
+
+WEAK void compare_add(
+	const char *stressor,
+	const char *metric,
+	const int better,
+	const double value)
+{
+	(void)stressor;
+	(void)metric;
+	(void)better;
+	(void)value;
+}
+
+WEAK int perf_energy_open(void)
+{
+	return 0;
+}
+
+WEAK bool perf_energy_read(double *joules)
+{
+	(void)joules;
+
+	return false;
+}
+
+WEAK void perf_energy_close(void)
+{
+}
@@ -0,0 +1,57 @@
+/*
+ * Stress-SGX: Load and stress your enclaves for fun and profit
+ * Copyright (C) 2017-2018 Sébastien Vaucher
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef UNIT_H
+#define UNIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*
+ *  Unit tests include the module under test, so its static
+ *  helpers can be called, and link with unit-stubs.c for
+ *  the rest of stress-ng
+ */
+static int unit_checks;
+static int unit_failures;
+
+#define CHECK(cond)							\
+do {									\
+	unit_checks++;							\
+	if (!(cond)) {							\
+		unit_failures++;					\
+		(void)fprintf(stderr, "%s:%d: check failed: %s\n",	\
+			__FILE__, __LINE__, #cond);			\
+	}								\
+} while (0)
+
+#define CHECK_NEAR(a, b, eps)	CHECK(fabs((double)(a) - (double)(b)) <= (eps))
+
+/*
+ *  unit_done()
+ *	report the checks run, exit status for main
+ */
+static inline int unit_done(const char *name)
+{
+	(void)printf("%s: %d of %d checks passed\n", name,
+		unit_checks - unit_failures, unit_checks);
+	return unit_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif